@@ -0,0 +1,298 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: frwd_batch.c
+ ** 版本号: 1.0
+ ** 描  述: 下行应答的批量发送
+ **         将发往同一下游结点的应答合并为一个MSG_BATCH_MESG消息发送(类似Nagle算法):
+ **         1. 缓存为空且距上条消息已超过最长攒批时间时, 直接发送(低负载不增加时延)
+ **         2. 否则放入缓存, 缓存达到单批最大字节数或攒批时间到达时发送
+ **         3. 攒批时间 = MIN(最长攒批时间, 消息间隔EWMA * 攒批目标条数), 随负载自适应
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "frwd.h"
+
+static void *frwd_batch_routine(void *_ctx);
+
+/******************************************************************************
+ **函数名称: frwd_batch_creat
+ **功    能: 创建批量发送对象
+ **输入参数:
+ **     size: 单批最大字节数
+ **     delay: 最长攒批时间(微秒)
+ **输出参数: NONE
+ **返    回: 批量发送对象
+ **实现描述: 各下游结点的缓存在首次发送时分配
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+frwd_batch_t *frwd_batch_creat(int size, int delay)
+{
+    int idx;
+    frwd_batch_t *batch;
+
+    batch = (frwd_batch_t *)calloc(1, sizeof(frwd_batch_t));
+    if (NULL == batch) {
+        return NULL;
+    }
+
+    batch->size = size;
+    batch->delay = delay;
+
+    pthread_mutex_init(&batch->lock, NULL);
+    for (idx=0; idx<FRWD_BATCH_SLOT_MAX; ++idx) {
+        pthread_mutex_init(&batch->slot[idx].lock, NULL);
+    }
+
+    return batch;
+}
+
+/******************************************************************************
+ **函数名称: frwd_batch_launch
+ **功    能: 启动刷新线程
+ **输入参数:
+ **     ctx: 全局对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_batch_launch(frwd_cntx_t *ctx)
+{
+    if (NULL == ctx->batch) {
+        return FRWD_OK;
+    }
+
+    if (pthread_create(&ctx->batch->tid, NULL, frwd_batch_routine, (void *)ctx)) {
+        log_error(ctx->log, "Create batch thread failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return FRWD_ERR;
+    }
+
+    return FRWD_OK;
+}
+
+/******************************************************************************
+ **函数名称: frwd_batch_slot
+ **功    能: 获取下游结点的发送缓存
+ **输入参数:
+ **     batch: 批量发送对象
+ **     nid: 下游结点ID
+ **输出参数: NONE
+ **返    回: 发送缓存(NULL:结点数已达上限或内存不足)
+ **实现描述: 已分配的槽位不再回收, 因此查找时无需加锁
+ **注意事项: 槽位初始化完成后才增加已分配结点数
+ **作    者:
+ ******************************************************************************/
+static frwd_batch_slot_t *frwd_batch_slot(frwd_batch_t *batch, int nid)
+{
+    int idx, num;
+    frwd_batch_slot_t *slot;
+
+    num = batch->num;
+    for (idx=0; idx<num; ++idx) {
+        if (batch->slot[idx].nid == nid) {
+            return &batch->slot[idx];
+        }
+    }
+
+    pthread_mutex_lock(&batch->lock);
+
+    for (idx=0; idx<batch->num; ++idx) {
+        if (batch->slot[idx].nid == nid) {
+            pthread_mutex_unlock(&batch->lock);
+            return &batch->slot[idx];
+        }
+    }
+
+    if (batch->num >= FRWD_BATCH_SLOT_MAX) {
+        pthread_mutex_unlock(&batch->lock);
+        return NULL;
+    }
+
+    slot = &batch->slot[batch->num];
+    slot->buf = (char *)calloc(1, batch->size);
+    if (NULL == slot->buf) {
+        pthread_mutex_unlock(&batch->lock);
+        return NULL;
+    }
+    slot->nid = nid;
+    slot->len = sizeof(mesg_header_t);
+
+    __sync_synchronize();
+    ++batch->num;
+
+    pthread_mutex_unlock(&batch->lock);
+
+    return slot;
+}
+
+/******************************************************************************
+ **函数名称: frwd_batch_flush
+ **功    能: 发送缓存中的消息
+ **输入参数:
+ **     ctx: 全局对象
+ **     slot: 发送缓存
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 只有一条消息时原样发送, 多条消息时填写批量报头后整体发送
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static int frwd_batch_flush(frwd_cntx_t *ctx, frwd_batch_slot_t *slot)
+{
+    int ret, type;
+    mesg_header_t *head = (mesg_header_t *)slot->buf, *mesg;
+
+    if (0 == slot->num) {
+        return FRWD_OK;
+    }
+
+    if (1 == slot->num) {
+        mesg = head + 1;
+        type = MESG_NHEAD_TYPE(mesg);
+        ret = rtmq_async_send(ctx->forward, type, slot->nid,
+                (void *)mesg, slot->len - sizeof(mesg_header_t));
+    }
+    else {
+        MESG_HEAD_SET(head, MSG_BATCH_MESG, 0,
+                ctx->conf.nid, 0, slot->len - sizeof(mesg_header_t));
+        MESG_HEAD_HTON(head, head);
+
+        type = MSG_BATCH_MESG;
+        ret = rtmq_async_send(ctx->forward, type, slot->nid, (void *)head, slot->len);
+    }
+
+    if (ret) {
+        log_error(ctx->log, "Push batch into send queue failed! nid:%d type:%d num:%d len:%lu",
+                slot->nid, type, slot->num, slot->len);
+    }
+
+    slot->num = 0;
+    slot->len = sizeof(mesg_header_t);
+
+    return ret? FRWD_ERR : FRWD_OK;
+}
+
+/******************************************************************************
+ **函数名称: frwd_batch_send
+ **功    能: 发送下行消息
+ **输入参数:
+ **     ctx: 全局对象
+ **     type: 消息类型
+ **     nid: 下游结点ID
+ **     data: 消息(报头为网络字节序)
+ **     len: 消息长度
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 未开启批量发送或无可用缓存时, 直接发送
+ **     2. 超过单批最大字节数的消息, 先发出缓存再直接发送(保证同一结点的消息有序)
+ **     3. 缓存为空且距上条消息已超过最长攒批时间时, 直接发送
+ **     4. 否则放入缓存, 缓存将满或已达攒批时间时发送
+ **注意事项: 发送接口会拷贝数据, 因此调用者可以在返回后释放消息
+ **作    者:
+ ******************************************************************************/
+int frwd_batch_send(frwd_cntx_t *ctx, int type, int nid, void *data, size_t len)
+{
+    int ret;
+    uint64_t now, gap;
+    frwd_batch_slot_t *slot;
+    frwd_batch_t *batch = ctx->batch;
+
+    if (NULL == batch) {
+        return rtmq_async_send(ctx->forward, type, nid, data, len);
+    }
+
+    slot = frwd_batch_slot(batch, nid);
+    if (NULL == slot) {
+        return rtmq_async_send(ctx->forward, type, nid, data, len);
+    }
+
+    now = frwd_router_now();
+
+    pthread_mutex_lock(&slot->lock);
+
+    /* > 更新消息间隔及攒批时间 */
+    gap = (now > slot->atm)? (now - slot->atm) : 0;
+    slot->atm = now;
+    slot->gap = (0 == slot->gap)? gap :
+        (slot->gap - (slot->gap >> FRWD_BATCH_EWMA_SHIFT) + (gap >> FRWD_BATCH_EWMA_SHIFT));
+    slot->hold = MIN(batch->delay, slot->gap * FRWD_BATCH_HOLD_NUM);
+
+    /* > 直接发送: 消息过大或负载较低 */
+    if (len + sizeof(mesg_header_t) > batch->size
+        || (0 == slot->num && gap >= batch->delay))
+    {
+        frwd_batch_flush(ctx, slot);
+        ret = rtmq_async_send(ctx->forward, type, nid, data, len);
+        pthread_mutex_unlock(&slot->lock);
+        return ret;
+    }
+
+    /* > 放入缓存 */
+    if (slot->len + len > batch->size) {
+        frwd_batch_flush(ctx, slot);
+    }
+
+    if (0 == slot->num) {
+        slot->stm = now;
+    }
+
+    memcpy(slot->buf + slot->len, data, len);
+    slot->len += len;
+    ++slot->num;
+
+    ret = FRWD_OK;
+    if (slot->len + sizeof(mesg_header_t) >= batch->size
+        || now - slot->stm >= slot->hold)
+    {
+        ret = frwd_batch_flush(ctx, slot);
+    }
+
+    pthread_mutex_unlock(&slot->lock);
+
+    return ret;
+}
+
+/******************************************************************************
+ **函数名称: frwd_batch_routine
+ **功    能: 刷新线程
+ **输入参数:
+ **     _ctx: 全局对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 周期性检查各结点的缓存, 发送已达攒批时间的消息
+ **注意事项: 检查间隔为最长攒批时间的1/4, 且不小于FRWD_BATCH_TICK_MIN
+ **作    者:
+ ******************************************************************************/
+static void *frwd_batch_routine(void *_ctx)
+{
+    int idx;
+    uint64_t now, tick;
+    frwd_batch_slot_t *slot;
+    frwd_cntx_t *ctx = (frwd_cntx_t *)_ctx;
+    frwd_batch_t *batch = ctx->batch;
+
+    pthread_detach(pthread_self());
+
+    tick = MAX(batch->delay / 4, FRWD_BATCH_TICK_MIN);
+
+    while (1) {
+        usleep(tick);
+
+        for (idx=0; idx<batch->num; ++idx) {
+            slot = &batch->slot[idx];
+
+            pthread_mutex_lock(&slot->lock);
+            now = frwd_router_now();
+            if (slot->num > 0 && now - slot->stm >= slot->hold) {
+                frwd_batch_flush(ctx, slot);
+            }
+            pthread_mutex_unlock(&slot->lock);
+        }
+    }
+
+    return (void *)-1;
+}
@@ -130,6 +130,40 @@ frwd_cntx_t *frwd_init(const frwd_conf_t *conf, log_cycle_t *log)
             break;
         }
 
+        /* > 初始化路由对象 */
+        frwd->router = frwd_router_creat(&conf->router);
+        if (NULL == frwd->router) {
+            log_fatal(frwd->log, "Create router failed!");
+            break;
+        }
+
+        /* > 初始化对冲对象(未开启时为NULL) */
+        if (conf->router.hedge.enable) {
+            frwd->hedge = frwd_hedge_creat(&conf->router);
+            if (NULL == frwd->hedge) {
+                log_fatal(frwd->log, "Create hedge object failed!");
+                break;
+            }
+        }
+
+        /* > 初始化健康检查对象(未开启时为NULL) */
+        if (conf->router.health.enable) {
+            frwd->health = frwd_health_creat(&conf->router);
+            if (NULL == frwd->health) {
+                log_fatal(frwd->log, "Create health object failed!");
+                break;
+            }
+        }
+
+        /* > 初始化批量发送对象(未开启时为NULL) */
+        if (conf->batch.enable) {
+            frwd->batch = frwd_batch_creat(conf->batch.size, conf->batch.delay);
+            if (NULL == frwd->batch) {
+                log_fatal(frwd->log, "Create batch object failed!");
+                break;
+            }
+        }
+
         /* > 初始化RTMQ服务 */
         frwd->backend = rtmq_init(&conf->backend, frwd->log);
         if (NULL == frwd->backend) {
@@ -174,6 +208,21 @@ int frwd_launch(frwd_cntx_t *frwd)
         return FRWD_ERR;
     }
 
+    if (frwd_hedge_launch(frwd)) {
+        log_fatal(frwd->log, "Start hedge thread failed!");
+        return FRWD_ERR;
+    }
+
+    if (frwd_health_launch(frwd)) {
+        log_fatal(frwd->log, "Start health thread failed!");
+        return FRWD_ERR;
+    }
+
+    if (frwd_batch_launch(frwd)) {
+        log_fatal(frwd->log, "Start batch thread failed!");
+        return FRWD_ERR;
+    }
+
     return FRWD_OK;
 }
 
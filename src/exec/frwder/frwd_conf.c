@@ -8,6 +8,7 @@
  ** 作  者: # Qifeng.zou # 2015.06.09 #
  ******************************************************************************/
 
+#include "mesg.h"
 #include "xml_tree.h"
 #include "frwd_conf.h"
 #include "rtmq_recv.h"
@@ -15,6 +16,9 @@
 static int frwd_conf_parse_comm(xml_tree_t *xml, frwd_conf_t *conf);
 static int frwd_conf_parse_backend(xml_tree_t *xml, const char *path, frwd_conf_t *fcf);
 static int frwd_conf_parse_forward(xml_tree_t *xml, const char *path, frwd_conf_t *fcf);
+static int frwd_conf_parse_router(xml_tree_t *xml, const char *path, frwd_conf_t *fcf);
+static void frwd_conf_router_default(frwd_router_conf_t *conf);
+static int frwd_conf_parse_batch(xml_tree_t *xml, const char *path, frwd_conf_t *fcf);
 
 /******************************************************************************
  **函数名称: frwd_load_conf
@@ -65,6 +69,16 @@ int frwd_load_conf(const char *path, frwd_conf_t *conf, log_cycle_t *log)
             break;
         }
 
+        /* > 提取路由配置 */
+        if (frwd_conf_parse_router(xml, ".FRWDER.ROUTER", conf)) {
+            break;
+        }
+
+        /* > 提取批量发送配置 */
+        if (frwd_conf_parse_batch(xml, ".FRWDER.BATCH", conf)) {
+            break;
+        }
+
         ret = 0;
     } while(0);
 
@@ -469,3 +483,260 @@ static int frwd_conf_parse_forward(xml_tree_t *xml, const char *path, frwd_conf_
 
     return 0;
 }
+
+/******************************************************************************
+ **函数名称: frwd_conf_parse_router
+ **功    能: 加载路由配置
+ **输入参数: 
+ **     xml: XML树
+ **     path: 结点路径
+ **输出参数:
+ **     fcf: 转发配置
+ **返    回: 0:成功 !0:失败
+ **实现描述: 依次提取各分区(PARTITION)及其副本结点(NODE)
+ **注意事项: ROUTER标签及PARTITION均可选, 未配置时默认为单分区单结点(FRWD_DEF_BACKEND_NID),
+ **          保证每个请求都有确定的扇出数, 且写请求只落到一个结点
+ **作    者:
+ ******************************************************************************/
+static int frwd_conf_parse_router(xml_tree_t *xml, const char *path, frwd_conf_t *fcf)
+{
+    int nid;
+    xml_node_t *parent, *node, *part, *item;
+    frwd_router_conf_t *conf = &fcf->router;
+
+    conf->timeout = FRWD_PEND_DEF_TIMEOUT;
+
+    parent = xml_query(xml, path);
+    if (NULL == parent) {
+        frwd_conf_router_default(conf); /* 未配置路由 */
+        return 0;
+    }
+
+    /* > 在途超时时间 */
+    node = xml_search(xml, parent, "TIMEOUT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->timeout = str_to_num(node->value.str);
+        if (conf->timeout <= 0) {
+            conf->timeout = FRWD_PEND_DEF_TIMEOUT;
+        }
+    }
+
+    /* > 对冲配置 */
+    conf->hedge.enable = false;
+    conf->hedge.percentile = 95;
+    conf->hedge.budget = 5;
+    conf->hedge.min_delay = 5;
+    conf->hedge.max = FRWD_HEDGE_DEF_MAX;
+
+    node = xml_search(xml, parent, "HEDGE.ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        conf->hedge.enable = true;
+    }
+
+    node = xml_search(xml, parent, "HEDGE.PERCENTILE");
+    if (NULL != node && 0 != node->value.len) {
+        conf->hedge.percentile = str_to_num(node->value.str);
+        if (conf->hedge.percentile <= 0 || conf->hedge.percentile >= 100) {
+            fprintf(stderr, "%s.HEDGE.PERCENTILE is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, parent, "HEDGE.BUDGET");
+    if (NULL != node && 0 != node->value.len) {
+        conf->hedge.budget = str_to_num(node->value.str);
+        if (conf->hedge.budget < 0 || conf->hedge.budget > 100) {
+            fprintf(stderr, "%s.HEDGE.BUDGET is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, parent, "HEDGE.MIN_DELAY");
+    if (NULL != node && 0 != node->value.len) {
+        conf->hedge.min_delay = str_to_num(node->value.str);
+    }
+
+    node = xml_search(xml, parent, "HEDGE.MAX");
+    if (NULL != node && 0 != node->value.len) {
+        conf->hedge.max = str_to_num(node->value.str);
+        if (conf->hedge.max <= 0) {
+            conf->hedge.max = FRWD_HEDGE_DEF_MAX;
+        }
+    }
+
+    /* > 健康检查配置 */
+    conf->health.enable = false;
+    conf->health.interval = FRWD_HEALTH_DEF_INTERVAL;
+    conf->health.timeout = FRWD_HEALTH_DEF_TIMEOUT;
+    conf->health.fails = FRWD_HEALTH_DEF_FAILS;
+    conf->health.slow_start = FRWD_HEALTH_DEF_SLOW_START;
+
+    node = xml_search(xml, parent, "HEALTH.ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        conf->health.enable = true;
+    }
+
+    node = xml_search(xml, parent, "HEALTH.INTERVAL");
+    if (NULL != node && 0 != node->value.len) {
+        conf->health.interval = str_to_num(node->value.str);
+        if (conf->health.interval <= 0) {
+            fprintf(stderr, "%s.HEALTH.INTERVAL is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, parent, "HEALTH.TIMEOUT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->health.timeout = str_to_num(node->value.str);
+        if (conf->health.timeout <= 0) {
+            fprintf(stderr, "%s.HEALTH.TIMEOUT is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, parent, "HEALTH.FAILS");
+    if (NULL != node && 0 != node->value.len) {
+        conf->health.fails = str_to_num(node->value.str);
+        if (conf->health.fails <= 0) {
+            conf->health.fails = FRWD_HEALTH_DEF_FAILS;
+        }
+    }
+
+    node = xml_search(xml, parent, "HEALTH.SLOW_START");
+    if (NULL != node && 0 != node->value.len) {
+        conf->health.slow_start = str_to_num(node->value.str);
+        if (conf->health.slow_start < 0) {
+            conf->health.slow_start = 0;
+        }
+    }
+
+    /* > 分区配置 */
+    part = xml_search(xml, parent, "PARTITION");
+    for (; NULL != part; part = xml_brother(part)) {
+        if (strcmp(part->name.str, "PARTITION")) {
+            continue;
+        }
+
+        if (conf->part_num >= FRWD_PART_MAX) {
+            fprintf(stderr, "Too many partitions! max:%d\n", FRWD_PART_MAX);
+            return -1;
+        }
+
+        node = xml_search(xml, part, "ID");
+        if (NULL == node || 0 == node->value.len) {
+            fprintf(stderr, "Didn't find %s.PARTITION.ID!\n", path);
+            return -1;
+        }
+
+        conf->part[conf->part_num].id = str_to_num(node->value.str);
+
+        /* > 副本结点 */
+        item = xml_search(xml, part, "NODE");
+        for (; NULL != item; item = xml_brother(item)) {
+            if (strcmp(item->name.str, "NODE")) {
+                continue;
+            }
+
+            node = xml_search(xml, item, "ID");
+            if (NULL == node || 0 == node->value.len) {
+                fprintf(stderr, "Didn't find %s.PARTITION.NODE.ID!\n", path);
+                return -1;
+            }
+
+            nid = str_to_num(node->value.str);
+
+            if (conf->part[conf->part_num].num >= FRWD_REPLICA_MAX) {
+                fprintf(stderr, "Too many replicas! partition:%d max:%d\n",
+                        conf->part[conf->part_num].id, FRWD_REPLICA_MAX);
+                return -1;
+            }
+
+            conf->part[conf->part_num].nid[conf->part[conf->part_num].num++] = nid;
+        }
+
+        if (0 == conf->part[conf->part_num].num) {
+            fprintf(stderr, "Partition hasn't any node! partition:%d\n",
+                    conf->part[conf->part_num].id);
+            return -1;
+        }
+
+        ++conf->part_num;
+    }
+
+    if (0 == conf->part_num) {
+        frwd_conf_router_default(conf); /* 未配置分区 */
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_conf_router_default
+ **功    能: 设置默认路由
+ **输入参数: 
+ **     conf: 路由配置
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 单分区, 唯一副本为FRWD_DEF_BACKEND_NID
+ **注意事项: 未配置路由时仍按分区转发, 避免广播导致写请求重复落盘及搜索应答提前结束
+ **作    者:
+ ******************************************************************************/
+static void frwd_conf_router_default(frwd_router_conf_t *conf)
+{
+    conf->part_num = 1;
+    conf->part[0].id = 1;
+    conf->part[0].num = 1;
+    conf->part[0].nid[0] = FRWD_DEF_BACKEND_NID;
+}
+
+/******************************************************************************
+ **函数名称: frwd_conf_parse_batch
+ **功    能: 加载批量发送配置
+ **输入参数: 
+ **     xml: XML树
+ **     path: 结点路径
+ **输出参数:
+ **     fcf: 转发配置
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: BATCH标签可选, 未配置时不开启批量发送
+ **作    者:
+ ******************************************************************************/
+static int frwd_conf_parse_batch(xml_tree_t *xml, const char *path, frwd_conf_t *fcf)
+{
+    xml_node_t *parent, *node;
+
+    fcf->batch.enable = false;
+    fcf->batch.size = FRWD_BATCH_DEF_SIZE;
+    fcf->batch.delay = FRWD_BATCH_DEF_DELAY;
+
+    parent = xml_query(xml, path);
+    if (NULL == parent) {
+        return 0; /* 未配置批量发送 */
+    }
+
+    node = xml_search(xml, parent, "ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        fcf->batch.enable = true;
+    }
+
+    node = xml_search(xml, parent, "SIZE");
+    if (NULL != node && 0 != node->value.len) {
+        fcf->batch.size = str_to_num(node->value.str);
+        if (fcf->batch.size <= (int)sizeof(mesg_header_t)) {
+            fprintf(stderr, "%s.SIZE is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, parent, "DELAY");
+    if (NULL != node && 0 != node->value.len) {
+        fcf->batch.delay = str_to_num(node->value.str);
+        if (fcf->batch.delay <= 0) {
+            fprintf(stderr, "%s.DELAY is invalid!\n", path);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: frwd_health.c
+ ** 版本号: 1.0
+ ** 描  述: 后端结点健康检查
+ **         周期性向各倒排结点发送MSG_PING, 连续超时达到阈值时判定结点故障并
+ **         将其移出路由; 故障结点重新应答MSG_PONG后进入慢启动, 流量逐步恢复.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "frwd.h"
+
+static void *frwd_health_routine(void *_ctx);
+
+/******************************************************************************
+ **函数名称: frwd_health_creat
+ **功    能: 创建健康检查对象
+ **输入参数:
+ **     conf: 路由配置
+ **输出参数: NONE
+ **返    回: 健康检查对象
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+frwd_health_t *frwd_health_creat(const frwd_router_conf_t *conf)
+{
+    frwd_health_t *health;
+
+    health = (frwd_health_t *)calloc(1, sizeof(frwd_health_t));
+    if (NULL == health) {
+        return NULL;
+    }
+
+    health->interval = (uint64_t)conf->health.interval * 1000;
+    health->timeout = (uint64_t)conf->health.timeout * 1000;
+    health->fails = conf->health.fails;
+
+    pthread_mutex_init(&health->lock, NULL);
+
+    return health;
+}
+
+/******************************************************************************
+ **函数名称: frwd_health_launch
+ **功    能: 启动探测线程
+ **输入参数:
+ **     ctx: 全局对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_health_launch(frwd_cntx_t *ctx)
+{
+    if (NULL == ctx->health) {
+        return FRWD_OK;
+    }
+
+    if (pthread_create(&ctx->health->tid, NULL, frwd_health_routine, (void *)ctx)) {
+        log_error(ctx->log, "Create health thread failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return FRWD_ERR;
+    }
+
+    return FRWD_OK;
+}
+
+/******************************************************************************
+ **函数名称: frwd_health_fail
+ **功    能: 记录一次探测失败
+ **输入参数:
+ **     ctx: 全局对象
+ **     idx: 结点下标
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 连续失败次数达到阈值时, 将结点置为故障
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static void frwd_health_fail(frwd_cntx_t *ctx, int idx)
+{
+    frwd_health_t *health = ctx->health;
+    frwd_probe_t *probe = &health->probe[idx];
+    frwd_node_t *node = &ctx->router->node[idx];
+
+    probe->stm = 0;
+    if (++probe->fails < health->fails || FRWD_NODE_IS_DOWN(node)) {
+        return;
+    }
+
+    node->state = FRWD_NODE_DOWN;
+
+    log_warn(ctx->log, "Backend node is down! nid:%d fails:%d", node->nid, probe->fails);
+}
+
+/******************************************************************************
+ **函数名称: frwd_health_ping
+ **功    能: 向结点发送探测请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     idx: 结点下标
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 探测请求只有报头, 倒排服务将其原样以MSG_PONG返回
+ **注意事项: 调用者已加锁; 发送失败(如: 连接已断开)直接记为一次失败
+ **作    者:
+ ******************************************************************************/
+static void frwd_health_ping(frwd_cntx_t *ctx, int idx, uint64_t now)
+{
+    serial_t serial;
+    mesg_header_t head;
+    frwd_health_t *health = ctx->health;
+    frwd_probe_t *probe = &health->probe[idx];
+    frwd_node_t *node = &ctx->router->node[idx];
+
+    serial.nid = ctx->conf.nid;
+    serial.svrid = 0;
+    serial.seq = ++health->seq;
+
+    MESG_HEAD_SET(&head, MSG_PING, 0, ctx->conf.nid, serial.serial, 0);
+    MESG_HEAD_HTON(&head, &head);
+
+    probe->ptm = now;
+    probe->stm = now;
+    probe->serial = serial.serial;
+
+    if (rtmq_async_send(ctx->backend, MSG_PING, node->nid, (void *)&head, sizeof(head))) {
+        log_error(ctx->log, "Send ping failed! nid:%d", node->nid);
+        frwd_health_fail(ctx, idx);
+    }
+}
+
+/******************************************************************************
+ **函数名称: frwd_health_pong
+ **功    能: 处理探测应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     orig: 源结点ID
+ **     serial: 流水号
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 只接受最近一次探测的应答, 超时后到达的应答不影响判定
+ **     2. 故障结点恢复应答后进入慢启动
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_health_pong(frwd_cntx_t *ctx, int orig, uint64_t serial)
+{
+    int idx;
+    frwd_node_t *node;
+    frwd_probe_t *probe;
+    frwd_health_t *health = ctx->health;
+
+    if (NULL == health) {
+        return FRWD_OK;
+    }
+
+    idx = frwd_router_node_idx(ctx->router, orig);
+    if (idx < 0) {
+        return FRWD_ERR;
+    }
+
+    node = &ctx->router->node[idx];
+    probe = &health->probe[idx];
+
+    pthread_mutex_lock(&health->lock);
+
+    if (0 == probe->stm || probe->serial != serial) {
+        pthread_mutex_unlock(&health->lock);
+        return FRWD_OK; /* 过期应答 */
+    }
+
+    probe->stm = 0;
+    probe->fails = 0;
+
+    if (FRWD_NODE_IS_DOWN(node)) {
+        node->up_tm = frwd_router_now();
+        node->state = FRWD_NODE_SLOW_START;
+        log_info(ctx->log, "Backend node is recovered! nid:%d", node->nid);
+    }
+
+    pthread_mutex_unlock(&health->lock);
+
+    return FRWD_OK;
+}
+
+/******************************************************************************
+ **函数名称: frwd_health_routine
+ **功    能: 探测线程
+ **输入参数:
+ **     _ctx: 全局对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 依次检查各结点:
+ **     1. 在途探测已超时时, 记为一次失败
+ **     2. 无在途探测且已到探测间隔时, 发起新的探测
+ **     3. 慢启动已结束的结点恢复为正常状态
+ **注意事项: 检查粒度为探测间隔与超时时间中较小者的1/4
+ **作    者:
+ ******************************************************************************/
+static void *frwd_health_routine(void *_ctx)
+{
+    int idx;
+    uint64_t now, tick;
+    frwd_node_t *node;
+    frwd_probe_t *probe;
+    frwd_cntx_t *ctx = (frwd_cntx_t *)_ctx;
+    frwd_health_t *health = ctx->health;
+    frwd_router_t *router = ctx->router;
+
+    pthread_detach(pthread_self());
+
+    tick = MIN(health->interval, health->timeout) / 4;
+    if (tick < 1000) {
+        tick = 1000;
+    }
+
+    while (1) {
+        now = frwd_router_now();
+
+        pthread_mutex_lock(&health->lock);
+        for (idx=0; idx<router->node_num; ++idx) {
+            node = &router->node[idx];
+            probe = &health->probe[idx];
+
+            /* > 检查探测超时 */
+            if (0 != probe->stm && now - probe->stm >= health->timeout) {
+                log_debug(ctx->log, "Ping timeout! nid:%d serial:%lu", node->nid, probe->serial);
+                frwd_health_fail(ctx, idx);
+            }
+
+            /* > 结束慢启动 */
+            if (FRWD_NODE_SLOW_START == node->state
+                && now - node->up_tm >= router->slow_start)
+            {
+                node->state = FRWD_NODE_UP;
+                log_info(ctx->log, "Backend node finished slow start! nid:%d", node->nid);
+            }
+
+            /* > 发起探测 */
+            if (0 == probe->stm && now - probe->ptm >= health->interval) {
+                frwd_health_ping(ctx, idx, now);
+            }
+        }
+        pthread_mutex_unlock(&health->lock);
+
+        usleep(tick);
+    }
+
+    return (void *)-1;
+}
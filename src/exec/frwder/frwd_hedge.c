@@ -0,0 +1,405 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: frwd_hedge.c
+ ** 版本号: 1.0
+ ** 描  述: 对冲请求(hedged request)
+ **         原请求在目标结点首帧时延的指定百分位内仍未收到应答时, 向同分区的
+ **         另一副本再发一次; 先到的应答胜出, 落败的应答按serial丢弃.
+ **         对冲数量受令牌预算限制(如: 不超过原请求的5%).
+ ** 作  者:
+ ******************************************************************************/
+#include "frwd.h"
+
+static void *frwd_hedge_routine(void *_ctx);
+
+/* 小根堆操作 */
+#define FRWD_HEDGE_PARENT(i)    (((i) - 1) >> 1)
+#define FRWD_HEDGE_LCHILD(i)    (((i) << 1) + 1)
+
+/******************************************************************************
+ **函数名称: frwd_hedge_creat
+ **功    能: 创建对冲对象
+ **输入参数:
+ **     conf: 路由配置
+ **输出参数: NONE
+ **返    回: 对冲对象
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+frwd_hedge_t *frwd_hedge_creat(const frwd_router_conf_t *conf)
+{
+    frwd_hedge_t *hedge;
+
+    hedge = (frwd_hedge_t *)calloc(1, sizeof(frwd_hedge_t));
+    if (NULL == hedge) {
+        return NULL;
+    }
+
+    hedge->percentile = conf->hedge.percentile;
+    hedge->budget = conf->hedge.budget;
+    hedge->min_delay = (uint64_t)conf->hedge.min_delay * 1000;
+    hedge->max = conf->hedge.max;
+
+    hedge->heap = (frwd_hedge_item_t *)calloc(hedge->max, sizeof(frwd_hedge_item_t));
+    if (NULL == hedge->heap) {
+        free(hedge);
+        return NULL;
+    }
+
+    pthread_mutex_init(&hedge->lock, NULL);
+    pthread_cond_init(&hedge->cond, NULL);
+
+    return hedge;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_launch
+ **功    能: 启动对冲线程
+ **输入参数:
+ **     ctx: 全局对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_hedge_launch(frwd_cntx_t *ctx)
+{
+    if (NULL == ctx->hedge) {
+        return FRWD_OK;
+    }
+
+    if (pthread_create(&ctx->hedge->tid, NULL, frwd_hedge_routine, (void *)ctx)) {
+        log_error(ctx->log, "Create hedge thread failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return FRWD_ERR;
+    }
+
+    return FRWD_OK;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_push
+ **功    能: 将待对冲请求放入小根堆
+ **输入参数:
+ **     hedge: 对冲对象
+ **     item: 待对冲请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 上浮调整
+ **注意事项: 调用者已加锁, 且已确认堆未满
+ **作    者:
+ ******************************************************************************/
+static void frwd_hedge_push(frwd_hedge_t *hedge, const frwd_hedge_item_t *item)
+{
+    int i = hedge->num++;
+
+    while (i > 0 && hedge->heap[FRWD_HEDGE_PARENT(i)].deadline > item->deadline) {
+        hedge->heap[i] = hedge->heap[FRWD_HEDGE_PARENT(i)];
+        i = FRWD_HEDGE_PARENT(i);
+    }
+
+    hedge->heap[i] = *item;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_pop
+ **功    能: 弹出对冲时间最早的请求
+ **输入参数:
+ **     hedge: 对冲对象
+ **输出参数:
+ **     item: 待对冲请求
+ **返    回: VOID
+ **实现描述: 将末尾元素放至堆顶后下沉调整
+ **注意事项: 调用者已加锁, 且已确认堆非空
+ **作    者:
+ ******************************************************************************/
+static void frwd_hedge_pop(frwd_hedge_t *hedge, frwd_hedge_item_t *item)
+{
+    int i = 0, child;
+    frwd_hedge_item_t *last;
+
+    *item = hedge->heap[0];
+
+    last = &hedge->heap[--hedge->num];
+    while ((child = FRWD_HEDGE_LCHILD(i)) < hedge->num) {
+        if (child + 1 < hedge->num
+            && hedge->heap[child + 1].deadline < hedge->heap[child].deadline)
+        {
+            ++child;
+        }
+
+        if (last->deadline <= hedge->heap[child].deadline) {
+            break;
+        }
+
+        hedge->heap[i] = hedge->heap[child];
+        i = child;
+    }
+
+    hedge->heap[i] = *last;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_charge
+ **功    能: 积累令牌并预扣一个对冲请求的令牌
+ **输入参数:
+ **     hedge: 对冲对象
+ **输出参数: NONE
+ **返    回: true:已扣除 false:令牌不足
+ **实现描述: 按预算比例增加令牌(不超过上限), 足够一个对冲请求时同时扣除;
+ **          以CAS更新, 无需加锁
+ **注意事项: 每个原请求调用一次
+ **作    者:
+ ******************************************************************************/
+static bool frwd_hedge_charge(frwd_hedge_t *hedge)
+{
+    bool is_charged;
+    int64_t old, tokens;
+
+    do {
+        old = hedge->tokens;
+        tokens = MIN(old + hedge->budget * (FRWD_HEDGE_TOKEN / 100), FRWD_HEDGE_TOKEN_MAX);
+        is_charged = (tokens >= FRWD_HEDGE_TOKEN);
+        if (is_charged) {
+            tokens -= FRWD_HEDGE_TOKEN;
+        }
+    } while (!__sync_bool_compare_and_swap(&hedge->tokens, old, tokens));
+
+    return is_charged;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_add
+ **功    能: 登记待对冲请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     serial: 请求流水号
+ **     part: 分区下标
+ **     idx: 原请求的结点下标
+ **     fanout: 原请求的扇出数
+ **     type: 消息类型
+ **     data: 请求数据
+ **     len: 数据长度
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: 0:已登记 !0:无需对冲
+ **实现描述:
+ **     1. 每个原请求按预算比例积累令牌, 并预先扣除一个对冲请求的令牌(无锁)
+ **     2. 令牌不足时不登记, 因此绝大多数请求既不加锁也不拷贝数据
+ **     3. 对冲时间 = 当前时间 + MAX(原结点首帧时延的百分位, 最小对冲延迟)
+ **注意事项:
+ **     1. 只有存在其他副本的分区才需要对冲
+ **     2. 登记失败或最终无需对冲时, 归还预先扣除的令牌
+ **作    者:
+ ******************************************************************************/
+int frwd_hedge_add(frwd_cntx_t *ctx, uint64_t serial, int part,
+        int idx, int fanout, int type, const void *data, size_t len, uint64_t now)
+{
+    uint64_t delay;
+    frwd_hedge_item_t item;
+    frwd_hedge_t *hedge = ctx->hedge;
+    frwd_router_t *router = ctx->router;
+
+    if (NULL == hedge || router->part[part].num < 2) {
+        return -1;
+    }
+
+    /* > 积累并预扣令牌 */
+    if (!frwd_hedge_charge(hedge)) {
+        return -1; /* 预算不足 */
+    }
+
+    delay = frwd_node_percentile(&router->node[idx], hedge->percentile);
+    if (delay < hedge->min_delay) {
+        delay = hedge->min_delay;
+    }
+
+    /* > 拷贝请求数据(无需持锁) */
+    item.data = (void *)malloc(len);
+    if (NULL == item.data) {
+        FRWD_HEDGE_REFUND(hedge);
+        return -1;
+    }
+
+    memcpy(item.data, data, len);
+    item.len = len;
+    item.type = type;
+    item.serial = serial;
+    item.part = part;
+    item.idx = idx;
+    item.fanout = fanout;
+    item.deadline = now + delay;
+
+    /* > 登记待对冲请求 */
+    pthread_mutex_lock(&hedge->lock);
+
+    if (hedge->num >= hedge->max) {
+        pthread_mutex_unlock(&hedge->lock);
+        free(item.data);
+        FRWD_HEDGE_REFUND(hedge);
+        return -1; /* 队列已满 */
+    }
+
+    frwd_hedge_push(hedge, &item);
+    if (hedge->heap[0].serial == serial) {
+        pthread_cond_signal(&hedge->cond); /* 堆顶变化 */
+    }
+
+    pthread_mutex_unlock(&hedge->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_select
+ **功    能: 选择对冲请求的目标结点
+ **输入参数:
+ **     router: 路由对象
+ **     part: 分区下标
+ **     idx: 原请求的结点下标
+ **输出参数: NONE
+ **返    回: 目标结点下标(-1:无可用结点)
+ **实现描述: 从同分区的其他正常副本中选择负载最低者
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int frwd_hedge_select(frwd_router_t *router, int part, int idx)
+{
+    int i, node, best = -1;
+    uint64_t load, min = (uint64_t)-1;
+
+    for (i=0; i<router->part[part].num; ++i) {
+        node = router->part[part].node[i];
+        if (node == idx || FRWD_NODE_IS_DOWN(&router->node[node])) {
+            continue;
+        }
+
+        load = frwd_node_load(&router->node[node]);
+        if (load < min) {
+            min = load;
+            best = node;
+        }
+    }
+
+    return best;
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_send
+ **功    能: 发送对冲请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     item: 待对冲请求
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 原请求已收到应答、在途超时或已超过截止时间时, 无需对冲
+ **     2. 发给同分区负载最低的其他副本
+ **注意事项: 令牌已在登记时扣除, 未发出对冲请求时归还
+ **作    者:
+ ******************************************************************************/
+static void frwd_hedge_send(frwd_cntx_t *ctx, frwd_hedge_item_t *item, uint64_t now)
+{
+    int idx;
+    frwd_hedge_t *hedge = ctx->hedge;
+    frwd_router_t *router = ctx->router;
+
+    if (MESG_DEADLINE_IS_EXPIRED(MESG_NHEAD_FLAG((mesg_header_t *)item->data))) {
+        FRWD_HEDGE_REFUND(hedge);
+        return;
+    }
+
+    idx = frwd_hedge_select(router, item->part, item->idx);
+    if (idx < 0) {
+        FRWD_HEDGE_REFUND(hedge);
+        return;
+    }
+
+    /* > 标记原请求已对冲(原请求已应答时放弃) */
+    if (frwd_pend_hedge(router, item->serial, item->idx)) {
+        FRWD_HEDGE_REFUND(hedge);
+        return;
+    }
+
+    log_debug(ctx->log, "Send hedged request! serial:%lu partition:%d nid:%d -> %d",
+            item->serial, router->part[item->part].id,
+            router->node[item->idx].nid, router->node[idx].nid);
+
+    if (frwd_pend_add(router, item->serial, idx, item->part, item->fanout, true, now)) {
+        FRWD_HEDGE_REFUND(hedge);
+        log_error(ctx->log, "Pending table is full! serial:%lu", item->serial);
+        return;
+    }
+
+    if (rtmq_async_send(ctx->backend, item->type, router->node[idx].nid, item->data, item->len)) {
+        frwd_pend_del(router, item->serial, idx);
+        FRWD_HEDGE_REFUND(hedge);
+        log_error(ctx->log, "Push hedged request failed! serial:%lu nid:%d",
+                item->serial, router->node[idx].nid);
+    }
+}
+
+/******************************************************************************
+ **函数名称: frwd_hedge_routine
+ **功    能: 对冲线程
+ **输入参数:
+ **     _ctx: 全局对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 等待至堆顶请求的对冲时间, 弹出并处理
+ **     2. 周期性衰减各结点的时延直方图
+ **注意事项: 最多等待1秒, 以保证衰减的周期性
+ **作    者:
+ ******************************************************************************/
+static void *frwd_hedge_routine(void *_ctx)
+{
+    uint64_t now, wake;
+    struct timespec ts;
+    frwd_hedge_item_t item;
+    time_t decay_tm = time(NULL);
+    frwd_cntx_t *ctx = (frwd_cntx_t *)_ctx;
+    frwd_hedge_t *hedge = ctx->hedge;
+
+    pthread_detach(pthread_self());
+
+    while (1) {
+        now = frwd_router_now();
+
+        /* > 衰减时延直方图 */
+        if (time(NULL) - decay_tm >= FRWD_HEDGE_DECAY_SEC) {
+            frwd_router_decay(ctx->router);
+            decay_tm = time(NULL);
+        }
+
+        pthread_mutex_lock(&hedge->lock);
+
+        if (0 == hedge->num || hedge->heap[0].deadline > now) {
+            wake = now + 1000000;
+            if (hedge->num > 0 && hedge->heap[0].deadline < wake) {
+                wake = hedge->heap[0].deadline;
+            }
+
+            ts.tv_sec = wake / 1000000;
+            ts.tv_nsec = (wake % 1000000) * 1000;
+
+            pthread_cond_timedwait(&hedge->cond, &hedge->lock, &ts);
+            pthread_mutex_unlock(&hedge->lock);
+            continue;
+        }
+
+        frwd_hedge_pop(hedge, &item);
+
+        pthread_mutex_unlock(&hedge->lock);
+
+        /* > 发送对冲请求 */
+        frwd_hedge_send(ctx, &item, now);
+
+        free(item.data);
+    }
+
+    return (void *)-1;
+}
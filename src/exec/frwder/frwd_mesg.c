@@ -22,6 +22,12 @@ static int frwd_search_rsp_hdl(int type, int orig, char *data, size_t len, void
 static int frwd_insert_word_req_hdl(int type, int orig, char *data, size_t len, void *args);
 static int frwd_insert_word_rsp_hdl(int type, int orig, char *data, size_t len, void *args);
 
+static int frwd_pong_hdl(int type, int orig, char *data, size_t len, void *args);
+
+static int frwd_cancel_req_hdl(int type, int orig, char *data, size_t len, void *args);
+
+static int frwd_busy_rsp(frwd_cntx_t *ctx, int type, const mesg_header_t *head);
+
 /******************************************************************************
  **函数名称: frwd_set_reg
  **功    能: 注册处理回调
@@ -62,6 +68,10 @@ static int frwd_reg_req_cb(frwd_cntx_t *frwd)
 
     FRWD_REG_REQ_CB(frwd, MSG_SEARCH_REQ, frwd_search_req_hdl, frwd);
     FRWD_REG_REQ_CB(frwd, MSG_INSERT_WORD_REQ, frwd_insert_word_req_hdl, frwd);
+    FRWD_REG_REQ_CB(frwd, MSG_CANCEL_REQ, frwd_cancel_req_hdl, frwd);
+    FRWD_REG_REQ_CB(frwd, MSG_SUGGEST_REQ, frwd_search_req_hdl, frwd); /* 与搜索请求同路由 */
+    FRWD_REG_REQ_CB(frwd, MSG_INDEX_DOC_REQ, frwd_insert_word_req_hdl, frwd); /* 与插入请求同路由 */
+    FRWD_REG_REQ_CB(frwd, MSG_SET_DOC_SCORE_REQ, frwd_insert_word_req_hdl, frwd); /* 与插入请求同路由 */
 
     return FRWD_OK;
 }
@@ -87,10 +97,97 @@ static int frwd_reg_rsp_cb(frwd_cntx_t *frwd)
 
     FRWD_REG_RSP_CB(frwd, MSG_SEARCH_RSP, frwd_search_rsp_hdl, frwd);
     FRWD_REG_RSP_CB(frwd, MSG_INSERT_WORD_RSP, frwd_insert_word_rsp_hdl, frwd);
+    FRWD_REG_RSP_CB(frwd, MSG_PONG, frwd_pong_hdl, frwd);
+    FRWD_REG_RSP_CB(frwd, MSG_SUGGEST_RSP, frwd_search_rsp_hdl, frwd);
+    FRWD_REG_RSP_CB(frwd, MSG_INDEX_DOC_RSP, frwd_insert_word_rsp_hdl, frwd);
+    FRWD_REG_RSP_CB(frwd, MSG_SET_DOC_SCORE_RSP, frwd_insert_word_rsp_hdl, frwd);
 
     return FRWD_OK;
 }
 
+/******************************************************************************
+ **函数名称: frwd_busy_rsp
+ **功    能: 代替后端发送繁忙(失败)应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     type: 请求类型
+ **     head: 请求报头(网络字节序)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 按请求类型构造对应的应答(不携带扇出数), 经下行通道发给帧听层
+ **     1. 搜索请求: SEARCH-RSP, 返回码为SRCH_CODE_BUSY
+ **     2. 搜索建议: 建议数为0
+ **     3. 写请求: 应答码为失败, 并带回请求中的关键字或URL
+ **注意事项: 请求未能发往任何结点时调用, 避免帧听层只能等到超时
+ **作    者:
+ ******************************************************************************/
+static int frwd_busy_rsp(frwd_cntx_t *ctx, int type, const mesg_header_t *head)
+{
+    int len, rsp_type;
+    serial_t serial;
+    mesg_header_t *rsp;
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_index_doc_rsp_t) + SRCH_WORD_LEN];
+
+    memset(addr, 0, sizeof(addr));
+
+    rsp = (mesg_header_t *)addr;
+    serial.serial = MESG_NHEAD_SERIAL(head);
+
+    switch (type) {
+        case MSG_SEARCH_REQ:
+            rsp_type = MSG_SEARCH_RSP;
+            len = snprintf(rsp->body, sizeof(addr) - sizeof(mesg_header_t),
+                    "<SEARCH-RSP CODE=\"%s\"/>", SRCH_CODE_BUSY);
+            break;
+        case MSG_SUGGEST_REQ:
+            rsp_type = MSG_SUGGEST_RSP;
+            len = MESG_SUGGEST_RSP_LEN(0); /* 建议数为0 */
+            break;
+        case MSG_INSERT_WORD_REQ:
+        {
+            mesg_insert_word_rsp_t *body = (mesg_insert_word_rsp_t *)rsp->body;
+            const mesg_insert_word_req_t *req = (const mesg_insert_word_req_t *)(head + 1);
+
+            rsp_type = MSG_INSERT_WORD_RSP;
+            body->code = htonl(MESG_INSERT_WORD_FAIL);
+            memcpy(body->word, req->word, sizeof(body->word));
+            len = sizeof(mesg_insert_word_rsp_t);
+            break;
+        }
+        case MSG_INDEX_DOC_REQ:
+        {
+            mesg_index_doc_rsp_t *body = (mesg_index_doc_rsp_t *)rsp->body;
+            const mesg_index_doc_req_t *req = (const mesg_index_doc_req_t *)(head + 1);
+
+            rsp_type = MSG_INDEX_DOC_RSP;
+            body->code = htonl(MESG_INDEX_DOC_FAIL);
+            memcpy(body->url, req->url, sizeof(body->url));
+            len = sizeof(mesg_index_doc_rsp_t);
+            break;
+        }
+        case MSG_SET_DOC_SCORE_REQ:
+        {
+            mesg_set_doc_score_rsp_t *body = (mesg_set_doc_score_rsp_t *)rsp->body;
+            const mesg_set_doc_score_req_t *req = (const mesg_set_doc_score_req_t *)(head + 1);
+
+            rsp_type = MSG_SET_DOC_SCORE_RSP;
+            body->code = htonl(MESG_SET_DOC_SCORE_FAIL);
+            body->score = req->score; /* 均为网络字节序 */
+            memcpy(body->url, req->url, sizeof(body->url));
+            len = sizeof(mesg_set_doc_score_rsp_t);
+            break;
+        }
+        default:
+            log_error(ctx->log, "Unknown request type! type:%d", type);
+            return FRWD_ERR;
+    }
+
+    MESG_HEAD_SET(rsp, rsp_type, MESG_NHEAD_SID(head), ntohl(head->nid), serial.serial, len);
+    MESG_HEAD_HTON(rsp, rsp);
+
+    return frwd_batch_send(ctx, rsp_type, serial.nid, addr, MESG_TOTAL_LEN(len));
+}
+
 /******************************************************************************
  **函数名称: frwd_search_req_hdl
  **功    能: 搜索关键字请求处理
@@ -103,25 +200,76 @@ static int frwd_reg_rsp_cb(frwd_cntx_t *frwd)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述: 将收到的请求转发给倒排服务
- **注意事项:
+ **     1. 每个分区只发给负载最低的一个副本(power-of-two-choices),
+ **        并在在途请求中记录扇出数(实际发出的结点数), 供应答时写入报头
+ **     2. 在途表已满或未能发往任何结点时, 直接回复繁忙应答
+ **     3. 开启对冲时, 登记待对冲请求(超过时延百分位仍未应答时发给其他副本)
+ **     4. 已超过截止时间的请求直接丢弃
+ **注意事项: 报头保持网络字节序, 只通过MESG_NHEAD_XXX()读取所需字段
  **作    者: # Qifeng.zou # 2016.02.23 20:25:53 #
  ******************************************************************************/
 static int frwd_search_req_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int i, num, nid, sent;
+    uint64_t serial, now;
+    int idx[FRWD_PART_MAX], part[FRWD_PART_MAX];
     frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    frwd_router_t *router = ctx->router;
     mesg_header_t *head = (mesg_header_t *)data;
 
-    /* > 转换字节序 */
-    MESG_HEAD_NTOH(head, head);
+    serial = MESG_NHEAD_SERIAL(head);
 
-    log_trace(ctx->log, "sid:%lu serial:%lu type:%d len:%d flag:%d chksum:[0x%X/0x%X]",
-            head->sid, head->serial, head->type,
-            head->length, head->flag, head->chksum, MSG_CHKSUM_VAL);
+    log_trace(ctx->log, "sid:%lu serial:%lu type:%u len:%u flag:%u",
+            MESG_NHEAD_SID(head), serial, MESG_NHEAD_TYPE(head),
+            MESG_NHEAD_LENGTH(head), MESG_NHEAD_FLAG(head));
 
-    MESG_HEAD_HTON(head, head);
+    /* > 丢弃已超时的请求 */
+    if (MESG_DEADLINE_IS_EXPIRED(MESG_NHEAD_FLAG(head))) {
+        log_warn(ctx->log, "Request is expired! serial:%lu", serial);
+        return 0;
+    }
 
-    /* > 发送数据 */
-    return rtmq_publish(ctx->backend, type, data, len);
+    /* > 按分区选择负载最低的副本 */
+    now = frwd_router_now();
+    num = frwd_router_select(router, serial, idx, part);
+
+    /* > 登记在途请求(表满时拒绝, 否则应答无法携带扇出数) */
+    for (i=0; i<num; ++i) {
+        if (frwd_pend_add(router, serial, idx[i], part[i], num, false, now)) {
+            log_error(ctx->log, "Pending table is full! serial:%lu", serial);
+            frwd_pend_cancel(router, serial);
+            return frwd_busy_rsp(ctx, type, head);
+        }
+    }
+
+    /* > 发送请求(只保留发送成功的结点) */
+    for (i=0, sent=0; i<num; ++i) {
+        nid = router->node[idx[i]].nid;
+
+        if (rtmq_async_send(ctx->backend, type, nid, data, len)) {
+            frwd_pend_del(router, serial, idx[i]);
+            log_error(ctx->log, "Push data into send queue failed! serial:%lu nid:%d", serial, nid);
+            continue;
+        }
+
+        idx[sent] = idx[i];
+        part[sent] = part[i];
+        ++sent;
+    }
+
+    if (0 == sent) {
+        log_error(ctx->log, "Send request failed! serial:%lu num:%d", serial, num);
+        return frwd_busy_rsp(ctx, type, head);
+    }
+
+    for (i=0; i<sent; ++i) {
+        if (sent < num) {
+            frwd_pend_fanout(router, serial, idx[i], sent); /* 修正扇出数 */
+        }
+        frwd_hedge_add(ctx, serial, part[i], idx[i], sent, type, data, len, now);
+    }
+
+    return 0;
 }
 
 /******************************************************************************
@@ -135,22 +283,47 @@ static int frwd_search_req_hdl(int type, int orig, char *data, size_t len, void
  **     args: 附加参数
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 将收到的搜索应答转发至帧听层
- **注意事项:
+ **实现描述:
+ **     1. 在每帧应答中写入扇出数, 帧听层收齐所有结点的末帧应答才结束请求
+ **     2. 将收到的搜索应答转发至帧听层(开启批量发送时合并发送)
+ **注意事项: 已对冲的请求只转发先到的应答, 落败结点的应答直接丢弃
  **作    者: # Qifeng.zou # 2015.06.10 #
  ******************************************************************************/
 static int frwd_search_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int idx;
+    uint64_t now;
+    frwd_pend_t pend;
     serial_t serial;
     frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    frwd_router_t *router = ctx->router;
     mesg_header_t *head = (mesg_header_t *)data;
 
-    log_trace(ctx->log, "sid:%lu serial:%lu", ntoh64(head->sid), ntoh64(head->serial));
+    serial.serial = MESG_NHEAD_SERIAL(head);
 
-    serial.serial = ntoh64(head->serial);
+    log_trace(ctx->log, "sid:%lu serial:%lu", MESG_NHEAD_SID(head), serial.serial);
+
+    /* > 更新结点负载统计 */
+    idx = frwd_router_node_idx(router, orig);
+    if (idx >= 0) {
+        now = frwd_router_now();
+        if (!frwd_pend_done(router, serial.serial, idx,
+                !(MESG_NHEAD_FLAG(head) & MESG_FLAG_MORE), now, &pend))
+        {
+            if (pend.is_hedged
+                && !frwd_pend_claim(router, serial.serial, pend.part, idx, now))
+            {
+                log_trace(ctx->log, "Drop hedged loser! serial:%lu nid:%d", serial.serial, orig);
+                return 0;
+            }
+
+            /* > 写入扇出数 */
+            head->flag = htonl(MESG_FANOUT_SET(MESG_NHEAD_FLAG(head), pend.fanout));
+        }
+    }
 
     /* > 发送数据 */
-    if (rtmq_async_send(ctx->forward, type, serial.nid, data, len)) {
+    if (frwd_batch_send(ctx, type, serial.nid, data, len)) {
         log_error(ctx->log, "Push data into send queue failed! type:%u", type);
         return -1;
     }
@@ -158,6 +331,20 @@ static int frwd_search_rsp_hdl(int type, int orig, char *data, size_t len, void
     return 0;
 }
 
+/* 取写请求报体中的文档URL(报体为网络字节序, URL为字符数组无需转换) */
+static const char *frwd_doc_url(int type, const char *body)
+{
+    switch (type) {
+        case MSG_INSERT_WORD_REQ:
+            return ((const mesg_insert_word_req_t *)body)->url;
+        case MSG_INDEX_DOC_REQ:
+            return ((const mesg_index_doc_req_t *)body)->url;
+        case MSG_SET_DOC_SCORE_REQ:
+            return ((const mesg_set_doc_score_req_t *)body)->url;
+    }
+    return NULL;
+}
+
 /******************************************************************************
  **函数名称: frwd_insert_word_req_hdl
  **功    能: 插入关键字的请求
@@ -169,18 +356,71 @@ static int frwd_search_rsp_hdl(int type, int orig, char *data, size_t len, void
  **     args: 附加参数
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
- **注意事项:
+ **实现描述: 插入关键字、文档索引及设置静态得分等写请求共用
+ **     1. 按URL哈希确定文档所属分区, 发给该分区的所有可用副本,
+ **        并在在途请求中记录扇出数(实际发出的结点数), 供应答时写入报头
+ **     2. 副本全部故障、在途表已满或未能发往任何结点时, 直接回复失败应答
+ **注意事项: 报头保持网络字节序, 只通过MESG_NHEAD_XXX()读取所需字段
  **作    者: # Qifeng.zou # 2016.02.23 20:26:55 #
  ******************************************************************************/
 static int frwd_insert_word_req_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    const char *url;
+    uint64_t serial, now;
+    int i, num, nid, sent, part, idx[FRWD_REPLICA_MAX];
     frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    frwd_router_t *router = ctx->router;
+    mesg_header_t *head = (mesg_header_t *)data;
 
-    /* > 发送数据 */
-    if (rtmq_async_send(ctx->backend, type, 30001, data, len)) {
-        log_error(ctx->log, "Push data into send queue failed! type:%u", type);
-        return -1;
+    if (len < MESG_TOTAL_LEN(mesg_forward_body_min(type))) {
+        log_error(ctx->log, "Data length is invalid! type:%u len:%lu", type, len);
+        return FRWD_ERR;
+    }
+
+    serial = MESG_NHEAD_SERIAL(head);
+
+    /* > 按URL哈希选择所属分区的副本 */
+    url = frwd_doc_url(type, (const char *)(head + 1));
+
+    num = frwd_router_owner(router, url, URL_MAX_LEN, idx, &part);
+    if (0 == num) {
+        log_error(ctx->log, "All replicas are down! serial:%lu part:%d",
+                serial, router->part[part].id);
+        return frwd_busy_rsp(ctx, type, head);
+    }
+
+    /* > 登记在途请求(表满时拒绝, 否则应答无法携带扇出数) */
+    now = frwd_router_now();
+    for (i=0; i<num; ++i) {
+        if (frwd_pend_add(router, serial, idx[i], part, num, false, now)) {
+            log_error(ctx->log, "Pending table is full! serial:%lu", serial);
+            frwd_pend_cancel(router, serial);
+            return frwd_busy_rsp(ctx, type, head);
+        }
+    }
+
+    /* > 发送请求(只保留发送成功的结点) */
+    for (i=0, sent=0; i<num; ++i) {
+        nid = router->node[idx[i]].nid;
+
+        if (rtmq_async_send(ctx->backend, type, nid, data, len)) {
+            frwd_pend_del(router, serial, idx[i]);
+            log_error(ctx->log, "Push data into send queue failed! serial:%lu nid:%d", serial, nid);
+            continue;
+        }
+
+        idx[sent++] = idx[i];
+    }
+
+    if (0 == sent) {
+        log_error(ctx->log, "Send request failed! serial:%lu num:%d", serial, num);
+        return frwd_busy_rsp(ctx, type, head);
+    }
+
+    if (sent < num) {
+        for (i=0; i<sent; ++i) {
+            frwd_pend_fanout(router, serial, idx[i], sent); /* 修正扇出数 */
+        }
     }
 
     return 0;
@@ -198,27 +438,109 @@ static int frwd_insert_word_req_hdl(int type, int orig, char *data, size_t len,
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
+ **     1. 在应答中写入扇出数, 帧听层收齐所属分区各副本的应答才结束请求
+ **     2. 将收到的应答转发至帧听层
  **注意事项:
  **作    者: # Qifeng.zou # 2015.06.10 #
  ******************************************************************************/
 static int frwd_insert_word_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int idx;
+    frwd_pend_t pend;
     serial_t serial;
     frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    frwd_router_t *router = ctx->router;
     mesg_header_t *head = (mesg_header_t *)data;
 
-    MESG_HEAD_NTOH(head, head);
+    serial.serial = MESG_NHEAD_SERIAL(head);
 
-    serial.serial = head->serial;
-    log_trace(ctx->log, "serial:%lu", head->serial);
+    log_trace(ctx->log, "serial:%lu", serial.serial);
 
-    MESG_HEAD_HTON(head, head);
+    /* > 写入扇出数 */
+    idx = frwd_router_node_idx(router, orig);
+    if (idx >= 0
+        && !frwd_pend_done(router, serial.serial, idx,
+            !(MESG_NHEAD_FLAG(head) & MESG_FLAG_MORE), frwd_router_now(), &pend))
+    {
+        head->flag = htonl(MESG_FANOUT_SET(MESG_NHEAD_FLAG(head), pend.fanout));
+    }
 
     /* > 发送数据 */
-    if (rtmq_async_send(ctx->forward, type, serial.nid, data, len)) {
+    if (frwd_batch_send(ctx, type, serial.nid, data, len)) {
         log_error(ctx->log, "Push data into send queue failed! type:%u", type);
         return -1;
     }
 
     return 0;
 }
+
+/******************************************************************************
+ **函数名称: frwd_pong_hdl
+ **功    能: 探测应答处理
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 应答数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 交由健康检查模块更新结点状态
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int frwd_pong_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data;
+
+    if (len < sizeof(mesg_header_t)) {
+        return FRWD_ERR;
+    }
+
+    return frwd_health_pong(ctx, orig, MESG_NHEAD_SERIAL(head));
+}
+
+/******************************************************************************
+ **函数名称: frwd_cancel_req_hdl
+ **功    能: 取消请求处理
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 取消请求
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 删除对应的在途请求(同时撤销尚未发出的对冲请求)
+ **     2. 广播至所有倒排服务, 由其丢弃尚未处理的请求
+ **注意事项: 报文保持网络字节序原样转发
+ **作    者:
+ ******************************************************************************/
+static int frwd_cancel_req_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    uint32_t i, num;
+    frwd_cntx_t *ctx = (frwd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data;
+    mesg_cancel_req_t *req = (mesg_cancel_req_t *)(head + 1);
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_cancel_req_t))) {
+        log_error(ctx->log, "Cancel request is too short! len:%lu", len);
+        return FRWD_ERR;
+    }
+
+    num = ntohl(req->num);
+    if (num > MESG_CANCEL_MAX_NUM || len < MESG_TOTAL_LEN(MESG_CANCEL_REQ_LEN(num))) {
+        log_error(ctx->log, "Cancel request is invalid! num:%u len:%lu", num, len);
+        return FRWD_ERR;
+    }
+
+    log_debug(ctx->log, "Cancel request! sid:%lu num:%u", MESG_NHEAD_SID(head), num);
+
+    for (i=0; i<num; ++i) {
+        frwd_pend_cancel(ctx->router, ntoh64(req->serial[i]));
+    }
+
+    return rtmq_publish(ctx->backend, type, data, len);
+}
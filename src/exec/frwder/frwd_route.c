@@ -0,0 +1,862 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: frwd_route.c
+ ** 版本号: 1.0
+ ** 描  述: 分区副本路由
+ **         1. 按结点统计在途请求数及首帧应答时延(EWMA)
+ **         2. 每个分区从副本中随机取两个, 选择负载较低者(power-of-two-choices)
+ **         3. 在途表以(serial, 结点)为键, 分段加锁的线性探测开放寻址哈希表
+ **         4. 写请求按URL哈希落到所属分区, 发给该分区的所有副本
+ ** 作  者:
+ ******************************************************************************/
+#include "frwd_route.h"
+
+/* 在途表哈希 */
+static inline uint64_t frwd_pend_hash(uint64_t serial, int idx)
+{
+    uint64_t h = serial ^ ((uint64_t)(idx + 1) * 0x9E3779B97F4A7C15ULL);
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+#define FRWD_PEND_STRIPE(h)     ((h) & (FRWD_PEND_STRIPE_NUM - 1))
+#define FRWD_PEND_HOME(h)       (((h) >> 8) & (FRWD_PEND_STRIPE_SIZE - 1))
+#define FRWD_PEND_NEXT(pos)     (((pos) + 1) & (FRWD_PEND_STRIPE_SIZE - 1))
+
+/******************************************************************************
+ **函数名称: frwd_router_now
+ **功    能: 获取当前时间(微秒)
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 当前时间
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+uint64_t frwd_router_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/******************************************************************************
+ **函数名称: frwd_router_creat
+ **功    能: 创建路由对象
+ **输入参数:
+ **     conf: 路由配置
+ **输出参数: NONE
+ **返    回: 路由对象
+ **实现描述: 将各分区的副本结点ID映射为结点列表的下标, 相同结点只保留一份
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+frwd_router_t *frwd_router_creat(const frwd_router_conf_t *conf)
+{
+    int i, j, idx, pos;
+    frwd_router_t *router;
+
+    router = (frwd_router_t *)calloc(1, sizeof(frwd_router_t));
+    if (NULL == router) {
+        return NULL;
+    }
+
+    router->timeout = (uint64_t)conf->timeout * 1000;
+    router->slow_start = (uint64_t)conf->health.slow_start * 1000;
+
+    /* > 构建分区及结点列表 */
+    for (i=0; i<conf->part_num; ++i) {
+        router->part[i].id = conf->part[i].id;
+        for (j=0; j<conf->part[i].num; ++j) {
+            idx = frwd_router_node_idx(router, conf->part[i].nid[j]);
+            if (idx < 0) {
+                if (router->node_num >= FRWD_NODE_MAX) {
+                    free(router);
+                    return NULL;
+                }
+                idx = router->node_num++;
+                router->node[idx].nid = conf->part[i].nid[j];
+            }
+            router->part[i].node[router->part[i].num++] = idx;
+            router->node[idx].part_mask |= (1ULL << i);
+        }
+    }
+    router->part_num = conf->part_num;
+
+    /* > 创建在途表 */
+    router->pend = (frwd_pend_stripe_t *)calloc(FRWD_PEND_STRIPE_NUM, sizeof(frwd_pend_stripe_t));
+    if (NULL == router->pend) {
+        free(router);
+        return NULL;
+    }
+
+    for (i=0; i<FRWD_PEND_STRIPE_NUM; ++i) {
+        pthread_mutex_init(&router->pend[i].lock, NULL);
+        for (pos=0; pos<FRWD_PEND_STRIPE_SIZE; ++pos) {
+            router->pend[i].slot[pos].idx = -1;
+        }
+    }
+
+    return router;
+}
+
+/******************************************************************************
+ **函数名称: frwd_router_node_idx
+ **功    能: 通过结点ID查找结点下标
+ **输入参数:
+ **     router: 路由对象
+ **     nid: 结点ID
+ **输出参数: NONE
+ **返    回: 结点下标(-1:不存在)
+ **实现描述: 结点数较少, 直接遍历
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_router_node_idx(frwd_router_t *router, int nid)
+{
+    int idx;
+
+    for (idx=0; idx<router->node_num; ++idx) {
+        if (router->node[idx].nid == nid) {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ **函数名称: frwd_node_load
+ **功    能: 计算结点负载
+ **输入参数:
+ **     node: 结点
+ **输出参数: NONE
+ **返    回: 负载值(越小越空闲)
+ **实现描述: (在途请求数+1) * 平均时延, 即预计排队完成时间
+ **注意事项: 尚无时延样本时按1微秒计, 保证新结点能被尽快探测
+ **作    者:
+ ******************************************************************************/
+uint64_t frwd_node_load(const frwd_node_t *node)
+{
+    uint64_t ewma = node->ewma;
+
+    return (uint64_t)(node->inflight + 1) * (ewma ? ewma : 1);
+}
+
+/******************************************************************************
+ **函数名称: frwd_node_is_avail
+ **功    能: 判断结点能否接收本次请求
+ **输入参数:
+ **     router: 路由对象
+ **     node: 结点
+ **     h: 随机值(由serial派生)
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: true:可用 false:不可用
+ **实现描述:
+ **     1. 故障结点不可用
+ **     2. 慢启动结点按恢复时长占慢启动时长的比例接收请求, 避免冷结点被瞬间压垮
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static bool frwd_node_is_avail(const frwd_router_t *router,
+        const frwd_node_t *node, uint64_t h, uint64_t now)
+{
+    uint64_t elapse;
+
+    switch (node->state) {
+        case FRWD_NODE_DOWN:
+            return false;
+        case FRWD_NODE_SLOW_START:
+            elapse = now - node->up_tm;
+            if (elapse >= router->slow_start) {
+                return true;
+            }
+            return (h % router->slow_start) < elapse;
+        default:
+            return true;
+    }
+}
+
+/******************************************************************************
+ **函数名称: frwd_router_select
+ **功    能: 为搜索请求选择各分区的目标结点
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **输出参数:
+ **     idx: 目标结点下标列表(空间不小于FRWD_PART_MAX)
+ **     part: 各目标结点对应的分区下标(空间不小于FRWD_PART_MAX)
+ **返    回: 目标结点个数
+ **实现描述:
+ **     1. 记录已选中结点所持有的全部分区, 已覆盖的分区无需重复发送
+ **     2. 剔除故障结点及未被慢启动放行的结点
+ **     3. 优先选择不持有已覆盖分区的副本, 否则该结点返回的文档会与已选结点重复
+ **     4. 以serial和分区为种子从候选副本中随机取两个, 选择负载较低者
+ **注意事项:
+ **     1. 以serial为随机种子, 无需共享随机数状态
+ **     2. 分区的副本全部故障时跳过该分区, 不再等待其超时
+ **     3. 可用副本均持有已覆盖分区时仍从中选择, 宁可结果重复也不丢失该分区
+ **作    者:
+ ******************************************************************************/
+int frwd_router_select(frwd_router_t *router, uint64_t serial, int *idx, int *part_idx)
+{
+    frwd_node_t *node;
+    frwd_part_t *part;
+    uint64_t h, now, covered = 0;
+    int cand[FRWD_REPLICA_MAX], over[FRWD_REPLICA_MAX];
+    int i, j, a, b, cnum, onum, num = 0;
+
+    now = frwd_router_now();
+
+    for (i=0; i<router->part_num; ++i) {
+        part = &router->part[i];
+
+        /* > 已选中的结点持有该分区 */
+        if (covered & (1ULL << i)) {
+            continue;
+        }
+
+        /* > 筛选可用副本(不持有已覆盖分区的优先) */
+        h = frwd_pend_hash(serial, part->id);
+
+        cnum = 0;
+        onum = 0;
+        for (j=0; j<part->num; ++j) {
+            node = &router->node[part->node[j]];
+            if (!frwd_node_is_avail(router, node, h >> (j + 1), now)) {
+                continue;
+            }
+
+            if (node->part_mask & covered) {
+                over[onum++] = part->node[j];
+                continue;
+            }
+            cand[cnum++] = part->node[j];
+        }
+
+        if (0 == cnum) {
+            if (0 == onum) {
+                continue; /* 副本全部不可用 */
+            }
+            memcpy(cand, over, onum * sizeof(int));
+            cnum = onum;
+        }
+
+        /* > 随机二选一 */
+        part_idx[num] = i;
+        if (1 == cnum) {
+            idx[num] = cand[0];
+        } else {
+            a = h % cnum;
+            b = (a + 1 + (h >> 32) % (cnum - 1)) % cnum;
+
+            idx[num] = (frwd_node_load(&router->node[cand[a]])
+                    <= frwd_node_load(&router->node[cand[b]]))? cand[a] : cand[b];
+        }
+
+        covered |= router->node[idx[num++]].part_mask;
+    }
+
+    return num;
+}
+
+/* URL哈希(FNV-1a, 最多取len字节) */
+static inline uint32_t frwd_url_hash(const char *url, size_t len)
+{
+    uint32_t h = 2166136261U;
+
+    while (len-- > 0 && '\0' != *url) {
+        h ^= (uint8_t)*url++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/******************************************************************************
+ **函数名称: frwd_router_owner
+ **功    能: 选择文档所属分区的副本结点(写请求)
+ **输入参数:
+ **     router: 路由对象
+ **     url: 文档URL(可不含结束符)
+ **     len: URL最大长度
+ **输出参数:
+ **     idx: 目标结点下标列表(空间不小于FRWD_REPLICA_MAX)
+ **     part: 所属分区下标
+ **返    回: 目标结点个数
+ **实现描述:
+ **     1. 以URL哈希对分区数取模确定所属分区, 同一文档的写请求总是落在同一分区
+ **     2. 写请求需发给该分区的所有副本, 只剔除故障结点
+ **注意事项:
+ **     1. 故障结点会缺失期间的写入, 恢复后需重新导入该分区的文档
+ **     2. 分区数变化时文档的归属随之改变, 调整分区后需重建索引
+ **作    者:
+ ******************************************************************************/
+int frwd_router_owner(frwd_router_t *router, const char *url, size_t len, int *idx, int *part)
+{
+    int i, num = 0;
+    frwd_part_t *p;
+
+    *part = frwd_url_hash(url, len) % router->part_num;
+
+    p = &router->part[*part];
+    for (i=0; i<p->num; ++i) {
+        if (FRWD_NODE_IS_DOWN(&router->node[p->node[i]])) {
+            continue;
+        }
+        idx[num++] = p->node[i];
+    }
+
+    return num;
+}
+
+/******************************************************************************
+ **函数名称: frwd_node_update_ewma
+ **功    能: 更新结点时延
+ **输入参数:
+ **     node: 结点
+ **     sample: 时延样本(微秒)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 按样本所在的2的幂次区间累加直方图
+ **     2. ewma += (sample - ewma) / 2^FRWD_EWMA_SHIFT
+ **注意事项: 并发更新EWMA时可能丢失个别样本, 对负载估计无实质影响, 因此不加锁
+ **作    者:
+ ******************************************************************************/
+static void frwd_node_update_ewma(frwd_node_t *node, uint64_t sample)
+{
+    int bkt = 0;
+    int64_t ewma = node->ewma;
+
+    /* > 更新直方图 */
+    while ((bkt < FRWD_HIST_NUM - 1) && (sample >> (bkt + 1))) {
+        ++bkt;
+    }
+    atomic32_inc((uint32_t *)&node->hist[bkt]);
+
+    /* > 更新EWMA */
+    if (0 == ewma) {
+        node->ewma = (uint32_t)sample;
+        return;
+    }
+
+    ewma += ((int64_t)sample - ewma) >> FRWD_EWMA_SHIFT;
+
+    node->ewma = (uint32_t)((ewma > 0)? ewma : 1);
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_expire
+ **功    能: 回收超时的在途请求
+ **输入参数:
+ **     router: 路由对象
+ **     pend: 在途请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 以超时时间作为时延样本, 使无应答的结点负载升高
+ **注意事项: 调用者负责覆盖或清除该槽位
+ **作    者:
+ ******************************************************************************/
+static void frwd_pend_expire(frwd_router_t *router, frwd_pend_t *pend)
+{
+    frwd_node_t *node;
+
+    if (pend->idx >= FRWD_NODE_MAX) {
+        return; /* 胜出记录 */
+    }
+
+    node = &router->node[pend->idx];
+    if (!pend->is_answered) {
+        frwd_node_update_ewma(node, router->timeout);
+    }
+
+    if (node->inflight > 0) {
+        atomic32_dec((uint32_t *)&node->inflight);
+    }
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_alloc
+ **功    能: 为新键分配槽位
+ **输入参数:
+ **     router: 路由对象
+ **     stripe: 在途表分段
+ **     pos: 起始槽位
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: 槽位(NULL:表已满)
+ **实现描述: 从起始槽位线性探测, 遇到空闲槽位或已超时的槽位时返回
+ **注意事项:
+ **     1. 调用者已加锁
+ **     2. 超时槽位位于新键的探测路径上, 直接覆盖不会破坏其他键的探测链
+ **作    者:
+ ******************************************************************************/
+static frwd_pend_t *frwd_pend_alloc(frwd_router_t *router,
+        frwd_pend_stripe_t *stripe, uint32_t pos, uint64_t now)
+{
+    int n;
+    frwd_pend_t *pend;
+
+    for (n=0; n<FRWD_PEND_STRIPE_SIZE; ++n, pos=FRWD_PEND_NEXT(pos)) {
+        pend = &stripe->slot[pos];
+        if (pend->idx < 0) {
+            ++stripe->num;
+            return pend;
+        } else if (pend->stm + router->timeout <= now) {
+            frwd_pend_expire(router, pend);
+            return pend;
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_find
+ **功    能: 查找在途请求
+ **输入参数:
+ **     stripe: 在途表分段
+ **     pos: 起始槽位
+ **     serial: 请求流水号
+ **     idx: 结点下标
+ **输出参数:
+ **     slot: 所在槽位
+ **返    回: 在途请求(NULL:不存在)
+ **实现描述: 从起始槽位线性探测, 直到找到或遇到空闲槽位
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static frwd_pend_t *frwd_pend_find(frwd_pend_stripe_t *stripe,
+        uint32_t pos, uint64_t serial, int idx, uint32_t *slot)
+{
+    int n;
+    frwd_pend_t *pend;
+
+    for (n=0; n<FRWD_PEND_STRIPE_SIZE; ++n, pos=FRWD_PEND_NEXT(pos)) {
+        pend = &stripe->slot[pos];
+        if (pend->idx < 0) {
+            return NULL;
+        } else if (pend->serial == serial && pend->idx == idx) {
+            if (NULL != slot) { *slot = pos; }
+            return pend;
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_add
+ **功    能: 添加在途请求
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     idx: 目标结点下标
+ **     part: 分区下标
+ **     fanout: 扇出数(该请求发往的结点数)
+ **     is_hedged: 是否为对冲请求
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 表满时返回失败, 调用者应拒绝该请求(否则应答无法携带扇出数)
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_add(frwd_router_t *router, uint64_t serial,
+        int idx, int part, int fanout, bool is_hedged, uint64_t now)
+{
+    frwd_pend_t *pend;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, idx);
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = frwd_pend_alloc(router, stripe, FRWD_PEND_HOME(h), now);
+    if (NULL == pend) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1; /* 表已满 */
+    }
+
+    pend->serial = serial;
+    pend->idx = idx;
+    pend->part = part;
+    pend->fanout = fanout;
+    pend->is_answered = false;
+    pend->is_hedged = is_hedged;
+    pend->winner = -1;
+    pend->stm = now;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    atomic32_inc((uint32_t *)&router->node[idx].inflight);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_erase
+ **功    能: 删除在途请求
+ **输入参数:
+ **     stripe: 在途表分段
+ **     pos: 待删除的槽位
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 后移删除(backward shift): 将后续探测链上可前移的键依次前移, 无需墓碑
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static void frwd_pend_erase(frwd_pend_stripe_t *stripe, uint32_t pos)
+{
+    uint32_t next, home;
+    frwd_pend_t *slot = stripe->slot;
+
+    next = pos;
+    while (1) {
+        slot[pos].idx = -1;
+
+        do {
+            next = FRWD_PEND_NEXT(next);
+            if (slot[next].idx < 0) {
+                --stripe->num;
+                return;
+            }
+            home = FRWD_PEND_HOME(frwd_pend_hash(slot[next].serial, slot[next].idx));
+        } while ((pos <= next)? (pos < home && home <= next) : (pos < home || home <= next));
+
+        slot[pos] = slot[next];
+        pos = next;
+    }
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_done
+ **功    能: 收到应答时更新在途请求
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     idx: 应答结点下标
+ **     is_last: 是否为末帧应答
+ **     now: 当前时间(微秒)
+ **输出参数:
+ **     out: 在途请求的副本(可为NULL)
+ **返    回: 0:成功 !0:不存在(已超时或非本结点发出)
+ **实现描述:
+ **     1. 首帧应答: 以发送至今的时长更新结点时延
+ **     2. 末帧应答: 删除在途请求, 并减少结点在途数
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_done(frwd_router_t *router, uint64_t serial,
+        int idx, bool is_last, uint64_t now, frwd_pend_t *out)
+{
+    uint32_t pos;
+    frwd_pend_t *pend;
+    frwd_node_t *node;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, idx);
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+    node = &router->node[idx];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, idx, &pos);
+    if (NULL == pend) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1; /* 不存在 */
+    }
+
+    if (!pend->is_answered) {
+        pend->is_answered = true;
+        frwd_node_update_ewma(node, now - pend->stm);
+    }
+
+    if (NULL != out) {
+        memcpy(out, pend, sizeof(frwd_pend_t));
+    }
+
+    if (is_last) {
+        frwd_pend_erase(stripe, pos);
+        if (node->inflight > 0) {
+            atomic32_dec((uint32_t *)&node->inflight);
+        }
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_del
+ **功    能: 删除未能发出的在途请求
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     idx: 结点下标
+ **输出参数: NONE
+ **返    回: 0:成功 !0:不存在
+ **实现描述: 删除在途请求, 并减少结点在途数
+ **注意事项: 请求并未发出, 因此不更新结点时延
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_del(frwd_router_t *router, uint64_t serial, int idx)
+{
+    uint32_t pos;
+    frwd_node_t *node;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, idx);
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+    node = &router->node[idx];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    if (NULL == frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, idx, &pos)) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1; /* 不存在 */
+    }
+
+    frwd_pend_erase(stripe, pos);
+    if (node->inflight > 0) {
+        atomic32_dec((uint32_t *)&node->inflight);
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_fanout
+ **功    能: 修正在途请求的扇出数
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     idx: 结点下标
+ **     fanout: 扇出数(实际发出的结点数)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:不存在(已收到末帧应答)
+ **实现描述:
+ **注意事项: 部分结点发送失败时调用, 此后的应答携带修正后的扇出数;
+ **          帧听层以末帧所携带的扇出数判断是否收齐, 因此无需修正已转发的应答
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_fanout(frwd_router_t *router, uint64_t serial, int idx, int fanout)
+{
+    frwd_pend_t *pend;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, idx);
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, idx, NULL);
+    if (NULL == pend) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1; /* 不存在 */
+    }
+
+    pend->fanout = fanout;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_hedge
+ **功    能: 标记在途请求已对冲
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     idx: 原请求的结点下标
+ **输出参数: NONE
+ **返    回: 0:可以对冲 !0:无需对冲(已收到应答或已超时)
+ **实现描述: 与frwd_pend_done()在同一把锁下判断是否已应答, 保证两者不会错过彼此
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_hedge(frwd_router_t *router, uint64_t serial, int idx)
+{
+    frwd_pend_t *pend;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, idx);
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, idx, NULL);
+    if (NULL == pend || pend->is_answered) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1;
+    }
+
+    pend->is_hedged = true;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_claim
+ **功    能: 对冲请求的应答争夺胜出权
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **     part: 分区下标
+ **     idx: 应答结点下标
+ **     now: 当前时间(微秒)
+ **输出参数: NONE
+ **返    回: true:胜出(应转发) false:落败(应丢弃)
+ **实现描述: 首个到达的应答写入胜出记录, 此后只有该结点的应答会被转发
+ **注意事项: 胜出记录随在途超时自然回收, 以便识别迟到的落败应答
+ **作    者:
+ ******************************************************************************/
+bool frwd_pend_claim(frwd_router_t *router, uint64_t serial, int part, int idx, uint64_t now)
+{
+    bool is_winner;
+    frwd_pend_t *pend;
+    frwd_pend_stripe_t *stripe;
+    uint64_t h = frwd_pend_hash(serial, FRWD_CLAIM_IDX(part));
+
+    stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, FRWD_CLAIM_IDX(part), NULL);
+    if (NULL != pend) {
+        is_winner = (pend->winner == idx);
+        pthread_mutex_unlock(&stripe->lock);
+        return is_winner;
+    }
+
+    pend = frwd_pend_alloc(router, stripe, FRWD_PEND_HOME(h), now);
+    if (NULL != pend) {
+        pend->serial = serial;
+        pend->idx = FRWD_CLAIM_IDX(part);
+        pend->part = part;
+        pend->is_answered = true;
+        pend->is_hedged = true;
+        pend->winner = idx;
+        pend->stm = now;
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return true;
+}
+
+/******************************************************************************
+ **函数名称: frwd_pend_cancel
+ **功    能: 取消在途请求
+ **输入参数:
+ **     router: 路由对象
+ **     serial: 请求流水号
+ **输出参数: NONE
+ **返    回: 被取消的在途请求数
+ **实现描述: 删除该流水号在各结点上的在途请求, 并减少结点在途数;
+ **          尚未触发的对冲请求因找不到原请求而不再发出
+ **注意事项: 被取消请求的迟到应答因找不到在途请求, 不再参与时延统计
+ **作    者:
+ ******************************************************************************/
+int frwd_pend_cancel(frwd_router_t *router, uint64_t serial)
+{
+    int idx, num = 0;
+    uint32_t pos;
+    uint64_t h;
+    frwd_node_t *node;
+    frwd_pend_stripe_t *stripe;
+
+    for (idx=0; idx<router->node_num; ++idx) {
+        h = frwd_pend_hash(serial, idx);
+        stripe = &router->pend[FRWD_PEND_STRIPE(h)];
+        node = &router->node[idx];
+
+        pthread_mutex_lock(&stripe->lock);
+        if (NULL != frwd_pend_find(stripe, FRWD_PEND_HOME(h), serial, idx, &pos)) {
+            frwd_pend_erase(stripe, pos);
+            if (node->inflight > 0) {
+                atomic32_dec((uint32_t *)&node->inflight);
+            }
+            ++num;
+        }
+        pthread_mutex_unlock(&stripe->lock);
+    }
+
+    return num;
+}
+
+/******************************************************************************
+ **函数名称: frwd_node_percentile
+ **功    能: 计算结点首帧时延的百分位值
+ **输入参数:
+ **     node: 结点
+ **     percentile: 百分位(1~99)
+ **输出参数: NONE
+ **返    回: 时延(微秒, 0:尚无样本)
+ **实现描述: 累加直方图直到覆盖指定比例的样本, 返回所在桶的上界
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+uint32_t frwd_node_percentile(const frwd_node_t *node, int percentile)
+{
+    int bkt;
+    uint64_t total = 0, sum = 0, target;
+
+    for (bkt=0; bkt<FRWD_HIST_NUM; ++bkt) {
+        total += node->hist[bkt];
+    }
+
+    if (0 == total) {
+        return 0;
+    }
+
+    target = (total * percentile + 99) / 100;
+    for (bkt=0; bkt<FRWD_HIST_NUM - 1; ++bkt) {
+        sum += node->hist[bkt];
+        if (sum >= target) {
+            break;
+        }
+    }
+
+    return (uint32_t)((1ULL << (bkt + 1)) - 1);
+}
+
+/******************************************************************************
+ **函数名称: frwd_router_decay
+ **功    能: 衰减各结点的时延直方图
+ **输入参数:
+ **     router: 路由对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 各桶计数减半, 使百分位能跟随结点近期的时延变化
+ **注意事项: 由后台线程周期性调用
+ **作    者:
+ ******************************************************************************/
+void frwd_router_decay(frwd_router_t *router)
+{
+    int idx, bkt;
+    frwd_node_t *node;
+
+    for (idx=0; idx<router->node_num; ++idx) {
+        node = &router->node[idx];
+        for (bkt=0; bkt<FRWD_HIST_NUM; ++bkt) {
+            node->hist[bkt] >>= 1;
+        }
+    }
+}
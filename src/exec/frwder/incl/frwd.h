@@ -5,6 +5,10 @@
 #include "vector.h"
 #include "shm_queue.h"
 #include "frwd_conf.h"
+#include "frwd_route.h"
+#include "frwd_hedge.h"
+#include "frwd_health.h"
+#include "frwd_batch.h"
 #include "rtmq_proxy.h"
 #include "rtmq_proxy_ssvr.h"
 
@@ -34,6 +38,10 @@ typedef struct
     log_cycle_t *log;                       /* 日志对象 */
     rtmq_cntx_t *backend;                   /* Backend对象 */
     rtmq_cntx_t *forward;                   /* Forward对象(用于接收来自下游的数据) */
+    frwd_router_t *router;                  /* 路由对象 */
+    frwd_hedge_t *hedge;                    /* 对冲对象(未开启对冲时为NULL) */
+    frwd_health_t *health;                  /* 健康检查对象(未开启健康检查时为NULL) */
+    frwd_batch_t *batch;                    /* 批量发送对象(未开启批量发送时为NULL) */
 } frwd_cntx_t;
 
 int frwd_getopt(int argc, char **argv, frwd_opt_t *opt);
@@ -43,4 +51,14 @@ frwd_cntx_t *frwd_init(const frwd_conf_t *conf, log_cycle_t *log);
 int frwd_launch(frwd_cntx_t *frwd);
 int frwd_set_reg(frwd_cntx_t *frwd);
 
+int frwd_hedge_launch(frwd_cntx_t *ctx);
+int frwd_hedge_add(frwd_cntx_t *ctx, uint64_t serial, int part,
+        int idx, int fanout, int type, const void *data, size_t len, uint64_t now);
+
+int frwd_health_launch(frwd_cntx_t *ctx);
+int frwd_health_pong(frwd_cntx_t *ctx, int orig, uint64_t serial);
+
+int frwd_batch_launch(frwd_cntx_t *ctx);
+int frwd_batch_send(frwd_cntx_t *ctx, int type, int nid, void *data, size_t len);
+
 #endif /*__FRWD_H__*/
@@ -0,0 +1,45 @@
+#if !defined(__FRWD_BATCH_H__)
+#define __FRWD_BATCH_H__
+
+#include "comm.h"
+#include "frwd_conf.h"
+
+#define FRWD_BATCH_SLOT_MAX     (64)        /* 最大下游结点数 */
+#define FRWD_BATCH_HOLD_NUM     (8)         /* 攒批目标条数(攒批时间按消息间隔自适应) */
+#define FRWD_BATCH_EWMA_SHIFT   (3)         /* 消息间隔EWMA平滑系数(1/8) */
+#define FRWD_BATCH_TICK_MIN     (50)        /* 刷新线程的最小检查间隔(微秒) */
+
+/* 下游结点的发送缓存 */
+typedef struct
+{
+    int nid;                                /* 下游结点ID(0:空闲) */
+    pthread_mutex_t lock;                   /* 互斥锁(保证同一结点的消息有序) */
+
+    uint64_t atm;                           /* 最近一条消息的到达时间(微秒) */
+    uint64_t gap;                           /* 消息到达间隔的EWMA(微秒) */
+    uint64_t stm;                           /* 缓存中首条消息的到达时间(微秒) */
+    uint64_t hold;                          /* 当前攒批时间(微秒) */
+
+    int num;                                /* 缓存的消息数 */
+    size_t len;                             /* 缓存的字节数(含批量报头) */
+    char *buf;                              /* 缓存(批量报头 + 消息1 + 消息2 + ...) */
+} frwd_batch_slot_t;
+
+/* 批量发送对象
+ *  注: 同一下游结点的消息合并为一个MSG_BATCH_MESG发送, 以减少逐条发送的分帧及系统调用开销.
+ *      负载较低时(消息间隔大于攒批时间)直接发送, 不增加时延 */
+typedef struct
+{
+    size_t size;                            /* 单批最大字节数 */
+    uint64_t delay;                         /* 最长攒批时间(微秒) */
+
+    pthread_t tid;                          /* 刷新线程 */
+    pthread_mutex_t lock;                   /* 结点分配锁 */
+
+    int num;                                /* 已分配的结点数 */
+    frwd_batch_slot_t slot[FRWD_BATCH_SLOT_MAX]; /* 各下游结点的发送缓存 */
+} frwd_batch_t;
+
+frwd_batch_t *frwd_batch_creat(int size, int delay);
+
+#endif /*__FRWD_BATCH_H__*/
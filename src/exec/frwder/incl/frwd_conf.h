@@ -7,11 +7,61 @@
 #include "rtmq_recv.h"
 #include "rtmq_proxy.h"
 
+#define FRWD_PART_MAX       (64)            /* 最大分区数(不能超过64, 见frwd_node_t::part_mask) */
+#define FRWD_REPLICA_MAX    (8)             /* 单个分区的最大副本数 */
+#define FRWD_NODE_MAX       (128)           /* 最大后端结点数 */
+#define FRWD_DEF_BACKEND_NID    (30001)     /* 未配置路由时的默认倒排结点ID */
+#define FRWD_PEND_DEF_TIMEOUT   (3000)      /* 在途请求默认超时时间(毫秒) */
+#define FRWD_HEDGE_DEF_MAX      (65536)     /* 待对冲请求的默认最大个数 */
+#define FRWD_HEALTH_DEF_INTERVAL    (1000)  /* 默认探测间隔(毫秒) */
+#define FRWD_HEALTH_DEF_TIMEOUT     (500)   /* 默认探测超时时间(毫秒) */
+#define FRWD_HEALTH_DEF_FAILS       (3)     /* 默认连续超时次数(达到后判定结点故障) */
+#define FRWD_HEALTH_DEF_SLOW_START  (10000) /* 默认慢启动时长(毫秒) */
+#define FRWD_BATCH_DEF_SIZE     (4096)      /* 批量发送的默认最大字节数 */
+#define FRWD_BATCH_DEF_DELAY    (200)       /* 批量发送的默认最长攒批时间(微秒) */
+
+/* 路由配置 */
+typedef struct
+{
+    int timeout;                            /* 在途请求超时时间(毫秒) */
+
+    struct {
+        bool enable;                        /* 是否开启对冲请求 */
+        int percentile;                     /* 对冲时机(首帧时延的百分位, 如: 95) */
+        int budget;                         /* 对冲预算(额外负载的百分比, 如: 5) */
+        int min_delay;                      /* 最小对冲延迟(毫秒) */
+        int max;                            /* 待对冲请求的最大个数 */
+    } hedge;                                /* 对冲配置 */
+
+    struct {
+        bool enable;                        /* 是否开启健康检查 */
+        int interval;                       /* 探测间隔(毫秒) */
+        int timeout;                        /* 探测超时时间(毫秒) */
+        int fails;                          /* 连续超时次数(达到后判定结点故障) */
+        int slow_start;                     /* 慢启动时长(毫秒, 结点恢复后流量逐步增至正常) */
+    } health;                               /* 健康检查配置 */
+
+    int part_num;                           /* 分区数(未配置路由时为1) */
+    struct {
+        int id;                             /* 分区ID */
+        int num;                            /* 副本数 */
+        int nid[FRWD_REPLICA_MAX];          /* 副本所在结点ID */
+    } part[FRWD_PART_MAX];
+} frwd_router_conf_t;
+
 /* 配置信息 */
 typedef struct
 {
     int nid;                                /* 结点名ID */
     char name[NODE_MAX_LEN];                /* 结点名 */
+    frwd_router_conf_t router;              /* 路由配置 */
+
+    struct {
+        bool enable;                        /* 是否开启批量发送 */
+        int size;                           /* 单批最大字节数(达到后立即发送) */
+        int delay;                          /* 最长攒批时间(微秒) */
+    } batch;                                /* 批量发送配置(下行应答) */
+
     rtmq_conf_t backend;                    /* Backend配置 */
     rtmq_conf_t forward;                    /* Forward配置 */
 } frwd_conf_t;
@@ -0,0 +1,31 @@
+#if !defined(__FRWD_HEALTH_H__)
+#define __FRWD_HEALTH_H__
+
+#include "comm.h"
+#include "frwd_conf.h"
+
+/* 结点探测信息 */
+typedef struct
+{
+    uint64_t serial;                        /* 最近一次探测的流水号 */
+    uint64_t stm;                           /* 最近一次探测的发送时间(微秒, 0:无在途探测) */
+    uint64_t ptm;                           /* 最近一次探测的发起时间(微秒) */
+    int fails;                              /* 连续超时次数 */
+} frwd_probe_t;
+
+/* 健康检查对象 */
+typedef struct
+{
+    uint64_t interval;                      /* 探测间隔(微秒) */
+    uint64_t timeout;                       /* 探测超时时间(微秒) */
+    int fails;                              /* 连续超时次数(达到后判定结点故障) */
+
+    pthread_t tid;                          /* 探测线程 */
+    pthread_mutex_t lock;                   /* 互斥锁(保护探测信息及结点状态的变更) */
+    uint32_t seq;                           /* 探测序列号 */
+    frwd_probe_t probe[FRWD_NODE_MAX];      /* 各结点探测信息(与frwd_router_t::node下标一致) */
+} frwd_health_t;
+
+frwd_health_t *frwd_health_creat(const frwd_router_conf_t *conf);
+
+#endif /*__FRWD_HEALTH_H__*/
@@ -0,0 +1,46 @@
+#if !defined(__FRWD_HEDGE_H__)
+#define __FRWD_HEDGE_H__
+
+#include "comm.h"
+#include "frwd_conf.h"
+
+#define FRWD_HEDGE_TOKEN        (1000)      /* 单个对冲请求消耗的令牌数 */
+#define FRWD_HEDGE_TOKEN_MAX    (100 * FRWD_HEDGE_TOKEN) /* 令牌上限(允许的突发对冲数) */
+#define FRWD_HEDGE_DECAY_SEC    (10)        /* 时延直方图衰减周期(秒) */
+
+/* 归还预扣的令牌(未发出对冲请求时) */
+#define FRWD_HEDGE_REFUND(hedge) __sync_fetch_and_add(&(hedge)->tokens, FRWD_HEDGE_TOKEN)
+
+/* 待对冲请求 */
+typedef struct
+{
+    uint64_t deadline;                      /* 对冲时间(微秒) */
+    uint64_t serial;                        /* 请求流水号 */
+    int part;                               /* 分区下标 */
+    int idx;                                /* 原请求的结点下标 */
+    int fanout;                             /* 原请求的扇出数 */
+    int type;                               /* 消息类型 */
+    size_t len;                             /* 数据长度 */
+    void *data;                             /* 请求数据(拷贝) */
+} frwd_hedge_item_t;
+
+/* 对冲对象 */
+typedef struct
+{
+    int percentile;                         /* 对冲时机(百分位) */
+    int budget;                             /* 对冲预算(百分比) */
+    uint64_t min_delay;                     /* 最小对冲延迟(微秒) */
+
+    pthread_t tid;                          /* 对冲线程 */
+    pthread_mutex_t lock;                   /* 互斥锁(保护待对冲请求堆) */
+    pthread_cond_t cond;                    /* 条件变量 */
+
+    volatile int64_t tokens;                /* 令牌数(每发出一个原请求增加budget*10, 以CAS更新) */
+    int num;                                /* 待对冲请求数 */
+    int max;                                /* 待对冲请求的最大个数 */
+    frwd_hedge_item_t *heap;                /* 待对冲请求(以对冲时间为键的小根堆) */
+} frwd_hedge_t;
+
+frwd_hedge_t *frwd_hedge_creat(const frwd_router_conf_t *conf);
+
+#endif /*__FRWD_HEDGE_H__*/
@@ -0,0 +1,100 @@
+#if !defined(__FRWD_ROUTE_H__)
+#define __FRWD_ROUTE_H__
+
+#include "comm.h"
+#include "frwd_conf.h"
+
+#define FRWD_PEND_STRIPE_NUM    (32)        /* 在途表分段数(每段一把锁) */
+#define FRWD_PEND_STRIPE_SIZE   (4096)      /* 每段槽位数(必须为2的次方) */
+#define FRWD_EWMA_SHIFT         (3)         /* EWMA平滑系数(1/8) */
+#define FRWD_HIST_NUM           (32)        /* 时延直方图桶数(第i桶: [2^i, 2^(i+1))微秒) */
+#define FRWD_CLAIM_IDX(part)    (FRWD_NODE_MAX + (part)) /* 胜出记录的伪结点下标 */
+
+/* 结点状态 */
+typedef enum
+{
+    FRWD_NODE_UP                            /* 正常 */
+    , FRWD_NODE_DOWN                        /* 故障(不参与路由) */
+    , FRWD_NODE_SLOW_START                  /* 慢启动(按恢复时长逐步放开流量) */
+} frwd_node_state_e;
+
+/* 后端结点 */
+typedef struct
+{
+    int nid;                                /* 结点ID */
+    uint64_t part_mask;                     /* 持有的分区(第i位对应分区下标i) */
+    volatile int state;                     /* 结点状态(取值: frwd_node_state_e) */
+    volatile uint64_t up_tm;                /* 恢复时间(微秒, 慢启动的起点) */
+    volatile uint32_t inflight;             /* 在途请求数 */
+    volatile uint32_t ewma;                 /* 首帧应答时延的EWMA(微秒) */
+    volatile uint32_t hist[FRWD_HIST_NUM];  /* 首帧应答时延直方图(用于计算百分位) */
+} frwd_node_t;
+
+/* 分区 */
+typedef struct
+{
+    int id;                                 /* 分区ID */
+    int num;                                /* 副本数 */
+    int node[FRWD_REPLICA_MAX];             /* 副本结点(frwd_router_t::node的下标) */
+} frwd_part_t;
+
+/* 在途请求
+ *  注: 对冲请求的胜出记录也存放于此, 其结点下标为FRWD_CLAIM_IDX(分区下标) */
+typedef struct
+{
+    uint64_t serial;                        /* 请求流水号 */
+    int idx;                                /* 结点下标(-1:空闲) */
+    int part;                               /* 分区下标 */
+    int fanout;                             /* 扇出数(该请求发往的结点数) */
+    bool is_answered;                       /* 是否已收到首帧应答 */
+    bool is_hedged;                         /* 是否已发出对冲请求 */
+    int winner;                             /* 胜出结点下标(仅用于胜出记录) */
+    uint64_t stm;                           /* 发送时间(微秒) */
+} frwd_pend_t;
+
+/* 在途表分段(线性探测开放寻址) */
+typedef struct
+{
+    pthread_mutex_t lock;                   /* 分段锁 */
+    int num;                                /* 在途请求数 */
+    frwd_pend_t slot[FRWD_PEND_STRIPE_SIZE];/* 槽位 */
+} frwd_pend_stripe_t;
+
+/* 路由对象 */
+typedef struct
+{
+    uint64_t timeout;                       /* 在途请求超时时间(微秒) */
+    uint64_t slow_start;                    /* 慢启动时长(微秒) */
+
+    int node_num;                           /* 结点数 */
+    frwd_node_t node[FRWD_NODE_MAX];        /* 结点列表 */
+
+    int part_num;                           /* 分区数 */
+    frwd_part_t part[FRWD_PART_MAX];        /* 分区列表 */
+
+    frwd_pend_stripe_t *pend;               /* 在途表(以serial+结点为键) */
+} frwd_router_t;
+
+#define FRWD_NODE_IS_DOWN(node) (FRWD_NODE_DOWN == (node)->state)
+
+frwd_router_t *frwd_router_creat(const frwd_router_conf_t *conf);
+int frwd_router_select(frwd_router_t *router, uint64_t serial, int *idx, int *part);
+int frwd_router_owner(frwd_router_t *router, const char *url, size_t len, int *idx, int *part);
+int frwd_router_node_idx(frwd_router_t *router, int nid);
+uint64_t frwd_node_load(const frwd_node_t *node);
+uint32_t frwd_node_percentile(const frwd_node_t *node, int percentile);
+void frwd_router_decay(frwd_router_t *router);
+
+int frwd_pend_add(frwd_router_t *router, uint64_t serial,
+        int idx, int part, int fanout, bool is_hedged, uint64_t now);
+int frwd_pend_done(frwd_router_t *router, uint64_t serial,
+        int idx, bool is_last, uint64_t now, frwd_pend_t *out);
+int frwd_pend_del(frwd_router_t *router, uint64_t serial, int idx);
+int frwd_pend_fanout(frwd_router_t *router, uint64_t serial, int idx, int fanout);
+int frwd_pend_hedge(frwd_router_t *router, uint64_t serial, int idx);
+bool frwd_pend_claim(frwd_router_t *router, uint64_t serial, int part, int idx, uint64_t now);
+int frwd_pend_cancel(frwd_router_t *router, uint64_t serial);
+
+uint64_t frwd_router_now(void);
+
+#endif /*__FRWD_ROUTE_H__*/
@@ -2,9 +2,13 @@
 #define __INVERTD_H__
 
 #include "log.h"
-#include "invtab.h"
 #include "rtmq_recv.h"
 #include "invtd_conf.h"
+#include "invtd_trie.h"
+#include "invtd_index.h"
+#include "invtd_token.h"
+#include "invtd_cancel.h"
+#include "invtd_insert.h"
 
 /* 全局信息 */
 typedef struct
@@ -12,8 +16,12 @@ typedef struct
     log_cycle_t *log;                       /* 日志对象 */
     invtd_conf_t conf;                      /* 配置信息 */
 
-    invt_tab_t *invtab;                     /* 倒排表 */
-    pthread_rwlock_t invtab_lock;           /* 倒排表锁 */
+    pthread_rwlock_t invtab_lock;           /* 倒排表锁(保护评分索引及前缀树) */
+    invtd_index_t *index;                   /* 评分索引 */
+    invtd_token_t *token;                   /* 分词器(只读, 插入与查询共用) */
+    invtd_trie_t *trie;                     /* 前缀树(插入线程定期重建后替换) */
+    invtd_insert_queue_t *insertq;          /* 插入队列(低优先级) */
+    invtd_cancel_tab_t *cancel;             /* 已取消请求表 */
 
     rtmq_proxy_t *frwder;                   /* 下行服务 */
 } invtd_cntx_t;
@@ -28,5 +36,9 @@ typedef struct
 
 invtd_cntx_t *invtd_init(const invtd_conf_t *conf, log_cycle_t *log);
 int invtd_launch(invtd_cntx_t *ctx);
+int invtd_insert_launch(invtd_cntx_t *ctx);
+int invtd_insert_push(invtd_cntx_t *ctx, const invtd_insert_item_t *item);
+int invtd_doc_rsp(invtd_cntx_t *ctx, const invtd_insert_item_t *item, int code);
+int invtd_score_rsp(invtd_cntx_t *ctx, const invtd_insert_item_t *item, int code);
 
 #endif /*__INVERTD_H__*/
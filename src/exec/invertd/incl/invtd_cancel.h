@@ -0,0 +1,28 @@
+#if !defined(__INVTD_CANCEL_H__)
+#define __INVTD_CANCEL_H__
+
+#include "comm.h"
+
+#define INVTD_CANCEL_SLOT_NUM   (65536)     /* 已取消请求槽位数(必须为2的次方) */
+
+/* 已取消请求 */
+typedef struct
+{
+    uint64_t serial;                        /* 流水号(0:空闲) */
+    time_t ctm;                             /* 取消时间(秒) */
+} invtd_cancel_item_t;
+
+/* 已取消请求表
+ *  注: 以serial为键直接映射, 冲突时覆盖; 被覆盖的请求只是不能提前结束 */
+typedef struct
+{
+    int ttl;                                /* 有效时长(秒) */
+    pthread_mutex_t lock;                   /* 互斥锁 */
+    invtd_cancel_item_t slot[INVTD_CANCEL_SLOT_NUM]; /* 槽位 */
+} invtd_cancel_tab_t;
+
+invtd_cancel_tab_t *invtd_cancel_tab_creat(int ttl);
+void invtd_cancel_add(invtd_cancel_tab_t *tab, uint64_t serial);
+bool invtd_cancel_is_cancelled(invtd_cancel_tab_t *tab, uint64_t serial);
+
+#endif /*__INVTD_CANCEL_H__*/
@@ -4,13 +4,62 @@
 #include "log.h"
 #include "rtmq_proxy.h"
 
+#define INVTD_INSERT_DEF_QUEUE  (65536)     /* 插入队列默认容量 */
+#define INVTD_INSERT_DEF_BATCH  (64)        /* 单次加写锁默认最多插入的个数 */
+#define INVTD_SEARCH_DEF_TOPK   (1000)      /* 搜索结果数上限默认值 */
+#define INVTD_FUZZY_DEF_MAX     (2)         /* 模糊匹配最大编辑距离默认值 */
+#define INVTD_FUZZY_DEF_EXPAND  (4)         /* 每个关键字最多扩展的词项数默认值 */
+
+/* 错误码 */
+typedef enum
+{
+    INVT_OK                             /* 正常 */
+    , INVT_SHOW_HELP                    /* 显示帮助 */
+
+    , INVT_ERR = ~0x7fffffff            /* 异常 */
+    , INVT_ERR_CONF                     /* 配置异常 */
+} invt_err_code_e;
+
 /* 配置信息 */
 typedef struct
 {
     int nid;                            /* 结点ID */
     int gid;                            /* 分组ID */
     char path[FILE_LINE_MAX_LEN];       /* 工作路径 */
-    int invt_tab_max;                   /* 倒排表长度 */
+    int page_size;                      /* 搜索应答分页大小(每帧条目数, 0:不分页) */
+    int topk;                           /* 搜索结果数上限(按得分取前topk个) */
+    struct {
+        int max;                        /* 最大编辑距离(0:不允许模糊匹配) */
+        int expand;                     /* 每个关键字最多扩展的词项数 */
+    } fuzzy;                            /* 模糊匹配配置 */
+    struct {
+        double k1;                      /* 词频饱和度 */
+        double b;                       /* 文档长度归一化强度 */
+    } bm25;                             /* BM25评分配置 */
+    struct {
+        double title;                   /* 标题权重 */
+        double url;                     /* URL权重 */
+        double body;                    /* 正文权重 */
+    } boost;                            /* 字段权重配置 */
+    struct {
+        bool position;                  /* 是否记录位置信息(短语及邻近查询) */
+    } index;                            /* 索引配置 */
+    struct {
+        double weight;                  /* 静态得分权重 */
+        bool order;                     /* 热词得分序副本是否计入静态得分 */
+    } prior;                            /* 静态得分配置 */
+    struct {
+        char dict[FILE_PATH_MAX_LEN];   /* 词典路径(空:不加载词典, 中日韩文字单字成词) */
+    } token;                            /* 分词配置 */
+    struct {
+        bool enable;                    /* 是否开启压缩 */
+        int level;                      /* 压缩级别(1~9) */
+        int threshold;                  /* 压缩阈值(报体长度超过该值时才压缩) */
+    } compress;                         /* 应答压缩配置 */
+    struct {
+        int queue;                      /* 插入队列容量 */
+        int batch;                      /* 单次加写锁最多插入的个数 */
+    } insert;                           /* 插入配置 */
     rtmq_proxy_conf_t frwder;           /* FRWDER配置 */
 } invtd_conf_t;
 
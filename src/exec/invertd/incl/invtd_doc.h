@@ -0,0 +1,36 @@
+#if !defined(__INVTD_DOC_H__)
+#define __INVTD_DOC_H__
+
+#include "cmd.h"
+#include "comm.h"
+#include "invtd_index.h"
+#include "invtd_token.h"
+
+#define INVTD_DOC_FIELD_GAP     (64)        /* 字段间的位置间隔(避免短语跨字段匹配) */
+
+/* 文档词项 */
+typedef struct
+{
+    char *word;                             /* 关键字(规范化后) */
+    int freq;                               /* 词频 */
+    int ftf[INVTD_FIELD_TOTAL];             /* 各字段词频 */
+    uint32_t *pos;                          /* 出现位置(升序, 共freq个) */
+} invtd_doc_term_t;
+
+/* 待索引文档
+ *  注: 由工作线程分词并统计词频, 再交给插入线程一次性写入 */
+typedef struct
+{
+    char url[URL_MAX_LEN];                  /* URL */
+    int token_num;                          /* 词数 */
+    int num;                                /* 词项数 */
+    invtd_doc_term_t *term;                 /* 词项(按关键字字典序排列) */
+    uint32_t *pos;                          /* 位置缓存 */
+    char *buf;                              /* 关键字缓存 */
+} invtd_doc_terms_t;
+
+invtd_doc_terms_t *invtd_doc_parse(const invtd_token_t *tk, const char *url,
+        const char *title, size_t title_len, const char *body, size_t body_len);
+void invtd_doc_free(invtd_doc_terms_t *doc);
+
+#endif /*__INVTD_DOC_H__*/
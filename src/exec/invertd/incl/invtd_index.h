@@ -0,0 +1,161 @@
+#if !defined(__INVTD_INDEX_H__)
+#define __INVTD_INDEX_H__
+
+#include "comm.h"
+
+#define INVTD_INDEX_IMPACT_SCALE    (256)   /* 得分量化倍数(impact = BM25 * SCALE) */
+#define INVTD_INDEX_IMPACT_MAX      (65535) /* 量化得分上限 */
+#define INVTD_INDEX_FREQ_MAX        (65535) /* 词频上限 */
+#define INVTD_INDEX_DRIFT_RATIO     (0.1)   /* 统计量漂移超过该比例时重新量化 */
+#define INVTD_INDEX_TERM_MAX        (16)    /* 单次查询最多的词项数 */
+#define INVTD_INDEX_CHECK_NUM       (1024)  /* 每评分多少文档检查一次是否需要终止 */
+#define INVTD_INDEX_BLK_SIZE        (64)    /* 每块倒排项数(块级得分上界的粒度) */
+#define INVTD_INDEX_HOT_DF          (1024)  /* 热词的文档频率下限(热词额外维护得分序副本) */
+#define INVTD_INDEX_DEF_K1          (1.2)   /* BM25参数k1默认值 */
+#define INVTD_INDEX_DEF_B           (0.75)  /* BM25参数b默认值 */
+#define INVTD_INDEX_SLOP_MAX        (32)    /* 邻近查询的最大间隔(须小于字段间的位置间隔) */
+#define INVTD_INDEX_FIELD_FREQ_MAX  (255)   /* 字段词频上限 */
+#define INVTD_INDEX_DEF_BOOST_TITLE (3.0)   /* 标题权重默认值 */
+#define INVTD_INDEX_DEF_BOOST_URL   (2.0)   /* URL权重默认值 */
+#define INVTD_INDEX_DEF_BOOST_BODY  (1.0)   /* 正文权重默认值 */
+#define INVTD_INDEX_DEF_PRIOR       (1.0)   /* 静态得分权重默认值(满分时相当于BM25得分PRIOR) */
+
+/* 字段 */
+typedef enum
+{
+    INVTD_FIELD_TITLE                       /* 标题 */
+    , INVTD_FIELD_URL                       /* URL */
+    , INVTD_FIELD_BODY                      /* 正文 */
+
+    , INVTD_FIELD_TOTAL                     /* 字段总数 */
+} invtd_field_e;
+
+/* 倒排项(按docid升序) */
+typedef struct
+{
+    uint32_t docid;                         /* 文档ID */
+    uint16_t freq;                          /* 词频 */
+    uint16_t impact;                        /* 量化BM25得分 */
+    uint8_t ftf[INVTD_FIELD_TOTAL];         /* 各字段词频(超过INVTD_INDEX_FIELD_FREQ_MAX时取上限) */
+} invtd_posting_t;
+
+/* 词项 */
+typedef struct
+{
+    char *word;                             /* 关键字 */
+    int num;                                /* 倒排项数(即: 文档频率df) */
+    int max;                                /* 倒排项容量 */
+    invtd_posting_t *list;                  /* 倒排列表 */
+    int qdf;                                /* 最近一次量化时的文档频率 */
+
+    uint16_t max_impact;                    /* 词项得分上界(最大量化得分) */
+    uint16_t *blk_max;                      /* 块级得分上界(每INVTD_INDEX_BLK_SIZE个倒排项一块) */
+
+    int imp_num;                            /* 得分序副本的倒排项数(副本建立后追加的倒排项
+                                               位于list[imp_num, num)) */
+    invtd_posting_t *imp_list;              /* 得分序副本(按量化得分降序, 仅热词) */
+    bool imp_dirty;                         /* 得分序副本是否已失效(等待重建) */
+    bool imp_queued;                        /* 是否已在待重建队列中 */
+    uint64_t imp_prior;                     /* 建立得分序副本时的静态得分更新序号 */
+
+    uint32_t *pos_off;                      /* 位置列表偏移(与list平行, 值为位置流偏移+1, 0:无位置信息) */
+    uint8_t *pos_buf;                       /* 位置流(每个位置列表为: 位置数 + 各位置差值, 均为变长编码) */
+    uint32_t pos_len;                       /* 位置流已用长度 */
+    uint32_t pos_size;                      /* 位置流容量 */
+    uint32_t pos_dead;                      /* 位置流中已废弃的长度(超过一半时压实) */
+} invtd_term_t;
+
+/* 文档 */
+typedef struct
+{
+    char *url;                              /* URL */
+    uint32_t len;                           /* 文档长度(词频之和) */
+    uint16_t prior;                         /* 静态得分(已量化, 与量化得分同一尺度) */
+
+    int term_num;                           /* 所含词项数 */
+    int term_max;                           /* 所含词项容量 */
+    uint32_t *terms;                        /* 所含词项(termid, 重新索引时据此删除旧倒排项) */
+} invtd_doc_t;
+
+/* 哈希索引(开放寻址, 线性探测) */
+typedef struct
+{
+    uint32_t mask;                          /* 槽位数-1(槽位数为2的次方) */
+    uint32_t num;                           /* 已用槽位数 */
+    uint32_t *slot;                         /* 槽位(ID+1, 0:空闲) */
+} invtd_index_hash_t;
+
+/* 索引参数 */
+typedef struct
+{
+    double k1;                              /* BM25参数k1(词频饱和度) */
+    double b;                               /* BM25参数b(文档长度归一化强度) */
+    double boost[INVTD_FIELD_TOTAL];        /* 各字段权重 */
+    bool position;                          /* 是否记录位置信息 */
+    double prior;                           /* 静态得分权重 */
+    bool prior_order;                       /* 得分序副本是否按(量化得分 + 静态得分)排列 */
+} invtd_index_opt_t;
+
+/* 索引对象
+ *  注: 由倒排表锁(invtab_lock)保护, 写操作只在插入线程中进行 */
+typedef struct
+{
+    double k1;                              /* BM25参数k1 */
+    double b;                               /* BM25参数b */
+    bool position;                          /* 是否记录位置信息(短语及邻近查询) */
+    double boost[INVTD_FIELD_TOTAL];        /* 各字段权重(加权词频 = Σ权重 * 字段词频) */
+
+    double prior;                           /* 静态得分权重 */
+    bool prior_order;                       /* 得分序副本是否按(量化得分 + 静态得分)排列 */
+    uint16_t prior_max;                     /* 静态得分上界 */
+    uint64_t prior_update;                  /* 静态得分更新序号(静态得分变化时递增) */
+    uint64_t prior_merge;                   /* 最近一次合并处理时的静态得分更新序号 */
+
+    int doc_num;                            /* 文档数 */
+    int doc_max;                            /* 文档容量 */
+    invtd_doc_t *doc;                       /* 文档表(以docid为下标) */
+    invtd_index_hash_t doc_hash;            /* URL -> docid */
+    uint64_t total_len;                     /* 文档总长度 */
+
+    int term_num;                           /* 词项数 */
+    int term_max;                           /* 词项容量 */
+    invtd_term_t *term;                     /* 词典(以termid为下标) */
+    invtd_index_hash_t term_hash;           /* 关键字 -> termid */
+
+    uint64_t update;                        /* 更新序号(新增倒排项时递增) */
+
+    int hot_num;                            /* 待重建得分序副本的热词数 */
+    int hot_max;                            /* 待重建队列容量 */
+    int *hot;                               /* 待重建得分序副本的热词(termid) */
+
+    struct {
+        int doc_num;                        /* 文档数 */
+        double avgdl;                       /* 平均文档长度 */
+    } quant;                                /* 最近一次全量量化时的集合统计 */
+} invtd_index_t;
+
+/* 搜索命中 */
+typedef struct
+{
+    uint32_t docid;                         /* 文档ID */
+    uint32_t score;                         /* 得分(各词项量化得分及静态得分之和) */
+    uint32_t freq;                          /* 词频(各词项词频之和) */
+} invtd_hit_t;
+
+/* 终止检查回调(返回true时终止评分) */
+typedef bool (*invtd_index_stop_cb_t)(void *args);
+
+invtd_index_t *invtd_index_creat(const invtd_index_opt_t *opt);
+int invtd_index_insert(invtd_index_t *idx, const char *word, const char *url,
+        int freq, const int *ftf, const uint32_t *loc);
+int invtd_index_remove(invtd_index_t *idx, const char *url);
+int invtd_index_prior_set(invtd_index_t *idx, const char *url, double score);
+void invtd_index_merge(invtd_index_t *idx);
+int invtd_index_query(invtd_index_t *idx, char **words, int num, int topk,
+        invtd_hit_t *hit, invtd_index_stop_cb_t stop, void *args);
+int invtd_index_phrase(invtd_index_t *idx, char **words, int num, int phrase, int slop,
+        int topk, invtd_hit_t *hit, invtd_index_stop_cb_t stop, void *args);
+
+#define invtd_index_doc_url(idx, docid) ((idx)->doc[docid].url)
+
+#endif /*__INVTD_INDEX_H__*/
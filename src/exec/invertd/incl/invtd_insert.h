@@ -0,0 +1,40 @@
+#if !defined(__INVTD_INSERT_H__)
+#define __INVTD_INSERT_H__
+
+#include "cmd.h"
+#include "comm.h"
+#include "invtd_doc.h"
+
+/* 待插入关键字(或文档、静态得分) */
+typedef struct
+{
+    int type;                               /* 请求类型(MSG_INSERT_WORD_REQ/MSG_INDEX_DOC_REQ/MSG_SET_DOC_SCORE_REQ) */
+    uint64_t sid;                           /* 会话ID */
+    uint32_t nid;                           /* 结点ID */
+    uint64_t serial;                        /* 流水号 */
+    int code;                               /* 应答码(插入完成后设置) */
+    mesg_insert_word_req_t req;             /* 插入请求(主机字节序, 文档索引及设置静态得分请求只使用url) */
+    invtd_doc_terms_t *doc;                 /* 待索引文档(仅文档索引请求, 由插入线程释放) */
+    uint32_t score;                         /* 静态得分(仅设置静态得分请求) */
+} invtd_insert_item_t;
+
+/* 插入队列(低优先级)
+ *  注: 插入请求需持有倒排表写锁, 由专用线程批量执行, 避免占用工作线程及
+ *      频繁加写锁而拖慢搜索请求 */
+typedef struct
+{
+    int max;                                /* 队列容量 */
+    int batch;                              /* 单次加写锁最多插入的个数 */
+
+    pthread_t tid;                          /* 插入线程 */
+    pthread_mutex_t lock;                   /* 互斥锁 */
+    pthread_cond_t cond;                    /* 条件变量 */
+
+    int head;                               /* 队首位置 */
+    int num;                                /* 队列长度 */
+    invtd_insert_item_t *ring;              /* 环形队列 */
+} invtd_insert_queue_t;
+
+invtd_insert_queue_t *invtd_insert_queue_creat(int max, int batch);
+
+#endif /*__INVTD_INSERT_H__*/
@@ -11,5 +11,9 @@
 
 int invtd_search_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
 int invtd_insert_word_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
+int invtd_cancel_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
+int invtd_suggest_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
+int invtd_index_doc_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
+int invtd_set_doc_score_req_hdl(int type, int dev_orig, char *buff, size_t len, void *args);
 
 #endif /*__INVTD_MESG_H__*/
@@ -0,0 +1,47 @@
+#if !defined(__INVTD_TOKEN_H__)
+#define __INVTD_TOKEN_H__
+
+#include "comm.h"
+#include "log.h"
+
+#define INVTD_TOKEN_WORD_LEN    (128)       /* 词的最大长度(含结束符, 与SRCH_WORD_LEN一致) */
+
+/* 字符类别 */
+typedef enum
+{
+    INVTD_TOKEN_SEP                         /* 分隔符(空白及标点) */
+    , INVTD_TOKEN_WORD                      /* 单词字符(字母、数字等, 连续出现时组成一个词) */
+    , INVTD_TOKEN_CJK                       /* 中日韩文字(按词典切分) */
+    , INVTD_TOKEN_JOIN                      /* 连接符(只能出现在单词字符之间, 如: e-mail中的'-') */
+} invtd_token_class_e;
+
+/* 双数组单元 */
+typedef struct
+{
+    int32_t base;                           /* 子结点的起始位置(子结点 = base + code) */
+    int32_t check;                          /* 父结点+1(0:空闲) */
+} invtd_token_unit_t;
+
+/* 分词器
+ *  注: 词典以双数组Trie组织(按字节转移, code = 字节 + 1, code 0表示词结束),
+ *      建成后只读, 可被多个线程同时使用 */
+typedef struct
+{
+    uint8_t ascii[128];                     /* ASCII字符类别表 */
+
+    int word_num;                           /* 词典词数 */
+    int max_len;                            /* 词典中最长词的字节数 */
+
+    int size;                               /* 双数组长度 */
+    invtd_token_unit_t *unit;               /* 双数组 */
+} invtd_token_t;
+
+/* 切分回调(word:规范化后的词(以\0结尾) len:词长 pos:词序号, 返回非0时终止切分) */
+typedef int (*invtd_token_cb_t)(const char *word, int len, int pos, void *args);
+
+invtd_token_t *invtd_token_creat(const char *dict, log_cycle_t *log);
+void invtd_token_destroy(invtd_token_t *tk);
+int invtd_token_normalize(const char *str, char *out, size_t size);
+int invtd_token_split(const invtd_token_t *tk, const char *text, size_t len, invtd_token_cb_t cb, void *args);
+
+#endif /*__INVTD_TOKEN_H__*/
@@ -0,0 +1,54 @@
+#if !defined(__INVTD_TRIE_H__)
+#define __INVTD_TRIE_H__
+
+#include "comm.h"
+#include "invtd_index.h"
+
+#define INVTD_TRIE_REBUILD_INTV (1)         /* 前缀树最短重建间隔(秒) */
+#define INVTD_TRIE_FUZZY_MAX    (2)         /* 模糊匹配的最大编辑距离上限 */
+
+/* 前缀树结点
+ *  注: 子结点连续存放且按label升序, 深度优先序即关键字的字典序, 因此每个结点
+ *      子树中的词项在有序词典中占据连续区间[lo, hi) */
+typedef struct
+{
+    uint32_t child;                         /* 首个子结点下标 */
+    uint32_t lo;                            /* 子树词项在有序词典中的起始位置 */
+    uint32_t hi;                            /* 子树词项在有序词典中的结束位置(不含) */
+    uint16_t child_num;                     /* 子结点数 */
+    uint8_t label;                          /* 入边字节 */
+    uint8_t is_term;                        /* 是否有词项在此结束(即有序词典中的lo位置) */
+} invtd_trie_node_t;
+
+/* 前缀树(静态词典)
+ *  注: 建成后只读, 由插入线程定期重建后整体替换 */
+typedef struct
+{
+    time_t ctm;                             /* 创建时间 */
+    uint64_t update;                        /* 创建时索引的更新序号 */
+
+    uint32_t node_num;                      /* 结点数 */
+    invtd_trie_node_t *node;                /* 结点(0号为根) */
+
+    uint32_t term_num;                      /* 词项数 */
+    uint32_t *termid;                       /* 有序词典(按关键字字典序排列的termid) */
+    uint32_t *df;                           /* 文档频率(与有序词典一一对应) */
+
+    uint32_t seg_size;                      /* 线段树叶子数(2的次方) */
+    uint32_t *seg;                          /* 线段树(各区间中文档频率最大的位置) */
+} invtd_trie_t;
+
+/* 建议项 */
+typedef struct
+{
+    uint32_t termid;                        /* 词项ID */
+    uint32_t df;                            /* 文档频率 */
+    uint32_t dist;                          /* 编辑距离(仅模糊匹配) */
+} invtd_trie_item_t;
+
+invtd_trie_t *invtd_trie_build(const invtd_index_t *idx);
+void invtd_trie_destroy(invtd_trie_t *trie);
+int invtd_trie_suggest(const invtd_trie_t *trie, const char *prefix, int num, invtd_trie_item_t *item);
+int invtd_trie_fuzzy(const invtd_trie_t *trie, const char *word, int dist, int num, invtd_trie_item_t *item);
+
+#endif /*__INVTD_TRIE_H__*/
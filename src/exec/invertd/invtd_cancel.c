@@ -0,0 +1,147 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_cancel.c
+ ** 版本号: 1.0
+ ** 描  述: 请求取消
+ **         客户端断开连接后, 接入服务发送MSG_CANCEL_REQ, 此处记录被取消的流水号:
+ **         尚未处理的请求直接丢弃, 正在遍历的请求提前结束.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invertd.h"
+#include "invtd_mesg.h"
+
+/* 哈希(MurmurHash3 fmix64) */
+static inline uint64_t invtd_cancel_hash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+#define INVTD_CANCEL_SLOT_IDX(h)   ((h) & (INVTD_CANCEL_SLOT_NUM - 1))
+
+/******************************************************************************
+ **函数名称: invtd_cancel_tab_creat
+ **功    能: 创建已取消请求表
+ **输入参数:
+ **     ttl: 有效时长(秒)
+ **输出参数: NONE
+ **返    回: 已取消请求表
+ **实现描述:
+ **注意事项: 有效时长不应小于请求的最长截止时间, 否则迟到的请求仍会被处理
+ **作    者:
+ ******************************************************************************/
+invtd_cancel_tab_t *invtd_cancel_tab_creat(int ttl)
+{
+    invtd_cancel_tab_t *tab;
+
+    tab = (invtd_cancel_tab_t *)calloc(1, sizeof(invtd_cancel_tab_t));
+    if (NULL == tab) {
+        return NULL;
+    }
+
+    tab->ttl = ttl;
+    pthread_mutex_init(&tab->lock, NULL);
+
+    return tab;
+}
+
+/******************************************************************************
+ **函数名称: invtd_cancel_add
+ **功    能: 记录已取消的请求
+ **输入参数:
+ **     tab: 已取消请求表
+ **     serial: 流水号
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+void invtd_cancel_add(invtd_cancel_tab_t *tab, uint64_t serial)
+{
+    invtd_cancel_item_t *item;
+
+    item = &tab->slot[INVTD_CANCEL_SLOT_IDX(invtd_cancel_hash(serial))];
+
+    pthread_mutex_lock(&tab->lock);
+    item->serial = serial;
+    item->ctm = time(NULL);
+    pthread_mutex_unlock(&tab->lock);
+}
+
+/******************************************************************************
+ **函数名称: invtd_cancel_is_cancelled
+ **功    能: 判断请求是否已被取消
+ **输入参数:
+ **     tab: 已取消请求表
+ **     serial: 流水号
+ **输出参数: NONE
+ **返    回: true:已取消 false:未取消
+ **实现描述: 超过有效时长的记录视为无效
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+bool invtd_cancel_is_cancelled(invtd_cancel_tab_t *tab, uint64_t serial)
+{
+    bool is_cancelled;
+    invtd_cancel_item_t *item;
+
+    item = &tab->slot[INVTD_CANCEL_SLOT_IDX(invtd_cancel_hash(serial))];
+
+    pthread_mutex_lock(&tab->lock);
+    is_cancelled = (item->serial == serial && time(NULL) - item->ctm <= tab->ttl);
+    pthread_mutex_unlock(&tab->lock);
+
+    return is_cancelled;
+}
+
+/******************************************************************************
+ **函数名称: invtd_cancel_req_hdl
+ **功    能: 处理取消请求
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源结点ID
+ **     buff: 取消请求
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 逐一记录被取消的流水号
+ **注意事项: 取消请求无需应答
+ **作    者:
+ ******************************************************************************/
+int invtd_cancel_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    uint32_t idx;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+    mesg_cancel_req_t *req = (mesg_cancel_req_t *)(head + 1);
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_cancel_req_t))) {
+        log_error(ctx->log, "Cancel request is too short! len:%lu", len);
+        return INVT_ERR;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+    req->num = ntohl(req->num);
+    if (req->num > MESG_CANCEL_MAX_NUM || len < MESG_TOTAL_LEN(MESG_CANCEL_REQ_LEN(req->num))) {
+        log_error(ctx->log, "Cancel request is invalid! num:%u len:%lu", req->num, len);
+        return INVT_ERR;
+    }
+
+    /* > 记录已取消的请求 */
+    for (idx=0; idx<req->num; ++idx) {
+        req->serial[idx] = ntoh64(req->serial[idx]);
+        invtd_cancel_add(ctx->cancel, req->serial[idx]);
+
+        log_debug(ctx->log, "Cancel request! sid:%lu serial:%lu", head->sid, req->serial[idx]);
+    }
+
+    return INVT_OK;
+}
@@ -1,4 +1,4 @@
-#include "invtab.h"
+#include "cmd.h"
 #include "invertd.h"
 #include "invtd_priv.h"
 
@@ -96,13 +96,14 @@ int invtd_usage(const char *exec)
  **     log: 日志对象
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 依次创建所需要的资源(日志 SDTP服务 倒排表等)
+ **实现描述: 依次创建所需要的资源(日志 SDTP服务 评分索引等)
  **注意事项: 
  **作    者: # Qifeng.zou # 2015.05.07 #
  ******************************************************************************/
 invtd_cntx_t *invtd_init(const invtd_conf_t *conf, log_cycle_t *log)
 {
     invtd_cntx_t *ctx;
+    invtd_index_opt_t opt;
 
     /* > 创建倒排对象 */
     ctx = (invtd_cntx_t *)calloc(1, sizeof(invtd_cntx_t));
@@ -115,14 +116,46 @@ invtd_cntx_t *invtd_init(const invtd_conf_t *conf, log_cycle_t *log)
     memcpy(&ctx->conf, conf, sizeof(ctx->conf));
 
     do {
-        /* > 创建倒排表 */
-        ctx->invtab = invtab_creat(ctx->conf.invt_tab_max, log);
-        if (NULL == ctx->invtab) {
-            log_error(log, "Create invert table failed!");
+        pthread_rwlock_init(&ctx->invtab_lock, NULL);
+
+        /* > 创建分词器 */
+        ctx->token = invtd_token_creat(ctx->conf.token.dict, log);
+        if (NULL == ctx->token) {
+            log_error(log, "Create tokenizer failed! dict:%s", ctx->conf.token.dict);
             break;
         }
 
-        pthread_rwlock_init(&ctx->invtab_lock, NULL);
+        /* > 创建评分索引 */
+        memset(&opt, 0, sizeof(opt));
+
+        opt.k1 = ctx->conf.bm25.k1;
+        opt.b = ctx->conf.bm25.b;
+        opt.boost[INVTD_FIELD_TITLE] = ctx->conf.boost.title;
+        opt.boost[INVTD_FIELD_URL] = ctx->conf.boost.url;
+        opt.boost[INVTD_FIELD_BODY] = ctx->conf.boost.body;
+        opt.position = ctx->conf.index.position;
+        opt.prior = ctx->conf.prior.weight;
+        opt.prior_order = ctx->conf.prior.order;
+
+        ctx->index = invtd_index_creat(&opt);
+        if (NULL == ctx->index) {
+            log_error(log, "Create score index failed!");
+            break;
+        }
+
+        /* > 创建插入队列 */
+        ctx->insertq = invtd_insert_queue_creat(ctx->conf.insert.queue, ctx->conf.insert.batch);
+        if (NULL == ctx->insertq) {
+            log_error(log, "Create insert queue failed!");
+            break;
+        }
+
+        /* > 创建已取消请求表 */
+        ctx->cancel = invtd_cancel_tab_creat(MESG_DEADLINE_MAX / 1000);
+        if (NULL == ctx->cancel) {
+            log_error(log, "Create cancel table failed!");
+            break;
+        }
 
         /* > 初始化下行服务 */
         ctx->frwder = rtmq_proxy_init(&ctx->conf.frwder, log);
@@ -152,12 +185,16 @@ invtd_cntx_t *invtd_init(const invtd_conf_t *conf, log_cycle_t *log)
  ******************************************************************************/
 static int invtd_insert_word(invtd_cntx_t *ctx)
 {
+    char norm[SRCH_WORD_LEN];
+
 #define INVERT_INSERT(ctx, word, url, freq) \
+    invtd_token_normalize(word, norm, sizeof(norm)); \
     pthread_rwlock_wrlock(&ctx->invtab_lock); \
-    if (invtab_insert(ctx->invtab, word, url, freq)) { \
+    if (invtd_index_insert(ctx->index, norm, url, freq, NULL, NULL)) { \
         pthread_rwlock_unlock(&ctx->invtab_lock); \
         return INVT_ERR; \
     } \
+    invtd_index_merge(ctx->index); \
     pthread_rwlock_unlock(&ctx->invtab_lock); \
 
 
@@ -191,6 +228,12 @@ static int invtd_insert_word(invtd_cntx_t *ctx)
  ******************************************************************************/
 int invtd_launch(invtd_cntx_t *ctx)
 {
+    /* 启动插入线程 */
+    if (invtd_insert_launch(ctx)) {
+        log_fatal(ctx->log, "Startup insert thread failed!");
+        return INVT_ERR;
+    }
+
     /* 启动DownStream */
     if (invtd_start_frwder(ctx)) {
         log_fatal(ctx->log, "Startup sdtp failed!");
@@ -7,9 +7,10 @@
  ** 作  者: # Qifeng.zou # Fri 08 May 2015 08:27:51 AM CST #
  ******************************************************************************/
 
-#include "invtab.h"
+#include "cmd.h"
 #include "xml_tree.h"
 #include "invtd_conf.h"
+#include "invtd_trie.h"
 
 static int invtd_conf_load_comm(xml_tree_t *xml, invtd_conf_t *conf);
 static int invtd_conf_load_frwder(xml_tree_t *xml, rtmq_proxy_conf_t *conf, invtd_conf_t *icf, const char *path);
@@ -243,13 +244,165 @@ static int invtd_conf_load_comm(xml_tree_t *xml, invtd_conf_t *conf)
     getcwd(path, sizeof(path));
     snprintf(conf->path, sizeof(conf->path), "%s/../temp/invertd/%d", path, conf->nid);
 
-    /* > 倒排表长度 */
-    node = xml_query(xml, ".INVERTD.INVT_TAB.MAX");
-    if (NULL == node) {
-        return INVT_ERR_CONF;
+    /* > 搜索应答分页大小(可选) */
+    node = xml_query(xml, ".INVERTD.SEARCH.PAGE_SIZE");
+    if (NULL == node || 0 == node->value.len) {
+        conf->page_size = 0;
+    } else {
+        conf->page_size = str_to_num(node->value.str);
+        if (conf->page_size < 0) {
+            conf->page_size = 0;
+        }
     }
 
-    conf->invt_tab_max = str_to_num(node->value.str);
+    /* > 搜索结果数上限(可选) */
+    node = xml_query(xml, ".INVERTD.SEARCH.TOPK");
+    if (NULL == node || 0 == node->value.len) {
+        conf->topk = INVTD_SEARCH_DEF_TOPK;
+    } else {
+        conf->topk = str_to_num(node->value.str);
+        if (conf->topk <= 0) {
+            conf->topk = INVTD_SEARCH_DEF_TOPK;
+        }
+    }
+
+    /* > 模糊匹配配置(可选) */
+    node = xml_query(xml, ".INVERTD.SEARCH.FUZZY_MAX");
+    if (NULL == node || 0 == node->value.len) {
+        conf->fuzzy.max = INVTD_FUZZY_DEF_MAX;
+    } else {
+        conf->fuzzy.max = str_to_num(node->value.str);
+        if ((conf->fuzzy.max < 0) || (conf->fuzzy.max > INVTD_TRIE_FUZZY_MAX)) {
+            conf->fuzzy.max = INVTD_FUZZY_DEF_MAX;
+        }
+    }
+
+    node = xml_query(xml, ".INVERTD.SEARCH.FUZZY_EXPAND");
+    if (NULL == node || 0 == node->value.len) {
+        conf->fuzzy.expand = INVTD_FUZZY_DEF_EXPAND;
+    } else {
+        conf->fuzzy.expand = str_to_num(node->value.str);
+        if ((conf->fuzzy.expand <= 0) || (conf->fuzzy.expand > MESG_SUGGEST_MAX_NUM)) {
+            conf->fuzzy.expand = INVTD_FUZZY_DEF_EXPAND;
+        }
+    }
+
+    /* > BM25评分配置(可选) */
+    node = xml_query(xml, ".INVERTD.BM25.K1");
+    if (NULL == node || 0 == node->value.len) {
+        conf->bm25.k1 = INVTD_INDEX_DEF_K1;
+    } else {
+        conf->bm25.k1 = atof(node->value.str);
+        if (conf->bm25.k1 < 0) {
+            conf->bm25.k1 = INVTD_INDEX_DEF_K1;
+        }
+    }
+
+    node = xml_query(xml, ".INVERTD.BM25.B");
+    if (NULL == node || 0 == node->value.len) {
+        conf->bm25.b = INVTD_INDEX_DEF_B;
+    } else {
+        conf->bm25.b = atof(node->value.str);
+        if ((conf->bm25.b < 0) || (conf->bm25.b > 1)) {
+            conf->bm25.b = INVTD_INDEX_DEF_B;
+        }
+    }
+
+    /* > 字段权重配置(可选) */
+    node = xml_query(xml, ".INVERTD.BOOST.TITLE");
+    conf->boost.title = (NULL == node || 0 == node->value.len)? 0 : atof(node->value.str);
+    if (conf->boost.title <= 0) {
+        conf->boost.title = INVTD_INDEX_DEF_BOOST_TITLE;
+    }
+
+    node = xml_query(xml, ".INVERTD.BOOST.URL");
+    conf->boost.url = (NULL == node || 0 == node->value.len)? 0 : atof(node->value.str);
+    if (conf->boost.url <= 0) {
+        conf->boost.url = INVTD_INDEX_DEF_BOOST_URL;
+    }
+
+    node = xml_query(xml, ".INVERTD.BOOST.BODY");
+    conf->boost.body = (NULL == node || 0 == node->value.len)? 0 : atof(node->value.str);
+    if (conf->boost.body <= 0) {
+        conf->boost.body = INVTD_INDEX_DEF_BOOST_BODY;
+    }
+
+    /* > 索引配置(可选) */
+    node = xml_query(xml, ".INVERTD.INDEX.POSITION");
+    if (NULL == node || 0 == node->value.len) {
+        conf->index.position = true;
+    } else {
+        conf->index.position = !strcasecmp(node->value.str, "on");
+    }
+
+    /* > 静态得分配置(可选) */
+    node = xml_query(xml, ".INVERTD.PRIOR.WEIGHT");
+    if (NULL == node || 0 == node->value.len) {
+        conf->prior.weight = INVTD_INDEX_DEF_PRIOR;
+    } else {
+        conf->prior.weight = atof(node->value.str);
+        if (conf->prior.weight < 0) {
+            conf->prior.weight = INVTD_INDEX_DEF_PRIOR;
+        }
+    }
+
+    node = xml_query(xml, ".INVERTD.PRIOR.ORDER");
+    conf->prior.order = (NULL != node && !strcasecmp(node->value.str, "on"));
+
+    /* > 分词配置(可选) */
+    node = xml_query(xml, ".INVERTD.TOKEN.DICT");
+    if (NULL == node || 0 == node->value.len) {
+        conf->token.dict[0] = '\0';
+    } else {
+        snprintf(conf->token.dict, sizeof(conf->token.dict), "%s", node->value.str);
+    }
+
+    /* > 插入配置(可选) */
+    node = xml_query(xml, ".INVERTD.INSERT.QUEUE");
+    if (NULL == node || 0 == node->value.len) {
+        conf->insert.queue = INVTD_INSERT_DEF_QUEUE;
+    } else {
+        conf->insert.queue = str_to_num(node->value.str);
+        if (conf->insert.queue <= 0) {
+            conf->insert.queue = INVTD_INSERT_DEF_QUEUE;
+        }
+    }
+
+    node = xml_query(xml, ".INVERTD.INSERT.BATCH");
+    if (NULL == node || 0 == node->value.len) {
+        conf->insert.batch = INVTD_INSERT_DEF_BATCH;
+    } else {
+        conf->insert.batch = str_to_num(node->value.str);
+        if (conf->insert.batch <= 0) {
+            conf->insert.batch = INVTD_INSERT_DEF_BATCH;
+        }
+    }
+
+    /* > 应答压缩配置(可选) */
+    node = xml_query(xml, ".INVERTD.COMPRESS.ENABLE");
+    if (NULL == node || 0 == node->value.len) {
+        conf->compress.enable = false;
+        return INVT_OK;
+    }
+
+    conf->compress.enable = !strcasecmp(node->value.str, "on");
+
+    node = xml_query(xml, ".INVERTD.COMPRESS.LEVEL");
+    if (NULL == node || 0 == node->value.len) {
+        conf->compress.level = 1;
+    } else {
+        conf->compress.level = str_to_num(node->value.str);
+        if ((conf->compress.level < 1) || (conf->compress.level > 9)) {
+            conf->compress.level = 1;
+        }
+    }
+
+    node = xml_query(xml, ".INVERTD.COMPRESS.THRESHOLD");
+    if (NULL == node || 0 == node->value.len) {
+        conf->compress.threshold = 1 * KB;
+    } else {
+        conf->compress.threshold = str_to_num(node->value.str);
+    }
 
     return INVT_OK;
 }
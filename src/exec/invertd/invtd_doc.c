@@ -0,0 +1,300 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_doc.c
+ ** 版本号: 1.0
+ ** 描  述: 文档索引
+ **         一次请求携带整篇文档(URL + 标题 + 正文), 由服务端分词并统计词频、
+ **         各字段词频及位置, 再经插入队列在同一批写锁内写入全部倒排项, 取代逐词插入.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invertd.h"
+#include "invtd_mesg.h"
+
+/* 词(分词结果) */
+typedef struct
+{
+    char *word;                             /* 关键字 */
+    uint32_t pos;                           /* 位置 */
+    int field;                              /* 所在字段(invtd_field_e) */
+} invtd_doc_token_t;
+
+/* 分词对象 */
+typedef struct
+{
+    invtd_doc_terms_t *doc;                 /* 待索引文档 */
+    invtd_doc_token_t *token;               /* 词列表 */
+    size_t off;                             /* 关键字缓存已用长度 */
+    uint32_t base;                          /* 当前字段的起始位置 */
+    int field;                              /* 当前字段(invtd_field_e) */
+} invtd_doc_split_t;
+
+static int invtd_doc_token_cmp(const void *_a, const void *_b)
+{
+    int ret;
+    const invtd_doc_token_t *a = (const invtd_doc_token_t *)_a;
+    const invtd_doc_token_t *b = (const invtd_doc_token_t *)_b;
+
+    ret = strcmp(a->word, b->word);
+    if (0 != ret) {
+        return ret;
+    }
+
+    return (a->pos < b->pos)? -1 : ((a->pos > b->pos)? 1 : 0);
+}
+
+/******************************************************************************
+ **函数名称: invtd_doc_split_cb
+ **功    能: 收集分词结果
+ **输入参数:
+ **     word: 规范化后的关键字
+ **     len: 关键字长度
+ **     pos: 关键字在字段内的序号
+ **     args: 分词对象
+ **输出参数: NONE
+ **返    回: 0:继续切分
+ **实现描述:
+ **注意事项: 规范化后长度不超过原长度, 且每个词至少1个字节, 因此缓存不会溢出
+ **作    者:
+ ******************************************************************************/
+static int invtd_doc_split_cb(const char *word, int len, int pos, void *args)
+{
+    invtd_doc_split_t *split = (invtd_doc_split_t *)args;
+    invtd_doc_terms_t *doc = split->doc;
+    invtd_doc_token_t *token = &split->token[doc->token_num++];
+
+    token->word = doc->buf + split->off;
+    token->pos = split->base + pos;
+    token->field = split->field;
+
+    memcpy(token->word, word, len + 1);
+    split->off += len + 1;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_doc_parse
+ **功    能: 解析待索引文档
+ **输入参数:
+ **     tk: 分词器
+ **     url: URL
+ **     title: 标题
+ **     title_len: 标题长度
+ **     body: 正文
+ **     body_len: 正文长度
+ **输出参数: NONE
+ **返    回: 待索引文档
+ **实现描述:
+ **     1. 依次切分标题、URL和正文, 各字段的位置之间间隔INVTD_DOC_FIELD_GAP
+ **     2. 按(关键字, 位置)排序后归并, 得到各词项的词频、各字段词频及升序的位置列表
+ **注意事项: 在工作线程中执行, 不持有任何锁
+ **作    者:
+ ******************************************************************************/
+invtd_doc_terms_t *invtd_doc_parse(const invtd_token_t *tk, const char *url,
+        const char *title, size_t title_len, const char *body, size_t body_len)
+{
+    int i, j;
+    invtd_doc_terms_t *doc;
+    invtd_doc_term_t *term;
+    invtd_doc_split_t split;
+    size_t url_len = strlen(url), max = title_len + url_len + body_len;
+
+    doc = (invtd_doc_terms_t *)calloc(1, sizeof(invtd_doc_terms_t));
+    if (NULL == doc) {
+        return NULL;
+    }
+
+    snprintf(doc->url, sizeof(doc->url), "%s", url);
+
+    memset(&split, 0, sizeof(split));
+
+    split.doc = doc;
+
+    do {
+        /* > 分配缓存(词数不超过文本字节数) */
+        split.token = (invtd_doc_token_t *)calloc(max + 1, sizeof(invtd_doc_token_t));
+        doc->buf = (char *)calloc(2 * max + 1, sizeof(char));
+        doc->pos = (uint32_t *)calloc(max + 1, sizeof(uint32_t));
+        if (NULL == split.token || NULL == doc->buf || NULL == doc->pos) {
+            break;
+        }
+
+        /* > 切分标题、URL及正文 */
+        split.field = INVTD_FIELD_TITLE;
+        invtd_token_split(tk, title, title_len, invtd_doc_split_cb, (void *)&split);
+
+        split.base = doc->token_num + INVTD_DOC_FIELD_GAP;
+        split.field = INVTD_FIELD_URL;
+        invtd_token_split(tk, url, url_len, invtd_doc_split_cb, (void *)&split);
+
+        split.base = doc->token_num + 2 * INVTD_DOC_FIELD_GAP;
+        split.field = INVTD_FIELD_BODY;
+        invtd_token_split(tk, body, body_len, invtd_doc_split_cb, (void *)&split);
+
+        /* > 归并相同的关键字 */
+        qsort(split.token, doc->token_num, sizeof(invtd_doc_token_t), invtd_doc_token_cmp);
+
+        doc->term = (invtd_doc_term_t *)calloc(doc->token_num + 1, sizeof(invtd_doc_term_t));
+        if (NULL == doc->term) {
+            break;
+        }
+
+        for (i=0; i<doc->token_num; i=j) {
+            term = &doc->term[doc->num++];
+            term->word = split.token[i].word;
+            term->pos = doc->pos + i;
+            for (j=i; j<doc->token_num && 0 == strcmp(split.token[j].word, term->word); ++j) {
+                doc->pos[j] = split.token[j].pos;
+                ++term->ftf[split.token[j].field];
+            }
+            term->freq = j - i;
+        }
+
+        free(split.token);
+        return doc;
+    } while (0);
+
+    free(split.token);
+    invtd_doc_free(doc);
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: invtd_doc_free
+ **功    能: 释放待索引文档
+ **输入参数:
+ **     doc: 待索引文档
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+void invtd_doc_free(invtd_doc_terms_t *doc)
+{
+    if (NULL == doc) {
+        return;
+    }
+
+    free(doc->term);
+    free(doc->pos);
+    free(doc->buf);
+    free(doc);
+}
+
+/******************************************************************************
+ **函数名称: invtd_doc_rsp
+ **功    能: 发送文档索引应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     item: 插入请求
+ **     code: 应答码
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 源节点ID(orig)将成为应答消息的目的节点ID(dest)
+ **作    者:
+ ******************************************************************************/
+int invtd_doc_rsp(invtd_cntx_t *ctx, const invtd_insert_item_t *item, int code)
+{
+    mesg_index_doc_rsp_t *rsp;
+    mesg_header_t *rsp_head;
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_index_doc_rsp_t)];
+
+    rsp_head = (mesg_header_t *)addr;
+    rsp = (mesg_index_doc_rsp_t *)(rsp_head + 1);
+
+    /* > 设置应答信息 */
+    rsp->code = code;
+    rsp->term_num = (NULL == item->doc)? 0 : item->doc->num;
+    snprintf(rsp->url, sizeof(rsp->url), "%s", item->req.url);
+
+    MESG_HEAD_SET(rsp_head, MSG_INDEX_DOC_RSP, item->sid,
+            item->nid, item->serial, sizeof(mesg_index_doc_rsp_t));
+    MESG_HEAD_HTON(rsp_head, rsp_head);
+    mesg_index_doc_rsp_hton(rsp);
+
+    /* > 发送应答信息 */
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_INDEX_DOC_RSP, (void *)addr, sizeof(addr))) {
+        log_error(ctx->log, "Send response failed! serial:%lu url:%s", item->serial, item->req.url);
+        return INVT_ERR;
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_doc_req_hdl
+ **功    能: 文档索引请求的处理
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源节点ID
+ **     buff: 文档索引-请求数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 在工作线程中完成分词及词频统计, 再放入插入队列由插入线程一次性写入
+ **注意事项: 插入队列已满时直接应答失败, 由上游择机重试
+ **作    者:
+ ******************************************************************************/
+int invtd_index_doc_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    const char *title, *body;
+    invtd_insert_item_t item;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+    mesg_index_doc_req_t *req = (mesg_index_doc_req_t *)(head + 1); /* 请求 */
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_index_doc_req_t))) {
+        log_error(ctx->log, "Index document request is too short! len:%lu", len);
+        return INVT_ERR;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+    mesg_index_doc_req_ntoh(req);
+    req->url[sizeof(req->url) - 1] = '\0';
+
+    if ((uint64_t)req->title_len + req->body_len
+        > len - MESG_TOTAL_LEN(sizeof(mesg_index_doc_req_t)))
+    {
+        log_error(ctx->log, "Index document request is corrupted! url:%s title:%u body:%u len:%lu",
+                req->url, req->title_len, req->body_len, len);
+        return INVT_ERR;
+    }
+
+    memset(&item, 0, sizeof(item));
+
+    item.type = MSG_INDEX_DOC_REQ;
+    item.sid = head->sid;
+    item.nid = head->nid;
+    item.serial = head->serial;
+    snprintf(item.req.url, sizeof(item.req.url), "%s", req->url);
+
+    /* > 分词并统计词频 */
+    title = req->text;
+    body = req->text + req->title_len;
+
+    item.doc = invtd_doc_parse(ctx->token, req->url, title, req->title_len, body, req->body_len);
+    if (NULL == item.doc) {
+        log_error(ctx->log, "Parse document failed! url:%s", req->url);
+        invtd_doc_rsp(ctx, &item, MESG_INDEX_DOC_FAIL);
+        return INVT_ERR;
+    }
+
+    log_debug(ctx->log, "Parse document success! serial:%lu url:%s token:%d term:%d",
+            head->serial, req->url, item.doc->token_num, item.doc->num);
+
+    /* > 放入插入队列 */
+    if (invtd_insert_push(ctx, &item)) {
+        log_error(ctx->log, "Insert queue is full! serial:%lu url:%s", head->serial, req->url);
+        invtd_doc_rsp(ctx, &item, MESG_INDEX_DOC_FAIL);
+        invtd_doc_free(item.doc);
+        return INVT_OK;
+    }
+
+    return INVT_OK;
+}
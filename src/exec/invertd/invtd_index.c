@@ -0,0 +1,1835 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_index.c
+ ** 版本号: 1.0
+ ** 描  述: 评分索引
+ **         维护文档长度及集合统计, 并在插入或合并时为每个倒排项预先计算量化的
+ **         BM25得分(impact). 查询时各词项得分只需整数累加, 无需浮点运算.
+ **         同时维护词项级及块级得分上界, 多词项查询以Block-Max WAND动态剪枝:
+ **         得分上界达不到当前第K名的文档或整块直接跳过, 不做评分.
+ **         热词另外维护按得分降序的副本, 单词项查询取前K个即可结束.
+ **         文档可设置与查询无关的静态得分, 查询时与词项得分相加, 剪枝时计入其上界.
+ **         倒排项分别记录标题、URL及正文中的词频, 量化时按字段权重加权(BM25F),
+ **         查询时仍只需累加量化得分.
+ **         位置信息以变长差值编码另存于各词项的位置流中, 非短语查询不会访问;
+ **         短语查询先按docid求交, 只为交集中的候选文档解码位置.
+ **         文档记录其所含词项, 重新索引时据此删除旧的倒排项, 避免词频累加及残留.
+ ** 作  者:
+ ******************************************************************************/
+#include <math.h>
+
+#include "invtd_index.h"
+
+#define INVTD_INDEX_HASH_INIT       (1024)  /* 哈希索引初始槽位数(必须为2的次方) */
+#define INVTD_INDEX_INIT_NUM        (1024)  /* 文档表/词典初始容量 */
+#define INVTD_INDEX_LIST_INIT       (4)     /* 倒排列表初始容量 */
+#define INVTD_INDEX_DOC_TERM_INIT   (16)    /* 文档所含词项列表初始容量 */
+#define INVTD_INDEX_HOT_INIT        (64)    /* 待重建队列初始容量 */
+#define INVTD_INDEX_POS_INIT        (64)    /* 位置流初始容量 */
+#define INVTD_INDEX_POS_COMPACT     (4096)  /* 位置流废弃长度超过该值且过半时压实 */
+
+/* 查询游标 */
+typedef struct
+{
+    invtd_term_t *term;                     /* 词项 */
+    int pos;                                /* 当前倒排项下标 */
+} invtd_index_cursor_t;
+
+#define INVTD_INDEX_CURSOR_DOCID(cur) /* 游标当前文档ID(已遍历完时为UINT32_MAX) */\
+    (((cur)->pos < (cur)->term->num)? (cur)->term->list[(cur)->pos].docid : UINT32_MAX)
+
+/* 位置迭代器 */
+typedef struct
+{
+    const uint8_t *ptr;                     /* 下一个位置差值 */
+    uint32_t left;                          /* 剩余位置数 */
+    uint32_t pos;                           /* 当前位置(已遍历完时为UINT32_MAX) */
+} invtd_index_pos_iter_t;
+
+/* 得分序副本排序项(按量化得分 + 静态得分排列时使用) */
+typedef struct
+{
+    uint32_t key;                           /* 排序键(量化得分 + 静态得分) */
+    invtd_posting_t post;                   /* 倒排项 */
+} invtd_index_hot_item_t;
+
+/* 取键回调 */
+typedef const char *(*invtd_index_key_cb_t)(const invtd_index_t *idx, uint32_t id);
+
+static const char *invtd_index_doc_key(const invtd_index_t *idx, uint32_t id)
+{
+    return idx->doc[id].url;
+}
+
+static const char *invtd_index_term_key(const invtd_index_t *idx, uint32_t id)
+{
+    return idx->term[id].word;
+}
+
+/* 哈希(FNV-1a) */
+static inline uint32_t invtd_index_hash_str(const char *str)
+{
+    uint32_t h = 2166136261U;
+
+    while ('\0' != *str) {
+        h ^= (uint8_t)*str++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hash_init
+ **功    能: 初始化哈希索引
+ **输入参数:
+ **     hash: 哈希索引
+ **     num: 槽位数(必须为2的次方)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_hash_init(invtd_index_hash_t *hash, uint32_t num)
+{
+    hash->slot = (uint32_t *)calloc(num, sizeof(uint32_t));
+    if (NULL == hash->slot) {
+        return -1;
+    }
+
+    hash->mask = num - 1;
+    hash->num = 0;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hash_probe
+ **功    能: 查找键所在槽位
+ **输入参数:
+ **     idx: 索引对象
+ **     hash: 哈希索引
+ **     key_cb: 取键回调
+ **     key: 键
+ **输出参数: NONE
+ **返    回: 键所在槽位, 不存在时返回其应放入的空闲槽位
+ **实现描述: 线性探测
+ **注意事项: 装载率不超过1/2, 总能找到空闲槽位
+ **作    者:
+ ******************************************************************************/
+static uint32_t *invtd_index_hash_probe(const invtd_index_t *idx,
+        const invtd_index_hash_t *hash, invtd_index_key_cb_t key_cb, const char *key)
+{
+    uint32_t pos = invtd_index_hash_str(key) & hash->mask;
+
+    while (0 != hash->slot[pos]) {
+        if (!strcmp(key_cb(idx, hash->slot[pos] - 1), key)) {
+            break;
+        }
+        pos = (pos + 1) & hash->mask;
+    }
+
+    return &hash->slot[pos];
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hash_expand
+ **功    能: 扩容哈希索引
+ **输入参数:
+ **     idx: 索引对象
+ **     hash: 哈希索引
+ **     key_cb: 取键回调
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 槽位数翻倍后重新放入所有ID
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_hash_expand(const invtd_index_t *idx,
+        invtd_index_hash_t *hash, invtd_index_key_cb_t key_cb)
+{
+    uint32_t pos, *slot;
+    invtd_index_hash_t tmp;
+
+    if (invtd_index_hash_init(&tmp, (hash->mask + 1) << 1)) {
+        return -1;
+    }
+
+    for (pos=0; pos<=hash->mask; ++pos) {
+        if (0 == hash->slot[pos]) {
+            continue;
+        }
+        slot = invtd_index_hash_probe(idx, &tmp, key_cb, key_cb(idx, hash->slot[pos] - 1));
+        *slot = hash->slot[pos];
+        ++tmp.num;
+    }
+
+    free(hash->slot);
+    memcpy(hash, &tmp, sizeof(tmp));
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_creat
+ **功    能: 创建索引对象
+ **输入参数:
+ **     opt: 索引参数
+ **输出参数: NONE
+ **返    回: 索引对象
+ **实现描述:
+ **注意事项: 不记录位置信息时, 短语查询退化为AND语义
+ **作    者:
+ ******************************************************************************/
+invtd_index_t *invtd_index_creat(const invtd_index_opt_t *opt)
+{
+    int field;
+    invtd_index_t *idx;
+
+    idx = (invtd_index_t *)calloc(1, sizeof(invtd_index_t));
+    if (NULL == idx) {
+        return NULL;
+    }
+
+    idx->k1 = opt->k1;
+    idx->b = opt->b;
+    idx->position = opt->position;
+    for (field=0; field<INVTD_FIELD_TOTAL; ++field) {
+        idx->boost[field] = opt->boost[field];
+    }
+    idx->prior = opt->prior;
+    idx->prior_order = opt->prior_order;
+
+    do {
+        idx->doc_max = INVTD_INDEX_INIT_NUM;
+        idx->doc = (invtd_doc_t *)calloc(idx->doc_max, sizeof(invtd_doc_t));
+        if (NULL == idx->doc) {
+            break;
+        }
+
+        idx->term_max = INVTD_INDEX_INIT_NUM;
+        idx->term = (invtd_term_t *)calloc(idx->term_max, sizeof(invtd_term_t));
+        if (NULL == idx->term) {
+            break;
+        }
+
+        if (invtd_index_hash_init(&idx->doc_hash, INVTD_INDEX_HASH_INIT)
+            || invtd_index_hash_init(&idx->term_hash, INVTD_INDEX_HASH_INIT))
+        {
+            break;
+        }
+
+        return idx;
+    } while (0);
+
+    free(idx->doc_hash.slot);
+    free(idx->term);
+    free(idx->doc);
+    free(idx);
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_doc_get
+ **功    能: 获取文档ID
+ **输入参数:
+ **     idx: 索引对象
+ **     url: URL
+ **输出参数: NONE
+ **返    回: 文档ID(-1:失败)
+ **实现描述: 文档不存在时新建, 文档ID按出现顺序递增
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_doc_get(invtd_index_t *idx, const char *url)
+{
+    int docid;
+    uint32_t *slot;
+    invtd_doc_t *doc;
+
+    slot = invtd_index_hash_probe(idx, &idx->doc_hash, invtd_index_doc_key, url);
+    if (0 != *slot) {
+        return (int)(*slot - 1);
+    }
+
+    /* > 新建文档 */
+    if (idx->doc_num >= idx->doc_max) {
+        doc = (invtd_doc_t *)realloc(idx->doc, 2 * idx->doc_max * sizeof(invtd_doc_t));
+        if (NULL == doc) {
+            return -1;
+        }
+        idx->doc = doc;
+        idx->doc_max *= 2;
+    }
+
+    doc = &idx->doc[idx->doc_num];
+    doc->url = strdup(url);
+    if (NULL == doc->url) {
+        return -1;
+    }
+    doc->len = 0;
+    doc->prior = 0;
+    doc->term_num = 0;
+    doc->term_max = 0;
+    doc->terms = NULL;
+
+    docid = idx->doc_num++;
+    *slot = docid + 1;
+
+    if (2 * (++idx->doc_hash.num) > idx->doc_hash.mask) {
+        invtd_index_hash_expand(idx, &idx->doc_hash, invtd_index_doc_key);
+    }
+
+    return docid;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_term_find
+ **功    能: 查找词项
+ **输入参数:
+ **     idx: 索引对象
+ **     word: 关键字
+ **输出参数: NONE
+ **返    回: 词项(不存在时返回NULL)
+ **实现描述:
+ **注意事项: 只读操作, 调用者持有读锁即可
+ **作    者:
+ ******************************************************************************/
+static invtd_term_t *invtd_index_term_find(invtd_index_t *idx, const char *word)
+{
+    uint32_t *slot;
+
+    slot = invtd_index_hash_probe(idx, &idx->term_hash, invtd_index_term_key, word);
+    if (0 == *slot) {
+        return NULL;
+    }
+
+    return &idx->term[*slot - 1];
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_term_get
+ **功    能: 获取词项
+ **输入参数:
+ **     idx: 索引对象
+ **     word: 关键字
+ **输出参数: NONE
+ **返    回: 词项(NULL:失败)
+ **实现描述: 词项不存在时新建
+ **注意事项: 词典扩容后, 此前取得的词项指针失效
+ **作    者:
+ ******************************************************************************/
+static invtd_term_t *invtd_index_term_get(invtd_index_t *idx, const char *word)
+{
+    uint32_t *slot;
+    invtd_term_t *term;
+
+    slot = invtd_index_hash_probe(idx, &idx->term_hash, invtd_index_term_key, word);
+    if (0 != *slot) {
+        return &idx->term[*slot - 1];
+    }
+
+    /* > 新建词项 */
+    if (idx->term_num >= idx->term_max) {
+        term = (invtd_term_t *)realloc(idx->term, 2 * idx->term_max * sizeof(invtd_term_t));
+        if (NULL == term) {
+            return NULL;
+        }
+        idx->term = term;
+        idx->term_max *= 2;
+    }
+
+    term = &idx->term[idx->term_num];
+    memset(term, 0, sizeof(invtd_term_t));
+
+    term->word = strdup(word);
+    if (NULL == term->word) {
+        return NULL;
+    }
+
+    *slot = ++idx->term_num;
+
+    if (2 * (++idx->term_hash.num) > idx->term_hash.mask) {
+        invtd_index_hash_expand(idx, &idx->term_hash, invtd_index_term_key);
+    }
+
+    return term;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_block_rebuild
+ **功    能: 重建块级得分上界
+ **输入参数:
+ **     term: 词项
+ **     pos: 起始倒排项下标
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 重新计算pos所在块及其后所有块的得分上界
+ **注意事项: 不会降低词项得分上界(上界偏大只影响剪枝效率, 不影响正确性)
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_block_rebuild(invtd_term_t *term, int pos)
+{
+    int blk, end;
+    uint16_t max;
+
+    for (blk=pos/INVTD_INDEX_BLK_SIZE; blk*INVTD_INDEX_BLK_SIZE<term->num; ++blk) {
+        max = 0;
+        end = MIN((blk + 1) * INVTD_INDEX_BLK_SIZE, term->num);
+        for (pos=blk*INVTD_INDEX_BLK_SIZE; pos<end; ++pos) {
+            max = MAX(max, term->list[pos].impact);
+        }
+        term->blk_max[blk] = max;
+        term->max_impact = MAX(term->max_impact, max);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_posting_get
+ **功    能: 获取倒排项
+ **输入参数:
+ **     term: 词项
+ **     docid: 文档ID
+ **     position: 是否记录位置信息
+ **输出参数: NONE
+ **返    回: 倒排项(NULL:失败)
+ **实现描述: 倒排项不存在时按docid升序插入(新文档的docid最大, 通常直接追加)
+ **注意事项: 中间插入会使后续倒排项移位, 需重建其后的块级得分上界;
+ **     位置列表偏移与倒排列表平行, 随之移位
+ **作    者:
+ ******************************************************************************/
+static invtd_posting_t *invtd_index_posting_get(invtd_term_t *term, uint32_t docid, bool position)
+{
+    int low = 0, high = term->num, mid, max;
+    uint16_t *blk_max;
+    uint32_t *pos_off;
+    invtd_posting_t *list, *post;
+
+    /* > 查找插入位置 */
+    if (term->num > 0 && term->list[term->num - 1].docid < docid) {
+        low = term->num;
+    }
+    else {
+        while (low < high) {
+            mid = (low + high) >> 1;
+            if (term->list[mid].docid < docid) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        if (low < term->num && term->list[low].docid == docid) {
+            return &term->list[low];
+        }
+    }
+
+    /* > 插入倒排项 */
+    if (term->num >= term->max) {
+        max = term->max? 2 * term->max : INVTD_INDEX_LIST_INIT;
+        list = (invtd_posting_t *)realloc(term->list, max * sizeof(invtd_posting_t));
+        if (NULL == list) {
+            return NULL;
+        }
+        term->list = list;
+
+        blk_max = (uint16_t *)realloc(term->blk_max,
+                (max / INVTD_INDEX_BLK_SIZE + 1) * sizeof(uint16_t));
+        if (NULL == blk_max) {
+            return NULL;
+        }
+        term->blk_max = blk_max;
+
+        if (position) {
+            pos_off = (uint32_t *)realloc(term->pos_off, max * sizeof(uint32_t));
+            if (NULL == pos_off) {
+                return NULL;
+            }
+            term->pos_off = pos_off;
+        }
+        term->max = max;
+    }
+
+    post = &term->list[low];
+    if (low < term->num) {
+        memmove(post + 1, post, (term->num - low) * sizeof(invtd_posting_t));
+        if (NULL != term->pos_off) {
+            memmove(term->pos_off + low + 1, term->pos_off + low, (term->num - low) * sizeof(uint32_t));
+        }
+    }
+    ++term->num;
+
+    if (NULL != term->pos_off) {
+        term->pos_off[low] = 0;
+    }
+
+    post->docid = docid;
+    post->freq = 0;
+    post->impact = 0;
+    memset(post->ftf, 0, sizeof(post->ftf));
+
+    if (low < term->num - 1) {
+        invtd_index_block_rebuild(term, low);
+    }
+    else if (0 == low % INVTD_INDEX_BLK_SIZE) {
+        term->blk_max[low / INVTD_INDEX_BLK_SIZE] = 0; /* 新块 */
+    }
+
+    return post;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_varint_put
+ **功    能: 变长编码
+ **输入参数:
+ **     ptr: 写入位置
+ **     val: 数值
+ **输出参数: NONE
+ **返    回: 下一个写入位置
+ **实现描述: 每字节存放7位, 最高位为1表示后续还有字节
+ **注意事项: 最多占用5个字节
+ **作    者:
+ ******************************************************************************/
+static uint8_t *invtd_index_varint_put(uint8_t *ptr, uint32_t val)
+{
+    while (val >= 0x80) {
+        *ptr++ = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    *ptr++ = (uint8_t)val;
+
+    return ptr;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_varint_get
+ **功    能: 变长解码
+ **输入参数:
+ **     ptr: 读取位置
+ **输出参数:
+ **     val: 数值
+ **返    回: 下一个读取位置
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static const uint8_t *invtd_index_varint_get(const uint8_t *ptr, uint32_t *val)
+{
+    int shift = 0;
+    uint32_t v = 0;
+
+    while (*ptr & 0x80) {
+        v |= (uint32_t)(*ptr++ & 0x7F) << shift;
+        shift += 7;
+    }
+    v |= (uint32_t)(*ptr++) << shift;
+
+    *val = v;
+
+    return ptr;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_pos_len
+ **功    能: 计算位置列表的编码长度
+ **输入参数:
+ **     ptr: 位置列表
+ **输出参数: NONE
+ **返    回: 编码长度
+ **实现描述: 只需统计最高位为0的字节(每个数值的最后一个字节)
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static uint32_t invtd_index_pos_len(const uint8_t *ptr)
+{
+    uint32_t num;
+    const uint8_t *p;
+
+    p = invtd_index_varint_get(ptr, &num);
+    while (num > 0) {
+        if (!(*p++ & 0x80)) {
+            --num;
+        }
+    }
+
+    return (uint32_t)(p - ptr);
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_pos_compact
+ **功    能: 压实位置流
+ **输入参数:
+ **     term: 词项
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 按倒排列表顺序拷贝仍在使用的位置列表, 丢弃被覆盖的旧列表
+ **注意事项: 内存不足时保留原位置流
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_pos_compact(invtd_term_t *term)
+{
+    int idx;
+    uint32_t len, size;
+    uint8_t *buf, *ptr;
+
+    size = MAX(term->pos_len - term->pos_dead, INVTD_INDEX_POS_INIT);
+
+    buf = (uint8_t *)malloc(size);
+    if (NULL == buf) {
+        return;
+    }
+
+    ptr = buf;
+    for (idx=0; idx<term->num; ++idx) {
+        if (0 == term->pos_off[idx]) {
+            continue;
+        }
+        len = invtd_index_pos_len(term->pos_buf + term->pos_off[idx] - 1);
+        memcpy(ptr, term->pos_buf + term->pos_off[idx] - 1, len);
+        term->pos_off[idx] = (uint32_t)(ptr - buf) + 1;
+        ptr += len;
+    }
+
+    free(term->pos_buf);
+
+    term->pos_buf = buf;
+    term->pos_len = (uint32_t)(ptr - buf);
+    term->pos_size = size;
+    term->pos_dead = 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_pos_set
+ **功    能: 设置倒排项的位置列表
+ **输入参数:
+ **     term: 词项
+ **     idx: 倒排项下标
+ **     pos: 位置列表(升序)
+ **     num: 位置数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 新列表追加至位置流末尾, 倒排项原有的列表作废(重复插入时以新列表为准)
+ **     2. 废弃长度过半时压实位置流
+ **注意事项: 内存不足时保留原位置列表
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_pos_set(invtd_term_t *term, int idx, const uint32_t *pos, int num)
+{
+    int i;
+    uint8_t *buf, *ptr;
+    uint32_t last = 0, size, need = 5 * (num + 1);
+
+    if (term->pos_len + need > term->pos_size) {
+        size = term->pos_size? 2 * term->pos_size : INVTD_INDEX_POS_INIT;
+        size = MAX(size, term->pos_len + need);
+        buf = (uint8_t *)realloc(term->pos_buf, size);
+        if (NULL == buf) {
+            return;
+        }
+        term->pos_buf = buf;
+        term->pos_size = size;
+    }
+
+    if (0 != term->pos_off[idx]) {
+        term->pos_dead += invtd_index_pos_len(term->pos_buf + term->pos_off[idx] - 1);
+    }
+
+    /* > 追加位置列表 */
+    term->pos_off[idx] = term->pos_len + 1;
+
+    ptr = invtd_index_varint_put(term->pos_buf + term->pos_len, (uint32_t)num);
+    for (i=0; i<num; ++i) {
+        ptr = invtd_index_varint_put(ptr, pos[i] - last);
+        last = pos[i];
+    }
+    term->pos_len = (uint32_t)(ptr - term->pos_buf);
+
+    /* > 压实位置流 */
+    if (term->pos_dead > INVTD_INDEX_POS_COMPACT && 2 * term->pos_dead > term->pos_len) {
+        invtd_index_pos_compact(term);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_impact
+ **功    能: 计算量化得分
+ **输入参数:
+ **     idx: 索引对象
+ **     df: 文档频率
+ **     post: 倒排项
+ **     dl: 文档长度
+ **输出参数: NONE
+ **返    回: 量化得分
+ **实现描述:
+ **     BM25 = idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * dl / avgdl))
+ **     idf = ln(1 + (N - df + 0.5) / (df + 0.5))
+ **     tf = Σ boost[f] * ftf[f], 各字段词频按权重表累加, 无分支判断
+ **注意事项: 得分至少为1, 以区分命中与未命中
+ **作    者:
+ ******************************************************************************/
+static uint16_t invtd_index_impact(const invtd_index_t *idx,
+        int df, const invtd_posting_t *post, uint32_t dl)
+{
+    int field;
+    double idf, norm, avgdl, score, tf = 0;
+
+    for (field=0; field<INVTD_FIELD_TOTAL; ++field) {
+        tf += idx->boost[field] * post->ftf[field];
+    }
+
+    avgdl = idx->doc_num? (double)idx->total_len / idx->doc_num : 1.0;
+    if (avgdl <= 0) {
+        avgdl = 1.0;
+    }
+
+    idf = log(1.0 + (idx->doc_num - df + 0.5) / (df + 0.5));
+    norm = idx->k1 * (1.0 - idx->b + idx->b * dl / avgdl);
+    score = idf * tf * (idx->k1 + 1.0) / (tf + norm) * INVTD_INDEX_IMPACT_SCALE;
+
+    if (score >= INVTD_INDEX_IMPACT_MAX) {
+        return INVTD_INDEX_IMPACT_MAX;
+    }
+    else if (score < 1.0) {
+        return 1;
+    }
+
+    return (uint16_t)(score + 0.5);
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hot_queue
+ **功    能: 将热词放入待重建队列
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 得分序副本由invtd_index_merge()统一重建
+ **注意事项: 放入失败时副本暂不重建, 查询退回按docid序求值
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_hot_queue(invtd_index_t *idx, invtd_term_t *term)
+{
+    int max, *hot;
+
+    if (term->imp_queued) {
+        return;
+    }
+
+    if (idx->hot_num >= idx->hot_max) {
+        max = idx->hot_max? 2 * idx->hot_max : INVTD_INDEX_HOT_INIT;
+        hot = (int *)realloc(idx->hot, max * sizeof(int));
+        if (NULL == hot) {
+            return;
+        }
+        idx->hot = hot;
+        idx->hot_max = max;
+    }
+
+    idx->hot[idx->hot_num++] = (int)(term - idx->term);
+    term->imp_queued = true;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hot_update
+ **功    能: 倒排项变化后维护得分序副本
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **     pos: 发生变化的倒排项下标
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 变化发生在副本覆盖的范围内(中间插入或词频更新)时, 副本失效
+ **     2. 尚无副本、副本失效或副本建立后追加的倒排项过多时, 放入待重建队列
+ **注意事项: 追加的倒排项在查询时直接扫描, 因此副本无需逐条维护
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_hot_update(invtd_index_t *idx, invtd_term_t *term, int pos)
+{
+    if (term->num < INVTD_INDEX_HOT_DF) {
+        return;
+    }
+
+    if (NULL != term->imp_list && pos < term->imp_num) {
+        term->imp_dirty = true;
+    }
+
+    if (NULL == term->imp_list
+        || term->imp_dirty
+        || term->num - term->imp_num > term->imp_num * INVTD_INDEX_DRIFT_RATIO)
+    {
+        invtd_index_hot_queue(idx, term);
+    }
+}
+
+/* 按量化得分降序(得分相同时按docid升序) */
+static int invtd_index_impact_cmp(const void *_a, const void *_b)
+{
+    const invtd_posting_t *a = (const invtd_posting_t *)_a;
+    const invtd_posting_t *b = (const invtd_posting_t *)_b;
+
+    if (a->impact != b->impact) {
+        return (a->impact > b->impact)? -1 : 1;
+    }
+
+    return (a->docid < b->docid)? -1 : (a->docid > b->docid);
+}
+
+/* 按排序键降序(排序键相同时按docid升序) */
+static int invtd_index_hot_item_cmp(const void *_a, const void *_b)
+{
+    const invtd_index_hot_item_t *a = (const invtd_index_hot_item_t *)_a;
+    const invtd_index_hot_item_t *b = (const invtd_index_hot_item_t *)_b;
+
+    if (a->key != b->key) {
+        return (a->key > b->key)? -1 : 1;
+    }
+
+    return (a->post.docid < b->post.docid)? -1 : (a->post.docid > b->post.docid);
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_hot_rebuild
+ **功    能: 重建得分序副本
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 拷贝倒排列表后按量化得分降序排列; 开启prior_order时按(量化得分 +
+ **     静态得分)降序排列, 此时副本中的次序即最终得分的次序
+ **注意事项: 内存不足时保留原状态, 失效的副本不会被查询使用
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_hot_rebuild(invtd_index_t *idx, invtd_term_t *term)
+{
+    int pos;
+    invtd_posting_t *list;
+    invtd_index_hot_item_t *item;
+
+    term->imp_queued = false;
+
+    list = (invtd_posting_t *)realloc(term->imp_list, term->num * sizeof(invtd_posting_t));
+    if (NULL == list) {
+        return;
+    }
+    term->imp_list = list;
+
+    if (idx->prior_order) {
+        item = (invtd_index_hot_item_t *)malloc(term->num * sizeof(invtd_index_hot_item_t));
+        if (NULL == item) {
+            return;
+        }
+
+        for (pos=0; pos<term->num; ++pos) {
+            item[pos].post = term->list[pos];
+            item[pos].key = term->list[pos].impact + idx->doc[term->list[pos].docid].prior;
+        }
+
+        qsort(item, term->num, sizeof(invtd_index_hot_item_t), invtd_index_hot_item_cmp);
+
+        for (pos=0; pos<term->num; ++pos) {
+            list[pos] = item[pos].post;
+        }
+
+        free(item);
+    }
+    else {
+        memcpy(list, term->list, term->num * sizeof(invtd_posting_t));
+        qsort(list, term->num, sizeof(invtd_posting_t), invtd_index_impact_cmp);
+    }
+
+    term->imp_num = term->num;
+    term->imp_dirty = false;
+    term->imp_prior = idx->prior_update;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_term_quant
+ **功    能: 重新量化词项的所有倒排项
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 同时重新计算词项级及块级得分上界, 得分序副本随之失效
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_term_quant(invtd_index_t *idx, invtd_term_t *term)
+{
+    int pos;
+    invtd_posting_t *post;
+
+    for (pos=0; pos<term->num; ++pos) {
+        post = &term->list[pos];
+        post->impact = invtd_index_impact(idx,
+                term->num, post, idx->doc[post->docid].len);
+    }
+
+    term->qdf = term->num;
+    term->max_impact = 0;
+
+    invtd_index_block_rebuild(term, 0);
+
+    if (NULL != term->imp_list) {
+        term->imp_dirty = true;
+        invtd_index_hot_queue(idx, term);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_doc_reserve
+ **功    能: 预留文档所含词项列表的空间
+ **输入参数:
+ **     doc: 文档
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 列表已满时倍增扩容
+ **注意事项: 在新建倒排项之前调用, 保证新建后一定能记入文档的词项列表
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_doc_reserve(invtd_doc_t *doc)
+{
+    int max;
+    uint32_t *terms;
+
+    if (doc->term_num < doc->term_max) {
+        return 0;
+    }
+
+    max = doc->term_max? 2 * doc->term_max : INVTD_INDEX_DOC_TERM_INIT;
+    terms = (uint32_t *)realloc(doc->terms, max * sizeof(uint32_t));
+    if (NULL == terms) {
+        return -1;
+    }
+    doc->terms = terms;
+    doc->term_max = max;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_posting_del
+ **功    能: 删除倒排项
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **     docid: 文档ID
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 后续倒排项及位置列表偏移前移, 位置列表记为废弃, 并重建其后的块级得分上界
+ **     2. 删除位置在得分序副本覆盖的范围内时, 副本失效并放入待重建队列
+ **     3. 词项的文档频率下降超过INVTD_INDEX_DRIFT_RATIO时, 重新量化该词项
+ **注意事项: 调用者须持有写锁; 文档长度由调用者维护
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_posting_del(invtd_index_t *idx, invtd_term_t *term, uint32_t docid)
+{
+    int low = 0, high = term->num, mid, pos;
+
+    while (low < high) {
+        mid = (low + high) >> 1;
+        if (term->list[mid].docid < docid) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low >= term->num || term->list[low].docid != docid) {
+        return;
+    }
+
+    /* > 删除倒排项 */
+    pos = low;
+    if (NULL != term->pos_off) {
+        if (0 != term->pos_off[pos]) {
+            term->pos_dead += invtd_index_pos_len(term->pos_buf + term->pos_off[pos] - 1);
+        }
+        memmove(term->pos_off + pos, term->pos_off + pos + 1, (term->num - pos - 1) * sizeof(uint32_t));
+    }
+    memmove(term->list + pos, term->list + pos + 1, (term->num - pos - 1) * sizeof(invtd_posting_t));
+    --term->num;
+
+    ++idx->update; /* 文档频率变化(前缀树需重建) */
+
+    invtd_index_block_rebuild(term, pos);
+
+    /* > 维护得分序副本 */
+    if (NULL != term->imp_list) {
+        if (0 == term->num) {
+            free(term->imp_list);
+            term->imp_list = NULL;
+            term->imp_num = 0;
+            term->imp_dirty = false;
+        }
+        else if (pos < term->imp_num) {
+            term->imp_dirty = true;
+            invtd_index_hot_queue(idx, term);
+        }
+    }
+
+    /* > 重新量化 */
+    if (term->num < term->qdf * (1 - INVTD_INDEX_DRIFT_RATIO)) {
+        invtd_index_term_quant(idx, term);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_insert
+ **功    能: 插入倒排项
+ **输入参数:
+ **     idx: 索引对象
+ **     word: 关键字
+ **     url: URL
+ **     freq: 词频
+ **     ftf: 各字段词频(共INVTD_FIELD_TOTAL个, 之和为freq. NULL:均计入正文)
+ **     loc: 出现位置(升序, 共freq个. NULL:无位置信息)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 更新倒排项词频、各字段词频及文档长度(重复插入时词频累加), 并记录位置列表
+ **     2. 新建倒排项时将词项记入文档的词项列表
+ **     3. 按当前统计量计算该倒排项的量化得分, 并更新得分上界
+ **     4. 词项的文档频率漂移超过INVTD_INDEX_DRIFT_RATIO时, 重新量化该词项
+ **     5. 热词的得分序副本按需放入待重建队列
+ **注意事项:
+ **     1. 调用者须持有写锁; 集合统计的漂移由invtd_index_merge()统一处理
+ **     2. 重新索引文档时, 须先调用invtd_index_remove()删除旧的倒排项, 否则词频累加
+ **作    者:
+ ******************************************************************************/
+int invtd_index_insert(invtd_index_t *idx, const char *word, const char *url,
+        int freq, const int *ftf, const uint32_t *loc)
+{
+    int docid, pos, blk, field, body[INVTD_FIELD_TOTAL];
+    invtd_doc_t *doc;
+    invtd_term_t *term;
+    invtd_posting_t *post;
+
+    if (freq <= 0) {
+        return -1;
+    }
+
+    docid = invtd_index_doc_get(idx, url);
+    if (docid < 0) {
+        return -1;
+    }
+
+    term = invtd_index_term_get(idx, word);
+    if (NULL == term) {
+        return -1;
+    }
+
+    doc = &idx->doc[docid];
+    if (invtd_index_doc_reserve(doc)) {
+        return -1;
+    }
+
+    post = invtd_index_posting_get(term, docid, idx->position);
+    if (NULL == post) {
+        return -1;
+    }
+
+    if (0 == post->freq) {
+        ++idx->update; /* 新增倒排项 */
+        doc->terms[doc->term_num++] = (uint32_t)(term - idx->term);
+    }
+
+    /* > 记录位置列表 */
+    if (NULL != loc && NULL != term->pos_off) {
+        invtd_index_pos_set(term, post - term->list, loc, MIN(freq, INVTD_INDEX_FREQ_MAX));
+    }
+
+    /* > 更新各字段词频 */
+    if (NULL == ftf) {
+        memset(body, 0, sizeof(body));
+        body[INVTD_FIELD_BODY] = freq;
+        ftf = body;
+    }
+
+    for (field=0; field<INVTD_FIELD_TOTAL; ++field) {
+        post->ftf[field] = MIN(post->ftf[field] + ftf[field], INVTD_INDEX_FIELD_FREQ_MAX);
+    }
+
+    /* > 更新词频及文档长度 */
+    freq = MIN(freq, INVTD_INDEX_FREQ_MAX - post->freq);
+    post->freq += freq;
+
+    doc->len += freq;
+    idx->total_len += freq;
+
+    /* > 计算量化得分 */
+    if (term->num > term->qdf * (1 + INVTD_INDEX_DRIFT_RATIO)) {
+        invtd_index_term_quant(idx, term);
+        return 0;
+    }
+
+    post->impact = invtd_index_impact(idx, term->num, post, doc->len);
+
+    pos = post - term->list;
+    blk = pos / INVTD_INDEX_BLK_SIZE;
+    term->blk_max[blk] = MAX(term->blk_max[blk], post->impact);
+    term->max_impact = MAX(term->max_impact, post->impact);
+
+    /* > 维护得分序副本 */
+    invtd_index_hot_update(idx, term, pos);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_remove
+ **功    能: 删除文档的全部倒排项
+ **输入参数:
+ **     idx: 索引对象
+ **     url: URL
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 按文档的词项列表逐一删除倒排项, 并将文档长度清零
+ **注意事项:
+ **     1. 调用者须持有写锁; 文档不存在时直接返回
+ **     2. 文档ID及静态得分保留(重新索引后沿用), 因此文档数不变
+ **作    者:
+ ******************************************************************************/
+int invtd_index_remove(invtd_index_t *idx, const char *url)
+{
+    int i;
+    uint32_t *slot, docid;
+    invtd_doc_t *doc;
+
+    slot = invtd_index_hash_probe(idx, &idx->doc_hash, invtd_index_doc_key, url);
+    if (0 == *slot) {
+        return 0;
+    }
+
+    docid = *slot - 1;
+    doc = &idx->doc[docid];
+
+    for (i=0; i<doc->term_num; ++i) {
+        invtd_index_posting_del(idx, &idx->term[doc->terms[i]], docid);
+    }
+    doc->term_num = 0;
+
+    idx->total_len -= doc->len;
+    doc->len = 0;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_requant
+ **功    能: 按集合统计重新量化
+ **输入参数:
+ **     idx: 索引对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 文档数或平均文档长度较最近一次全量量化漂移超过INVTD_INDEX_DRIFT_RATIO
+ **     时, 重新量化所有倒排项. 统计量按比例漂移才触发, 全量量化的均摊代价为常数.
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_requant(invtd_index_t *idx)
+{
+    int termid;
+    double avgdl;
+
+    if (0 == idx->doc_num) {
+        return;
+    }
+
+    avgdl = (double)idx->total_len / idx->doc_num;
+    if (idx->doc_num <= idx->quant.doc_num * (1 + INVTD_INDEX_DRIFT_RATIO)
+        && fabs(avgdl - idx->quant.avgdl) <= idx->quant.avgdl * INVTD_INDEX_DRIFT_RATIO)
+    {
+        return;
+    }
+
+    for (termid=0; termid<idx->term_num; ++termid) {
+        invtd_index_term_quant(idx, &idx->term[termid]);
+    }
+
+    idx->quant.doc_num = idx->doc_num;
+    idx->quant.avgdl = avgdl;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_prior_set
+ **功    能: 设置文档的静态得分
+ **输入参数:
+ **     idx: 索引对象
+ **     url: URL
+ **     score: 静态得分(0~1, 如PageRank、站点质量等)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 按权重量化至与量化得分相同的尺度(满分时相当于BM25得分prior),
+ **     查询时每个命中文档只累加一次
+ **注意事项:
+ **     1. 调用者须持有写锁; 文档不存在时新建(可先设置静态得分再索引)
+ **     2. 静态得分上界只增不减, 上界偏大只影响剪枝效率, 不影响正确性
+ **作    者:
+ ******************************************************************************/
+int invtd_index_prior_set(invtd_index_t *idx, const char *url, double score)
+{
+    int docid;
+    double prior;
+    invtd_doc_t *doc;
+
+    docid = invtd_index_doc_get(idx, url);
+    if (docid < 0) {
+        return -1;
+    }
+
+    doc = &idx->doc[docid];
+
+    prior = MIN(MAX(score, 0.0), 1.0) * idx->prior * INVTD_INDEX_IMPACT_SCALE + 0.5;
+    prior = MIN(prior, INVTD_INDEX_IMPACT_MAX);
+    if ((uint16_t)prior != doc->prior) {
+        doc->prior = (uint16_t)prior;
+        ++idx->prior_update;
+    }
+
+    idx->prior_max = MAX(idx->prior_max, doc->prior);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_merge
+ **功    能: 合并处理
+ **输入参数:
+ **     idx: 索引对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 集合统计漂移时, 全量重新量化
+ **     2. 开启prior_order且静态得分有变化时, 各热词的得分序副本放入待重建队列
+ **     3. 重建待重建队列中热词的得分序副本
+ **注意事项: 调用者须持有写锁(由插入线程在每批插入后调用)
+ **作    者:
+ ******************************************************************************/
+void invtd_index_merge(invtd_index_t *idx)
+{
+    int i;
+    invtd_term_t *term;
+
+    invtd_index_requant(idx);
+
+    if (idx->prior_order && idx->prior_merge != idx->prior_update) {
+        for (i=0; i<idx->term_num; ++i) {
+            term = &idx->term[i];
+            if (NULL != term->imp_list && term->imp_prior != idx->prior_update) {
+                invtd_index_hot_queue(idx, term);
+            }
+        }
+        idx->prior_merge = idx->prior_update;
+    }
+
+    for (i=0; i<idx->hot_num; ++i) {
+        invtd_index_hot_rebuild(idx, &idx->term[idx->hot[i]]);
+    }
+    idx->hot_num = 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_heap_down
+ **功    能: 替换堆顶并下沉
+ **输入参数:
+ **     heap: 结果堆(小根堆)
+ **     num: 堆中结果数
+ **     hit: 新的堆顶
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_heap_down(invtd_hit_t *heap, int num, const invtd_hit_t *hit)
+{
+    int pos, child;
+
+    for (pos=0; (child = 2*pos + 1) < num; pos=child) {
+        if (child + 1 < num && heap[child+1].score < heap[child].score) {
+            ++child;
+        }
+        if (heap[child].score >= hit->score) {
+            break;
+        }
+        heap[pos] = heap[child];
+    }
+    heap[pos] = *hit;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_heap_push
+ **功    能: 放入结果堆
+ **输入参数:
+ **     heap: 结果堆(小根堆, 堆顶为当前第K名)
+ **     num: 堆中结果数
+ **     topk: 堆容量
+ **     hit: 命中结果
+ **输出参数: NONE
+ **返    回: 堆中结果数
+ **实现描述: 堆未满时上浮放入; 堆已满且得分高于堆顶时替换堆顶
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_heap_push(invtd_hit_t *heap, int num, int topk, const invtd_hit_t *hit)
+{
+    int pos;
+
+    if (num < topk) {
+        for (pos=num; pos>0 && heap[(pos-1)>>1].score > hit->score; pos=(pos-1)>>1) {
+            heap[pos] = heap[(pos-1)>>1];
+        }
+        heap[pos] = *hit;
+        return num + 1;
+    }
+    else if (hit->score > heap[0].score) {
+        invtd_index_heap_down(heap, num, hit);
+    }
+
+    return num;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_heap_sort
+ **功    能: 结果堆排序
+ **输入参数:
+ **     heap: 结果堆
+ **     num: 堆中结果数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 依次将堆顶(最小值)移至末尾, 完成后按得分降序排列
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_heap_sort(invtd_hit_t *heap, int num)
+{
+    invtd_hit_t last;
+
+    while (num > 1) {
+        last = heap[--num];
+        heap[num] = heap[0];
+        invtd_index_heap_down(heap, num, &last);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_query_hot
+ **功    能: 单词项查询(按得分序副本)
+ **输入参数:
+ **     idx: 索引对象
+ **     term: 词项
+ **     topk: 最多返回的结果数
+ **输出参数:
+ **     hit: 命中结果(按得分降序)
+ **返    回: 命中结果数
+ **实现描述:
+ **     1. 按副本次序取倒排项, 结果堆已满且剩余倒排项的得分上界不超过第K名时结束:
+ **        副本按量化得分排列时, 上界为当前量化得分 + 静态得分上界;
+ **        副本按(量化得分 + 静态得分)排列时, 上界即当前倒排项的最终得分
+ **     2. 副本建立后又追加了倒排项时, 逐一放入结果堆
+ **     未设置静态得分时, 取满topk个即结束, 代价为O(K)
+ **注意事项: 副本未失效时才能调用(按量化得分 + 静态得分排列时, 静态得分须未变化)
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_query_hot(const invtd_index_t *idx,
+        const invtd_term_t *term, int topk, invtd_hit_t *hit)
+{
+    int pos, hnum = 0;
+    uint32_t prior;
+    invtd_hit_t curr;
+    const invtd_posting_t *post;
+
+    for (pos=0; pos<term->imp_num; ++pos) {
+        post = &term->imp_list[pos];
+        prior = idx->doc[post->docid].prior;
+        if (hnum >= topk
+            && (uint32_t)post->impact + (idx->prior_order? prior : idx->prior_max) <= hit[0].score)
+        {
+            break;
+        }
+        curr.docid = post->docid;
+        curr.score = post->impact + prior;
+        curr.freq = post->freq;
+        hnum = invtd_index_heap_push(hit, hnum, topk, &curr);
+    }
+
+    for (pos=term->imp_num; pos<term->num; ++pos) {
+        post = &term->list[pos];
+        curr.docid = post->docid;
+        curr.score = post->impact + idx->doc[post->docid].prior;
+        curr.freq = post->freq;
+        hnum = invtd_index_heap_push(hit, hnum, topk, &curr);
+    }
+
+    invtd_index_heap_sort(hit, hnum);
+
+    return hnum;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_seek
+ **功    能: 游标跳转
+ **输入参数:
+ **     term: 词项
+ **     pos: 当前倒排项下标
+ **     docid: 目标文档ID
+ **输出参数: NONE
+ **返    回: 第一个docid不小于目标文档ID的倒排项下标(不存在时为term->num)
+ **实现描述: 先倍增步长定位区间, 再二分查找, 跳转距离较短时代价很小
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_index_seek(const invtd_term_t *term, int pos, uint32_t docid)
+{
+    int step = 1, high, mid;
+
+    if (pos >= term->num || term->list[pos].docid >= docid) {
+        return pos;
+    }
+
+    /* > 倍增定位: list[pos] < docid <= list[high] */
+    while (pos + step < term->num && term->list[pos + step].docid < docid) {
+        pos += step;
+        step <<= 1;
+    }
+    high = MIN(pos + step, term->num);
+
+    /* > 二分查找 */
+    ++pos;
+    while (pos < high) {
+        mid = (pos + high) >> 1;
+        if (term->list[mid].docid < docid) {
+            pos = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return pos;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_cursor_sort
+ **功    能: 游标按当前文档ID升序排列
+ **输入参数:
+ **     cursor: 游标列表
+ **     num: 游标个数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 插入排序(游标数很少, 且每轮只有少数游标移动)
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_cursor_sort(invtd_index_cursor_t *cursor, int num)
+{
+    int i, k;
+    uint32_t docid;
+    invtd_index_cursor_t tmp;
+
+    for (i=1; i<num; ++i) {
+        tmp = cursor[i];
+        docid = INVTD_INDEX_CURSOR_DOCID(&tmp);
+        for (k=i; k>0 && INVTD_INDEX_CURSOR_DOCID(&cursor[k-1]) > docid; --k) {
+            cursor[k] = cursor[k-1];
+        }
+        cursor[k] = tmp;
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_query
+ **功    能: 多词项查询
+ **输入参数:
+ **     idx: 索引对象
+ **     words: 关键字列表
+ **     num: 关键字个数
+ **     topk: 最多返回的结果数
+ **     stop: 终止检查回调(可为NULL)
+ **     args: 回调参数
+ **输出参数:
+ **     hit: 命中结果(按得分降序, 至少可容纳topk个)
+ **返    回: 命中结果数(-1:被终止)
+ **实现描述: OR语义, 以Block-Max WAND求得分最高的topk个文档:
+ **     1. 游标按当前docid排序, 依次累加词项得分上界, 首次超过阈值(当前第K名
+ **        得分)的游标所指文档为枢轴; 找不到枢轴时, 剩余文档均不可能进入前K
+ **     2. 枢轴之前的游标跳转至枢轴文档
+ **     3. 位于枢轴文档的各游标所在块的得分上界之和仍不超过阈值时, 这些块中
+ **        不小于枢轴的文档均不可能进入前K, 直接跳过至块尾之后
+ **     4. 否则对枢轴文档完整评分(含静态得分), 并以小根堆保留得分最高的topk个文档
+ **     各上界均计入静态得分上界. 单词项且为热词时, 从得分序副本中提前结束
+ **注意事项: 调用者须持有读锁; 重复的关键字只计一次
+ **作    者:
+ ******************************************************************************/
+int invtd_index_query(invtd_index_t *idx, char **words, int num, int topk,
+        invtd_hit_t *hit, invtd_index_stop_cb_t stop, void *args)
+{
+    invtd_hit_t curr;
+    invtd_term_t *term;
+    invtd_posting_t *post;
+    uint32_t docid, next, bound, threshold;
+    invtd_index_cursor_t cursor[INVTD_INDEX_TERM_MAX];
+    int i, k, p, blk, n = 0, hnum = 0, count = 0;
+
+    /* > 查找词项 */
+    for (i=0; i<num && n<INVTD_INDEX_TERM_MAX; ++i) {
+        term = invtd_index_term_find(idx, words[i]);
+        if (NULL == term || 0 == term->num) {
+            continue;
+        }
+        for (k=0; k<n && cursor[k].term!=term; ++k) ;
+        if (k < n) {
+            continue; /* 重复的关键字 */
+        }
+        cursor[n].term = term;
+        cursor[n++].pos = 0;
+    }
+
+    if (0 == n || topk <= 0) {
+        return 0;
+    }
+    else if (1 == n
+        && NULL != cursor[0].term->imp_list
+        && !cursor[0].term->imp_dirty
+        && (!idx->prior_order || cursor[0].term->imp_prior == idx->prior_update))
+    {
+        return invtd_index_query_hot(idx, cursor[0].term, topk, hit);
+    }
+
+    while (1) {
+        if (NULL != stop
+            && 0 == (++count % INVTD_INDEX_CHECK_NUM)
+            && stop(args))
+        {
+            return -1;
+        }
+
+        invtd_index_cursor_sort(cursor, n);
+
+        /* > 查找枢轴 */
+        threshold = (hnum < topk)? 0 : hit[0].score;
+        for (bound=idx->prior_max, p=0; p<n; ++p) {
+            if (UINT32_MAX == INVTD_INDEX_CURSOR_DOCID(&cursor[p])) {
+                p = n;
+                break;
+            }
+            bound += cursor[p].term->max_impact;
+            if (bound > threshold) {
+                break;
+            }
+        }
+
+        if (p >= n) {
+            break; /* 剩余文档均不可能进入前K */
+        }
+
+        docid = INVTD_INDEX_CURSOR_DOCID(&cursor[p]);
+
+        /* > 枢轴之前的游标跳转至枢轴文档 */
+        if (INVTD_INDEX_CURSOR_DOCID(&cursor[0]) != docid) {
+            for (i=0; i<p; ++i) {
+                cursor[i].pos = invtd_index_seek(cursor[i].term, cursor[i].pos, docid);
+            }
+            continue;
+        }
+
+        /* > 块级上界检查 */
+        next = UINT32_MAX;
+        for (bound=idx->prior_max, k=0; k<n && INVTD_INDEX_CURSOR_DOCID(&cursor[k]) == docid; ++k) {
+            term = cursor[k].term;
+            blk = cursor[k].pos / INVTD_INDEX_BLK_SIZE;
+            bound += term->blk_max[blk];
+            next = MIN(next, term->list[MIN((blk + 1) * INVTD_INDEX_BLK_SIZE, term->num) - 1].docid);
+        }
+
+        if (bound <= threshold) {
+            next += 1;
+            if (k < n) {
+                next = MIN(next, INVTD_INDEX_CURSOR_DOCID(&cursor[k]));
+            }
+            for (i=0; i<k; ++i) {
+                cursor[i].pos = invtd_index_seek(cursor[i].term, cursor[i].pos, next);
+            }
+            continue;
+        }
+
+        /* > 完整评分 */
+        curr.docid = docid;
+        curr.score = idx->doc[docid].prior;
+        curr.freq = 0;
+        for (i=0; i<k; ++i) {
+            post = &cursor[i].term->list[cursor[i].pos++];
+            curr.score += post->impact;
+            curr.freq += post->freq;
+        }
+
+        hnum = invtd_index_heap_push(hit, hnum, topk, &curr);
+    }
+
+    invtd_index_heap_sort(hit, hnum);
+
+    return hnum;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_pos_next
+ **功    能: 位置迭代器前进
+ **输入参数:
+ **     iter: 位置迭代器
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 累加下一个位置差值, 已遍历完时当前位置置为UINT32_MAX
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_pos_next(invtd_index_pos_iter_t *iter)
+{
+    uint32_t delta;
+
+    if (0 == iter->left) {
+        iter->pos = UINT32_MAX;
+        return;
+    }
+
+    iter->ptr = invtd_index_varint_get(iter->ptr, &delta);
+    iter->pos += delta;
+    --iter->left;
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_pos_init
+ **功    能: 初始化位置迭代器
+ **输入参数:
+ **     term: 词项
+ **     idx: 倒排项下标
+ **输出参数:
+ **     iter: 位置迭代器(指向首个位置)
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 倒排项须有位置信息
+ **作    者:
+ ******************************************************************************/
+static void invtd_index_pos_init(const invtd_term_t *term, int idx, invtd_index_pos_iter_t *iter)
+{
+    iter->ptr = invtd_index_varint_get(term->pos_buf + term->pos_off[idx] - 1, &iter->left);
+    iter->pos = 0;
+
+    invtd_index_pos_next(iter);
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_phrase_match
+ **功    能: 校验候选文档的词项位置
+ **输入参数:
+ **     cursor: 短语词项游标(均指向同一候选文档, 按短语中的顺序排列)
+ **     num: 短语词项数
+ **     slop: 邻近距离(0:精确短语)
+ **输出参数: NONE
+ **返    回: true:匹配 false:不匹配
+ **实现描述:
+ **     1. 精确短语: 存在首词位置p, 使第i个词出现在位置p+i
+ **     2. 邻近查询: 各词各取一个位置, 跨度不超过num-1+slop(不要求顺序);
+ **        每次推进当前位置最小的迭代器, 求最小跨度窗口
+ **     各位置列表均为升序, 迭代器只前进不后退, 代价与位置数成线性
+ **注意事项: 任一倒排项无位置信息时无法校验, 按匹配处理(退化为AND语义)
+ **作    者:
+ ******************************************************************************/
+static bool invtd_index_phrase_match(const invtd_index_cursor_t *cursor, int num, int slop)
+{
+    int i, min;
+    uint32_t target, low, high;
+    const invtd_term_t *term;
+    invtd_index_pos_iter_t iter[INVTD_INDEX_TERM_MAX];
+
+    for (i=0; i<num; ++i) {
+        term = cursor[i].term;
+        if (NULL == term->pos_off || 0 == term->pos_off[cursor[i].pos]) {
+            return true;
+        }
+        invtd_index_pos_init(term, cursor[i].pos, &iter[i]);
+    }
+
+    /* > 精确短语 */
+    if (0 == slop) {
+        for (; UINT32_MAX != iter[0].pos; invtd_index_pos_next(&iter[0])) {
+            for (i=1; i<num; ++i) {
+                target = iter[0].pos + i;
+                while (iter[i].pos < target) {
+                    invtd_index_pos_next(&iter[i]);
+                }
+                if (iter[i].pos != target) {
+                    break;
+                }
+            }
+
+            if (i >= num) {
+                return true;
+            }
+            else if (UINT32_MAX == iter[i].pos) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /* > 邻近查询 */
+    while (1) {
+        low = UINT32_MAX;
+        high = 0;
+        for (min=0, i=0; i<num; ++i) {
+            if (iter[i].pos < low) {
+                low = iter[i].pos;
+                min = i;
+            }
+            high = MAX(high, iter[i].pos);
+        }
+
+        if (UINT32_MAX == high) {
+            return false;
+        }
+        else if (high - low <= (uint32_t)(num - 1 + slop)) {
+            return true;
+        }
+
+        invtd_index_pos_next(&iter[min]);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_index_phrase
+ **功    能: 短语及邻近查询
+ **输入参数:
+ **     idx: 索引对象
+ **     words: 关键字列表(前phrase个为短语, 按短语中的顺序排列)
+ **     num: 关键字个数
+ **     phrase: 短语关键字个数
+ **     slop: 邻近距离(0:精确短语 >0:各词出现在跨度不超过phrase-1+slop的窗口内)
+ **     topk: 最多返回的结果数
+ **     stop: 终止检查回调(可为NULL)
+ **     args: 回调参数
+ **输出参数:
+ **     hit: 命中结果(按得分降序, 至少可容纳topk个)
+ **返    回: 命中结果数(-1:被终止)
+ **实现描述:
+ **     1. 以文档频率最小的短语词项为主游标, 其余短语词项游标跳转至主游标文档,
+ **        不一致时主游标跳转至其后的文档, 直至按docid求得交集
+ **     2. 只为交集中的候选文档解码位置并校验, 非短语查询不访问位置流
+ **     3. 匹配的文档以短语词项及其他关键字(命中时)的量化得分与静态得分之和评分
+ **注意事项: 调用者须持有读锁; 短语中重复的词项只计一次得分
+ **作    者:
+ ******************************************************************************/
+int invtd_index_phrase(invtd_index_t *idx, char **words, int num, int phrase, int slop,
+        int topk, invtd_hit_t *hit, invtd_index_stop_cb_t stop, void *args)
+{
+    uint32_t docid, next;
+    invtd_hit_t curr;
+    invtd_term_t *term;
+    invtd_posting_t *post;
+    invtd_index_cursor_t *lead;
+    invtd_index_cursor_t cursor[INVTD_INDEX_TERM_MAX];
+    int i, k, n, hnum = 0, count = 0;
+
+    phrase = MIN(phrase, INVTD_INDEX_TERM_MAX);
+    if (phrase <= 0 || topk <= 0) {
+        return 0;
+    }
+
+    /* > 查找短语词项(任一词项不存在时无结果) */
+    lead = &cursor[0];
+    for (i=0; i<phrase; ++i) {
+        term = invtd_index_term_find(idx, words[i]);
+        if (NULL == term || 0 == term->num) {
+            return 0;
+        }
+        cursor[i].term = term;
+        cursor[i].pos = 0;
+        if (term->num < lead->term->num) {
+            lead = &cursor[i];
+        }
+    }
+
+    /* > 查找其他关键字(只参与评分) */
+    for (n=phrase; i<num && n<INVTD_INDEX_TERM_MAX; ++i) {
+        term = invtd_index_term_find(idx, words[i]);
+        if (NULL == term || 0 == term->num) {
+            continue;
+        }
+        for (k=0; k<n && cursor[k].term!=term; ++k) ;
+        if (k < n) {
+            continue; /* 重复的关键字 */
+        }
+        cursor[n].term = term;
+        cursor[n++].pos = 0;
+    }
+
+    while (lead->pos < lead->term->num) {
+        if (NULL != stop
+            && 0 == (++count % INVTD_INDEX_CHECK_NUM)
+            && stop(args))
+        {
+            return -1;
+        }
+
+        docid = lead->term->list[lead->pos].docid;
+
+        /* > 按docid求交 */
+        for (next=docid, i=0; i<phrase; ++i) {
+            cursor[i].pos = invtd_index_seek(cursor[i].term, cursor[i].pos, docid);
+            next = INVTD_INDEX_CURSOR_DOCID(&cursor[i]);
+            if (next != docid) {
+                break;
+            }
+        }
+
+        if (UINT32_MAX == next) {
+            break;
+        }
+        else if (next != docid) {
+            lead->pos = invtd_index_seek(lead->term, lead->pos, next);
+            continue;
+        }
+
+        /* > 校验位置 */
+        if (!invtd_index_phrase_match(cursor, phrase, slop)) {
+            ++lead->pos;
+            continue;
+        }
+
+        /* > 评分 */
+        curr.docid = docid;
+        curr.score = idx->doc[docid].prior;
+        curr.freq = 0;
+        for (i=0; i<n; ++i) {
+            if (i < phrase) {
+                for (k=0; k<i && cursor[k].term!=cursor[i].term; ++k) ;
+                if (k < i) {
+                    continue; /* 重复的词项 */
+                }
+            }
+            else {
+                cursor[i].pos = invtd_index_seek(cursor[i].term, cursor[i].pos, docid);
+                if (INVTD_INDEX_CURSOR_DOCID(&cursor[i]) != docid) {
+                    continue;
+                }
+            }
+            post = &cursor[i].term->list[cursor[i].pos];
+            curr.score += post->impact;
+            curr.freq += post->freq;
+        }
+
+        hnum = invtd_index_heap_push(hit, hnum, topk, &curr);
+
+        ++lead->pos;
+    }
+
+    invtd_index_heap_sort(hit, hnum);
+
+    return hnum;
+}
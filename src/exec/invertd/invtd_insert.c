@@ -0,0 +1,404 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_insert.c
+ ** 版本号: 1.0
+ ** 描  述: 插入关键字(低优先级)
+ **         工作线程只将插入请求(关键字或已分词的文档)放入插入队列, 由插入线程批量写入倒排表:
+ **         每批加一次写锁, 批间释放锁并让出CPU, 使搜索请求(读锁)能及时穿插执行.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invertd.h"
+#include "invtd_mesg.h"
+
+static void *invtd_insert_routine(void *_ctx);
+
+/******************************************************************************
+ **函数名称: invtd_insert_queue_creat
+ **功    能: 创建插入队列
+ **输入参数:
+ **     max: 队列容量
+ **     batch: 单次加写锁最多插入的个数
+ **输出参数: NONE
+ **返    回: 插入队列
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+invtd_insert_queue_t *invtd_insert_queue_creat(int max, int batch)
+{
+    invtd_insert_queue_t *queue;
+
+    queue = (invtd_insert_queue_t *)calloc(1, sizeof(invtd_insert_queue_t));
+    if (NULL == queue) {
+        return NULL;
+    }
+
+    queue->max = max;
+    queue->batch = batch;
+
+    queue->ring = (invtd_insert_item_t *)calloc(max, sizeof(invtd_insert_item_t));
+    if (NULL == queue->ring) {
+        free(queue);
+        return NULL;
+    }
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+
+    return queue;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_launch
+ **功    能: 启动插入线程
+ **输入参数:
+ **     ctx: 全局对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+int invtd_insert_launch(invtd_cntx_t *ctx)
+{
+    if (pthread_create(&ctx->insertq->tid, NULL, invtd_insert_routine, (void *)ctx)) {
+        log_error(ctx->log, "Create insert thread failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return INVT_ERR;
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_word_rsp
+ **功    能: 发送插入关键字应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     item: 插入请求
+ **     code: 应答码
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 源节点ID(orig)将成为应答消息的目的节点ID(dest)
+ **作    者: # Qifeng.zou # 2015-06-17 21:37:55 #
+ ******************************************************************************/
+static int invtd_insert_word_rsp(invtd_cntx_t *ctx, const invtd_insert_item_t *item, int code)
+{
+    mesg_insert_word_rsp_t *rsp;
+    mesg_header_t *rsp_head;
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_insert_word_rsp_t)];
+
+    rsp_head = (mesg_header_t *)addr;
+    rsp = (mesg_insert_word_rsp_t *)(rsp_head + 1);
+
+    /* > 设置应答信息 */
+    rsp->code = code;
+    snprintf(rsp->word, sizeof(rsp->word), "%s", item->req.word);
+
+    MESG_HEAD_SET(rsp_head, MSG_INSERT_WORD_RSP, item->sid,
+            item->nid, item->serial, sizeof(mesg_insert_word_rsp_t));
+    MESG_HEAD_HTON(rsp_head, rsp_head);
+    mesg_insert_word_resp_hton(rsp);
+
+    /* > 发送应答信息 */
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_INSERT_WORD_RSP, (void *)addr, sizeof(addr))) {
+        log_error(ctx->log, "Send response failed! serial:%lu word:%s url:%s freq:%d",
+                item->serial, item->req.word, item->req.url, item->req.freq);
+        return INVT_ERR;
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_word_req_hdl
+ **功    能: 插入关键字的处理
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源节点ID
+ **     buff: 插入关键字-请求数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 关键字规范化(全角转半角、转小写)后放入插入队列并立即返回, 由插入
+ **     线程写入倒排表并发送应答
+ **注意事项: 插入队列已满时直接应答失败, 由上游择机重试
+ **作    者: # Qifeng.zou # 2015-06-17 21:37:55 #
+ ******************************************************************************/
+int invtd_insert_word_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    invtd_insert_item_t item;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+    mesg_insert_word_req_t *req = (mesg_insert_word_req_t *)(head + 1); /* 请求 */
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_insert_word_req_t))) {
+        log_error(ctx->log, "Insert request is too short! len:%lu", len);
+        return INVT_ERR;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+    req->freq = ntohl(req->freq);
+
+    memset(&item, 0, sizeof(item));
+
+    item.type = MSG_INSERT_WORD_REQ;
+    item.sid = head->sid;
+    item.nid = head->nid;
+    item.serial = head->serial;
+    memcpy(&item.req, req, sizeof(item.req));
+    item.req.word[sizeof(item.req.word) - 1] = '\0';
+    item.req.url[sizeof(item.req.url) - 1] = '\0';
+    invtd_token_normalize(item.req.word, item.req.word, sizeof(item.req.word)); /* 与查询词一致 */
+
+    /* > 放入插入队列 */
+    if (invtd_insert_push(ctx, &item)) {
+        log_error(ctx->log, "Insert queue is full! serial:%lu word:%s url:%s freq:%d",
+                head->serial, item.req.word, item.req.url, item.req.freq);
+        invtd_insert_word_rsp(ctx, &item, MESG_INSERT_WORD_FAIL);
+        return INVT_OK;
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_push
+ **功    能: 放入插入队列
+ **输入参数:
+ **     ctx: 全局对象
+ **     item: 插入请求
+ **输出参数: NONE
+ **返    回: 0:成功 !0:队列已满
+ **实现描述: 拷贝至队尾, 队列由空变为非空时唤醒插入线程
+ **注意事项: 入队成功后, 待索引文档(item->doc)由插入线程释放
+ **作    者:
+ ******************************************************************************/
+int invtd_insert_push(invtd_cntx_t *ctx, const invtd_insert_item_t *item)
+{
+    invtd_insert_queue_t *queue = ctx->insertq;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->num >= queue->max) {
+        pthread_mutex_unlock(&queue->lock);
+        return INVT_ERR;
+    }
+
+    memcpy(&queue->ring[(queue->head + queue->num) % queue->max], item, sizeof(invtd_insert_item_t));
+
+    if (0 == queue->num++) {
+        pthread_cond_signal(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_doc
+ **功    能: 写入待索引文档的全部倒排项
+ **输入参数:
+ **     ctx: 全局对象
+ **     doc: 待索引文档
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 先删除该URL已有的倒排项(重新索引时以新内容为准), 再逐一写入评分索引
+ **     (含各字段词频及位置列表)
+ **注意事项: 调用者须持有写锁
+ **作    者:
+ ******************************************************************************/
+static int invtd_insert_doc(invtd_cntx_t *ctx, const invtd_doc_terms_t *doc)
+{
+    int idx;
+    const invtd_doc_term_t *term;
+
+    invtd_index_remove(ctx->index, doc->url);
+
+    for (idx=0; idx<doc->num; ++idx) {
+        term = &doc->term[idx];
+        if (invtd_index_insert(ctx->index, term->word,
+                doc->url, term->freq, term->ftf, term->pos))
+        {
+            log_error(ctx->log, "Insert document term failed! url:%s word:%s freq:%d",
+                    doc->url, term->word, term->freq);
+            return INVT_ERR;
+        }
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_trie_wait
+ **功    能: 计算前缀树距可重建的等待时长
+ **输入参数:
+ **     ctx: 全局对象
+ **     now: 当前时间(秒)
+ **输出参数: NONE
+ **返    回: 等待时长(秒, 0:可立即重建 <0:无需重建)
+ **实现描述: 词典有新增倒排项时需重建, 且两次重建至少间隔INVTD_TRIE_REBUILD_INTV
+ **注意事项: 索引只在插入线程中修改, 因此读取更新序号无需加锁
+ **作    者:
+ ******************************************************************************/
+static int invtd_insert_trie_wait(invtd_cntx_t *ctx, time_t now)
+{
+    invtd_trie_t *trie = ctx->trie;
+
+    if (NULL == trie) {
+        return (0 == ctx->index->term_num)? -1 : 0;
+    }
+    else if (trie->update == ctx->index->update) {
+        return -1;
+    }
+
+    return MAX(0, (int)(trie->ctm + INVTD_TRIE_REBUILD_INTV - now));
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_trie_rebuild
+ **功    能: 重建前缀树
+ **输入参数:
+ **     ctx: 全局对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 持读锁构建新的前缀树(不阻塞搜索请求), 再持写锁替换
+ **注意事项: 只在插入线程中调用, 构建期间索引不会被修改
+ **作    者:
+ ******************************************************************************/
+static void invtd_insert_trie_rebuild(invtd_cntx_t *ctx)
+{
+    invtd_trie_t *trie, *old;
+
+    if (0 != invtd_insert_trie_wait(ctx, time(NULL))) {
+        return;
+    }
+
+    pthread_rwlock_rdlock(&ctx->invtab_lock);
+    trie = invtd_trie_build(ctx->index);
+    pthread_rwlock_unlock(&ctx->invtab_lock);
+    if (NULL == trie) {
+        log_error(ctx->log, "Build trie failed! term:%d", ctx->index->term_num);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&ctx->invtab_lock);
+    old = ctx->trie;
+    ctx->trie = trie;
+    pthread_rwlock_unlock(&ctx->invtab_lock);
+
+    invtd_trie_destroy(old);
+
+    log_debug(ctx->log, "Rebuild trie success! term:%u node:%u",
+            trie->term_num, trie->node_num);
+}
+
+/******************************************************************************
+ **函数名称: invtd_insert_routine
+ **功    能: 插入线程
+ **输入参数:
+ **     _ctx: 全局对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 从插入队列中取出至多batch个请求
+ **     2. 加一次写锁批量写入评分索引(文档索引请求一次写入其全部词项),
+ **        并按需重新量化得分
+ **     3. 释放写锁后逐一发送应答, 并让出CPU
+ **     4. 词典有变化时, 按间隔重建前缀树(队列空闲时定时唤醒, 保证最后一批插入可见)
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void *invtd_insert_routine(void *_ctx)
+{
+    int idx, num, wait;
+    struct timespec ts;
+    invtd_insert_item_t *batch;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)_ctx;
+    invtd_insert_queue_t *queue = ctx->insertq;
+
+    pthread_detach(pthread_self());
+
+    batch = (invtd_insert_item_t *)calloc(queue->batch, sizeof(invtd_insert_item_t));
+    if (NULL == batch) {
+        log_fatal(ctx->log, "Alloc memory failed! errmsg:[%d] %s!", errno, strerror(errno));
+        abort();
+    }
+
+    while (1) {
+        /* > 取出请求 */
+        pthread_mutex_lock(&queue->lock);
+        while (0 == queue->num) {
+            wait = invtd_insert_trie_wait(ctx, time(NULL));
+            if (wait < 0) {
+                pthread_cond_wait(&queue->cond, &queue->lock);
+                continue;
+            }
+            else if (wait > 0) {
+                ts.tv_sec = time(NULL) + wait;
+                ts.tv_nsec = 0;
+                pthread_cond_timedwait(&queue->cond, &queue->lock, &ts);
+                continue;
+            }
+            break; /* 需重建前缀树 */
+        }
+
+        for (num=0; num<queue->batch && queue->num > 0; ++num) {
+            memcpy(&batch[num], &queue->ring[queue->head], sizeof(invtd_insert_item_t));
+            queue->head = (queue->head + 1) % queue->max;
+            --queue->num;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        /* > 批量插入评分索引 */
+        pthread_rwlock_wrlock(&ctx->invtab_lock);
+        for (idx=0; idx<num; ++idx) {
+            if (MSG_INDEX_DOC_REQ == batch[idx].type) {
+                batch[idx].code = invtd_insert_doc(ctx, batch[idx].doc)?
+                        MESG_INDEX_DOC_FAIL : MESG_INDEX_DOC_SUCC;
+                continue;
+            }
+            else if (MSG_SET_DOC_SCORE_REQ == batch[idx].type) {
+                batch[idx].code = invtd_index_prior_set(ctx->index, batch[idx].req.url,
+                        (double)batch[idx].score / MESG_DOC_SCORE_MAX)?
+                        MESG_SET_DOC_SCORE_FAIL : MESG_SET_DOC_SCORE_SUCC;
+                continue;
+            }
+            batch[idx].code = invtd_index_insert(ctx->index, batch[idx].req.word,
+                        batch[idx].req.url, batch[idx].req.freq, NULL, NULL)?
+                    MESG_INSERT_WORD_FAIL : MESG_INSERT_WORD_SUCC;
+        }
+        invtd_index_merge(ctx->index); /* 集合统计漂移时重新量化 */
+        pthread_rwlock_unlock(&ctx->invtab_lock);
+
+        /* > 重建前缀树 */
+        invtd_insert_trie_rebuild(ctx);
+
+        /* > 发送应答 */
+        for (idx=0; idx<num; ++idx) {
+            if (MSG_INDEX_DOC_REQ == batch[idx].type) {
+                invtd_doc_rsp(ctx, &batch[idx], batch[idx].code);
+                invtd_doc_free(batch[idx].doc);
+                continue;
+            }
+            else if (MSG_SET_DOC_SCORE_REQ == batch[idx].type) {
+                invtd_score_rsp(ctx, &batch[idx], batch[idx].code);
+                continue;
+            }
+            if (MESG_INSERT_WORD_FAIL == batch[idx].code) {
+                log_error(ctx->log, "Insert invert table failed! serial:%lu word:%s url:%s freq:%d",
+                        batch[idx].serial, batch[idx].req.word, batch[idx].req.url, batch[idx].req.freq);
+            }
+            invtd_insert_word_rsp(ctx, &batch[idx], batch[idx].code);
+        }
+
+        sched_yield();
+    }
+
+    free(batch);
+
+    return (void *)-1;
+}
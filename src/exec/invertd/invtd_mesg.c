@@ -13,6 +13,8 @@
 #include "rtmq_recv.h"
 #include "invtd_mesg.h"
 
+#define INVTD_PRINT_POSTING_MAX     (16)    /* 打印倒排表时每个词项最多打印的倒排项数 */
+
 /******************************************************************************
  **函数名称: invtd_print_invt_tab_req_hdl
  **功    能: 处理打印倒排表的请求
@@ -24,12 +26,73 @@
  **     args: 附加参数
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
- **注意事项: 
+ **实现描述: 持读锁遍历评分索引的词典, 将各词项的文档频率及倒排项打印到日志
+ **注意事项: 每个词项最多打印INVTD_PRINT_POSTING_MAX个倒排项, 以免长时间阻塞插入线程
  **作    者: # Qifeng.zou # 2015.05.08 #
  ******************************************************************************/
 static int invtd_print_invt_tab_req_hdl(int type, int orig, char *buff, size_t len, void *args)
 {
+    int idx, k, num;
+    const invtd_term_t *term;
+    const invtd_posting_t *post;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    invtd_index_t *index = ctx->index;
+
+    pthread_rwlock_rdlock(&ctx->invtab_lock);
+
+    log_info(ctx->log, "Print invert table! orig:%d doc:%d term:%d",
+            orig, index->doc_num, index->term_num);
+
+    for (idx=0; idx<index->term_num; ++idx) {
+        term = &index->term[idx];
+
+        log_info(ctx->log, "word:%s df:%d", term->word, term->num);
+
+        num = MIN(term->num, INVTD_PRINT_POSTING_MAX);
+        for (k=0; k<num; ++k) {
+            post = &term->list[k];
+            log_info(ctx->log, "    url:%s freq:%u impact:%u",
+                    invtd_index_doc_url(index, post->docid), post->freq, post->impact);
+        }
+    }
+
+    pthread_rwlock_unlock(&ctx->invtab_lock);
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_ping_req_hdl
+ **功    能: 处理探测请求
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源设备ID
+ **     buff: 探测请求的数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 将报头类型改为MSG_PONG后原样返回(流水号用于转发层匹配探测)
+ **注意事项: 报头保持网络字节序, 无需转换
+ **作    者:
+ ******************************************************************************/
+static int invtd_ping_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+
+    if (len < sizeof(mesg_header_t)) {
+        return INVT_ERR;
+    }
+
+    head->type = htonl(MSG_PONG);
+    head->length = 0;
+
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_PONG, (void *)head, sizeof(mesg_header_t))) {
+        log_error(ctx->log, "Send pong failed! orig:%d", orig);
+        return INVT_ERR;
+    }
+
     return INVT_OK;
 }
 
@@ -55,6 +118,11 @@ static int invtd_rtmq_reg(invtd_cntx_t *ctx)
    INVTD_RTMQ_REG(ctx, MSG_SEARCH_REQ, invtd_search_req_hdl, ctx);
    INVTD_RTMQ_REG(ctx, MSG_INSERT_WORD_REQ, invtd_insert_word_req_hdl, ctx);
    INVTD_RTMQ_REG(ctx, MSG_PRINT_INVT_TAB_REQ, invtd_print_invt_tab_req_hdl, ctx);
+   INVTD_RTMQ_REG(ctx, MSG_PING, invtd_ping_req_hdl, ctx);
+   INVTD_RTMQ_REG(ctx, MSG_CANCEL_REQ, invtd_cancel_req_hdl, ctx);
+   INVTD_RTMQ_REG(ctx, MSG_SUGGEST_REQ, invtd_suggest_req_hdl, ctx);
+   INVTD_RTMQ_REG(ctx, MSG_INDEX_DOC_REQ, invtd_index_doc_req_hdl, ctx);
+   INVTD_RTMQ_REG(ctx, MSG_SET_DOC_SCORE_REQ, invtd_set_doc_score_req_hdl, ctx);
 
     return INVT_OK;
 }
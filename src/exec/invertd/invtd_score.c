@@ -0,0 +1,108 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_score.c
+ ** 版本号: 1.0
+ ** 描  述: 文档静态得分
+ **         设置与查询无关的文档得分(如PageRank、站点质量等), 经插入队列由插入
+ **         线程写入评分索引, 查询时与词项得分相加.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invertd.h"
+#include "invtd_mesg.h"
+
+/******************************************************************************
+ **函数名称: invtd_score_rsp
+ **功    能: 发送设置静态得分应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     item: 插入请求
+ **     code: 应答码
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 源节点ID(orig)将成为应答消息的目的节点ID(dest)
+ **作    者:
+ ******************************************************************************/
+int invtd_score_rsp(invtd_cntx_t *ctx, const invtd_insert_item_t *item, int code)
+{
+    mesg_header_t *rsp_head;
+    mesg_set_doc_score_rsp_t *rsp;
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_set_doc_score_rsp_t)];
+
+    rsp_head = (mesg_header_t *)addr;
+    rsp = (mesg_set_doc_score_rsp_t *)(rsp_head + 1);
+
+    /* > 设置应答信息 */
+    rsp->code = code;
+    rsp->score = item->score;
+    snprintf(rsp->url, sizeof(rsp->url), "%s", item->req.url);
+
+    MESG_HEAD_SET(rsp_head, MSG_SET_DOC_SCORE_RSP, item->sid,
+            item->nid, item->serial, sizeof(mesg_set_doc_score_rsp_t));
+    MESG_HEAD_HTON(rsp_head, rsp_head);
+    mesg_set_doc_score_rsp_hton(rsp);
+
+    /* > 发送应答信息 */
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_SET_DOC_SCORE_RSP, (void *)addr, sizeof(addr))) {
+        log_error(ctx->log, "Send response failed! serial:%lu url:%s", item->serial, item->req.url);
+        return INVT_ERR;
+    }
+
+    return INVT_OK;
+}
+
+/******************************************************************************
+ **函数名称: invtd_set_doc_score_req_hdl
+ **功    能: 设置静态得分请求的处理
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源节点ID
+ **     buff: 设置静态得分-请求数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 放入插入队列, 由插入线程持写锁更新(与插入请求保持先后顺序)
+ **注意事项: 静态得分超过MESG_DOC_SCORE_MAX时按MESG_DOC_SCORE_MAX处理
+ **作    者:
+ ******************************************************************************/
+int invtd_set_doc_score_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    invtd_insert_item_t item;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+    mesg_set_doc_score_req_t *req = (mesg_set_doc_score_req_t *)(head + 1); /* 请求 */
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_set_doc_score_req_t))) {
+        log_error(ctx->log, "Set document score request is too short! len:%lu", len);
+        return INVT_ERR;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+    mesg_set_doc_score_req_ntoh(req);
+    req->url[sizeof(req->url) - 1] = '\0';
+
+    memset(&item, 0, sizeof(item));
+
+    item.type = MSG_SET_DOC_SCORE_REQ;
+    item.sid = head->sid;
+    item.nid = head->nid;
+    item.serial = head->serial;
+    item.score = MIN(req->score, MESG_DOC_SCORE_MAX);
+    snprintf(item.req.url, sizeof(item.req.url), "%s", req->url);
+
+    log_debug(ctx->log, "Set document score! serial:%lu url:%s score:%u",
+            head->serial, item.req.url, item.score);
+
+    /* > 放入插入队列 */
+    if (invtd_insert_push(ctx, &item)) {
+        log_error(ctx->log, "Insert queue is full! serial:%lu url:%s", head->serial, item.req.url);
+        invtd_score_rsp(ctx, &item, MESG_SET_DOC_SCORE_FAIL);
+        return INVT_OK;
+    }
+
+    return INVT_OK;
+}
@@ -6,6 +6,8 @@
  ** 描  述: 搜索处理流程
  ** 作  者: # Qifeng.zou # Fri 08 May 2015 10:37:21 PM CST #
  ******************************************************************************/
+#include <zlib.h>
+
 #include "cmd.h"
 #include "search.h"
 #include "invertd.h"
@@ -13,14 +15,42 @@
 #include "rtmq_recv.h"
 
 #define SRCH_SEG_FREQ_LEN           (32)    /* 字段FREQ长度 */
+#define SRCH_SEG_SCORE_LEN          (32)    /* 字段SCORE长度 */
+#define INVTD_DEADLINE_CHECK_NUM    (64)    /* 每处理多少条目检查一次截止时间 */
 
-#define SRCH_CODE_OK                "0000"  /* 返回OK */
-#define SRCH_CODE_ERR               "0001"  /* 异常错误 */
-#define SRCH_CODE_NO_DATA           "0002"  /* 无数据 */
+/* 分页应答对象 */
+typedef struct
+{
+    invtd_cntx_t *ctx;                      /* 全局对象 */
+    mesg_header_t *head;                    /* 请求报头(主机字节序) */
+    mesg_search_req_t *req;                 /* 搜索请求 */
+
+    xml_tree_t *xml;                        /* 当前分页 */
+    int num;                                /* 当前分页条目数 */
+    int left;                               /* 剩余未处理条目数 */
+    int count;                              /* 已处理条目数 */
+    bool is_expired;                        /* 是否已超过截止时间 */
+    bool is_cancelled;                      /* 是否已被取消 */
+} invtd_search_page_t;
+
+/* 关键字列表 */
+typedef struct
+{
+    int num;                                /* 关键字个数 */
+    int phrase;                             /* 短语关键字个数(位于list前部, 0:无短语) */
+    int slop;                               /* 邻近距离(0:精确短语) */
+    char *list[INVTD_INDEX_TERM_MAX];       /* 关键字(指向buf) */
+    size_t off;                             /* 缓存已用长度 */
+    char buf[SRCH_WORD_LEN + INVTD_INDEX_TERM_MAX]; /* 缓存(关键字 + 结束符) */
+} invtd_search_words_t;
 
 /* 静态函数 */
-static int invtd_search_list_trav(invt_word_doc_t *doc, xml_tree_t *xml);
+static xml_tree_t *invtd_search_rsp_creat(invtd_cntx_t *ctx);
+static bool invtd_search_is_stopped(invtd_search_page_t *page);
+static int invtd_search_add_item(invtd_search_page_t *page, const char *url, const invtd_hit_t *hit);
 static int invtd_search_no_data_hdl(xml_tree_t *xml);
+static int invtd_search_send_and_free(invtd_cntx_t *ctx, xml_tree_t *xml,
+        mesg_header_t *head, mesg_search_req_t *req, uint32_t flag);
 
 /******************************************************************************
  **函数名称: invtd_search_parse
@@ -84,7 +114,12 @@ static int invtd_search_parse(invtd_cntx_t *ctx,
 
         snprintf(req->words, sizeof(req->words), "%s", node->value.str);
 
-        log_trace(ctx->log, "words:%s", req->words);
+        /* > 提取模糊匹配距离(可选) */
+        node = xml_query(xml, ".SEARCH.FUZZY");
+        req->fuzzy = (NULL == node || 0 == node->value.len)? 0 : str_to_num(node->value.str);
+        req->fuzzy = MIN(MAX(req->fuzzy, 0), ctx->conf.fuzzy.max);
+
+        log_trace(ctx->log, "words:%s fuzzy:%d", req->words, req->fuzzy);
 
         /* > 释放内存空间 */
         xml_destroy(xml);
@@ -96,23 +131,20 @@ static int invtd_search_parse(invtd_cntx_t *ctx,
 }
 
 /******************************************************************************
- **函数名称: invtd_search_query
- **功    能: 从倒排表中搜索关键字
+ **函数名称: invtd_search_rsp_creat
+ **功    能: 创建搜索应答树
  **输入参数:
  **     ctx: 上下文
- **     req: 搜索请求信息
  **输出参数: NONE
- **返    回: 搜索结果(以XML树组织)
- **实现描述: 从倒排表中查询结果，并将结果以XML树组织.
+ **返    回: 搜索应答树(根结点为SEARCH-RSP)
+ **实现描述:
  **注意事项: 完成发送后, 必须记得释放XML树的所有内存
- **作    者: # Qifeng.zou # 2016.01.04 17:35:35 #
+ **作    者:
  ******************************************************************************/
-static xml_tree_t *invtd_search_query(invtd_cntx_t *ctx, mesg_search_req_t *req)
+static xml_tree_t *invtd_search_rsp_creat(invtd_cntx_t *ctx)
 {
     xml_opt_t opt;
     xml_tree_t *xml;
-    xml_node_t *root;
-    invt_dic_word_t *word;
 
     memset(&opt, 0, sizeof(opt));
 
@@ -128,35 +160,313 @@ static xml_tree_t *invtd_search_query(invtd_cntx_t *ctx, mesg_search_req_t *req)
         return NULL;
     }
 
-    root = xml_set_root(xml, "SEARCH-RSP");
+    xml_set_root(xml, "SEARCH-RSP");
+
+    return xml;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_url_dup
+ **功    能: 拷贝命中文档的URL
+ **输入参数:
+ **     ctx: 上下文
+ **     hit: 命中结果
+ **     num: 命中数
+ **输出参数: NONE
+ **返    回: URL列表(与hit一一对应)
+ **实现描述: 指针数组与URL串分配在同一块内存中, 一次free()即可释放
+ **注意事项:
+ **     1. 调用者已持有invtab_lock读锁; 拷贝后即可释放读锁, 再构建及发送分页,
+ **        避免在持锁期间序列化XML、压缩及发送而阻塞插入请求
+ **     2. 返回的内存由调用者释放
+ **作    者:
+ ******************************************************************************/
+static char **invtd_search_url_dup(invtd_cntx_t *ctx, const invtd_hit_t *hit, int num)
+{
+    int idx;
+    char **url, *ptr;
+    const char *src;
+    size_t size = num * sizeof(char *);
+
+    for (idx=0; idx<num; ++idx) {
+        src = invtd_index_doc_url(ctx->index, hit[idx].docid);
+        size += strlen(src) + 1;
+    }
+
+    url = (char **)malloc(size);
+    if (NULL == url) {
+        log_error(ctx->log, "Alloc memory failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return NULL;
+    }
+
+    ptr = (char *)(url + num);
+    for (idx=0; idx<num; ++idx) {
+        src = invtd_index_doc_url(ctx->index, hit[idx].docid);
+        size = strlen(src) + 1;
+        memcpy(ptr, src, size);
+        url[idx] = ptr;
+        ptr += size;
+    }
+
+    return url;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_split_cb
+ **功    能: 收集切分出的关键字
+ **输入参数:
+ **     word: 规范化后的关键字
+ **     len: 关键字长度
+ **     pos: 关键字序号
+ **     args: 关键字列表
+ **输出参数: NONE
+ **返    回: 0:继续切分 !0:终止切分
+ **实现描述:
+ **注意事项: 规范化后长度不超过原长度, 因此缓存不会溢出
+ **作    者:
+ ******************************************************************************/
+static int invtd_search_split_cb(const char *word, int len, int pos, void *args)
+{
+    invtd_search_words_t *words = (invtd_search_words_t *)args;
+
+    if (words->num >= INVTD_INDEX_TERM_MAX
+        || words->off + len + 1 > sizeof(words->buf))
+    {
+        return -1;
+    }
+
+    words->list[words->num++] = words->buf + words->off;
+    memcpy(words->buf + words->off, word, len + 1);
+    words->off += len + 1;
+
+    return (words->num >= INVTD_INDEX_TERM_MAX)? -1 : 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_split
+ **功    能: 切分搜索关键字
+ **输入参数:
+ **     ctx: 全局对象
+ **     str: 搜索关键字
+ **输出参数:
+ **     words: 关键字列表
+ **返    回: 关键字个数
+ **实现描述: 与插入共用分词器, 保证查询词与索引词的规范化及切分方式一致.
+ **     以双引号括起的部分为短语, 其后紧跟~N时为邻近查询; 短语关键字按原顺序
+ **     放在列表前部, 其他关键字随后
+ **注意事项:
+ **     1. 最多切分INVTD_INDEX_TERM_MAX个
+ **     2. 只识别第一个短语, 引号不成对时按普通关键字处理
+ **     3. 短语只切分出一个关键字时, 按普通关键字处理
+ **作    者:
+ ******************************************************************************/
+static int invtd_search_split(invtd_cntx_t *ctx, const char *str, invtd_search_words_t *words)
+{
+    char *end;
+    const char *open, *close, *tail;
+
+    memset(words, 0, sizeof(*words));
+
+    open = strchr(str, '"');
+    close = (NULL == open)? NULL : strchr(open + 1, '"');
+    if (NULL == close) {
+        invtd_token_split(ctx->token, str, strlen(str), invtd_search_split_cb, (void *)words);
+        return words->num;
+    }
+
+    /* > 切分短语 */
+    invtd_token_split(ctx->token, open + 1, close - open - 1, invtd_search_split_cb, (void *)words);
+    words->phrase = (words->num > 1)? words->num : 0;
+
+    /* > 提取邻近距离 */
+    tail = close + 1;
+    if ('~' == *tail) {
+        words->slop = (int)strtol(tail + 1, &end, 10);
+        words->slop = MIN(MAX(words->slop, 0), INVTD_INDEX_SLOP_MAX);
+        tail = end;
+    }
+
+    /* > 切分其他关键字 */
+    invtd_token_split(ctx->token, str, open - str, invtd_search_split_cb, (void *)words);
+    invtd_token_split(ctx->token, tail, strlen(tail), invtd_search_split_cb, (void *)words);
+
+    return words->num;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_fuzzy
+ **功    能: 模糊扩展搜索关键字
+ **输入参数:
+ **     ctx: 上下文
+ **     list: 关键字列表
+ **     num: 关键字个数
+ **     dist: 最大编辑距离
+ **输出参数:
+ **     expand: 扩展后的关键字列表(指向词典中的关键字)
+ **返    回: 扩展后的关键字个数
+ **实现描述: 在前缀树中查找与各关键字编辑距离不超过dist的词项, 每个关键字按
+ **     (编辑距离升序, 文档频率降序)至多取conf.fuzzy.expand个
+ **注意事项:
+ **     1. 调用者须持有读锁, 返回的关键字在释放读锁前有效
+ **     2. 扩展后的关键字总数不超过INVTD_INDEX_TERM_MAX
+ **作    者:
+ ******************************************************************************/
+static int invtd_search_fuzzy(invtd_cntx_t *ctx, char **list, int num, int dist, char **expand)
+{
+    int idx, n, k, cnt = 0;
+    invtd_trie_item_t item[MESG_SUGGEST_MAX_NUM];
+
+    if (NULL == ctx->trie) {
+        return 0;
+    }
+
+    for (idx=0; idx<num && cnt<INVTD_INDEX_TERM_MAX; ++idx) {
+        n = invtd_trie_fuzzy(ctx->trie, list[idx], dist, ctx->conf.fuzzy.expand, item);
+        for (k=0; k<n && cnt<INVTD_INDEX_TERM_MAX; ++k) {
+            expand[cnt++] = ctx->index->term[item[k].termid].word;
+            log_debug(ctx->log, "Fuzzy expand! word:%s expand:%s dist:%u df:%u",
+                    list[idx], expand[cnt-1], item[k].dist, item[k].df);
+        }
+    }
+
+    return cnt;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_query
+ **功    能: 从评分索引中搜索关键字
+ **输入参数:
+ **     ctx: 上下文
+ **     head: 请求报头(主机字节序)
+ **     req: 搜索请求信息
+ **输出参数: NONE
+ **返    回: 最后一页搜索结果(以XML树组织)
+ **实现描述: 关键字经分词后按OR语义查询, 结果按BM25得分降序取前topk个, 并以XML树组织.
+ **     含短语时只返回匹配短语的文档, 其他关键字只参与评分.
+ **     开启分页时, 每凑满一页便立即发送(置MESG_FLAG_MORE), 最后一页由调用者发送.
+ **     请求开启模糊匹配且精确查询无结果时, 以模糊扩展后的关键字重新查询(短语查询除外).
+ **注意事项:
+ **     1. 完成发送后, 必须记得释放XML树的所有内存
+ **     2. 只在查询及拷贝URL期间持有invtab_lock读锁
+ **作    者: # Qifeng.zou # 2016.01.04 17:35:35 #
+ ******************************************************************************/
+static xml_tree_t *invtd_search_query(invtd_cntx_t *ctx,
+        mesg_header_t *head, mesg_search_req_t *req)
+{
+    int idx, num, cnt;
+    char **url;
+    invtd_hit_t *hit;
+    invtd_search_page_t page;
+    invtd_search_words_t words;
+    char *expand[INVTD_INDEX_TERM_MAX];
+
+    memset(&page, 0, sizeof(page));
+
+    page.ctx = ctx;
+    page.head = head;
+    page.req = req;
+
+    page.xml = invtd_search_rsp_creat(ctx);
+    if (NULL == page.xml) {
+        return NULL;
+    }
+
+    hit = (invtd_hit_t *)calloc(ctx->conf.topk, sizeof(invtd_hit_t));
+    if (NULL == hit) {
+        log_error(ctx->log, "Alloc memory failed! errmsg:[%d] %s!", errno, strerror(errno));
+        xml_destroy(page.xml);
+        return NULL;
+    }
+
+    /* > 切分关键字 */
+    cnt = invtd_search_split(ctx, req->words, &words);
 
     do {
         pthread_rwlock_rdlock(&ctx->invtab_lock);
 
-        /* > 搜索倒排表 */
-        word = (invt_dic_word_t *)invtab_query(ctx->invtab, req->words);
-        if (NULL == word || NULL == word->doc_list) {
+        /* > 搜索评分索引 */
+        if (words.phrase > 0) {
+            num = invtd_index_phrase(ctx->index, words.list, cnt, words.phrase, words.slop,
+                    ctx->conf.topk, hit, (invtd_index_stop_cb_t)invtd_search_is_stopped, (void *)&page);
+        }
+        else {
+            num = invtd_index_query(ctx->index, words.list, cnt, ctx->conf.topk, hit,
+                    (invtd_index_stop_cb_t)invtd_search_is_stopped, (void *)&page);
+        }
+        if (0 == num && req->fuzzy > 0 && 0 == words.phrase) {
+            /* > 模糊匹配 */
+            cnt = invtd_search_fuzzy(ctx, words.list, cnt, req->fuzzy, expand);
+            if (cnt > 0) {
+                num = invtd_index_query(ctx->index, expand, cnt, ctx->conf.topk, hit,
+                        (invtd_index_stop_cb_t)invtd_search_is_stopped, (void *)&page);
+            }
+        }
+
+        /* > 查询被终止(已超时或已取消) */
+        if (num < 0) {
+            pthread_rwlock_unlock(&ctx->invtab_lock);
+            log_warn(ctx->log, "Request is %s while querying! serial:%lu words:%s",
+                    page.is_expired? "expired" : "cancelled", head->serial, req->words);
+            break;
+        }
+
+        if (0 == num) {
             pthread_rwlock_unlock(&ctx->invtab_lock);
+            free(hit);
             log_warn(ctx->log, "Didn't search anything! words:%s", req->words);
-            if (invtd_search_no_data_hdl(xml)) {
-                break;
+            if (invtd_search_no_data_hdl(page.xml)) {
+                return NULL;
             }
-            return xml;
+            return page.xml;
+        }
+
+        /* > 拷贝URL后释放读锁(构建及发送分页期间无需持锁) */
+        url = invtd_search_url_dup(ctx, hit, num);
+
+        pthread_rwlock_unlock(&ctx->invtab_lock);
+
+        if (NULL == url) {
+            break;
         }
 
         /* > 构建搜索结果 */
-        if (list_trav(word->doc_list, (trav_cb_t)invtd_search_list_trav, (void *)xml)) {
-            pthread_rwlock_unlock(&ctx->invtab_lock);
+        page.left = num;
+        for (idx=0; idx<num; ++idx) {
+            if (invtd_search_add_item(&page, url[idx], &hit[idx])) {
+                num = -1;
+                break;
+            }
+        }
+        free(url);
+
+        if (num < 0) {
+            if (page.is_expired) {
+                log_warn(ctx->log, "Request is expired while searching! serial:%lu words:%s",
+                        head->serial, req->words);
+                break;
+            }
+            else if (page.is_cancelled) {
+                log_warn(ctx->log, "Request is cancelled while searching! serial:%lu words:%s",
+                        head->serial, req->words);
+                break;
+            }
             log_error(ctx->log, "Contribute respone list failed! words:%s", req->words);
             break;
         }
-        pthread_rwlock_unlock(&ctx->invtab_lock);
 
-        xml_add_attr(xml, root, "CODE", SRCH_CODE_OK); /* 设置返回码 */
-        return xml;
+        if (NULL == page.xml) {
+            break;
+        }
+
+        free(hit);
+        xml_add_attr(page.xml, page.xml->root->child, "CODE", SRCH_CODE_OK); /* 设置返回码 */
+        return page.xml;
     } while(0);
 
-    xml_destroy(xml);
+    free(hit);
+    if (NULL != page.xml) {
+        xml_destroy(page.xml);
+    }
     return NULL;
 }
 
@@ -174,11 +484,12 @@ static xml_tree_t *invtd_search_query(invtd_cntx_t *ctx, mesg_search_req_t *req)
 static int invtd_search_no_data_hdl(xml_tree_t *xml)
 {
     xml_node_t *root, *item;
-    char freq[SRCH_SEG_FREQ_LEN];
+    char freq[SRCH_SEG_FREQ_LEN], score[SRCH_SEG_SCORE_LEN];
 
     xml_add_attr(xml, xml->root, "CODE", SRCH_CODE_NO_DATA); /* 无数据 */
 
     snprintf(freq, sizeof(freq), "%d", 0);
+    snprintf(score, sizeof(score), "%d", 0);
 
     root = xml->root->child;
     item = xml_add_child(xml, root, "ITEM", NULL);
@@ -188,47 +499,168 @@ static int invtd_search_no_data_hdl(xml_tree_t *xml)
     }
     xml_add_attr(xml, item, "URL", "Sorry, Didn't search anything!");
     xml_add_attr(xml, item, "FREQ", freq);
+    xml_add_attr(xml, item, "SCORE", score);
     return 0;
 }
 
 /******************************************************************************
- **函数名称: invtd_search_list_trav
+ **函数名称: invtd_search_is_stopped
+ **功    能: 判断是否需要终止搜索
+ **输入参数:
+ **     page: 分页应答对象
+ **输出参数: NONE
+ **返    回: true:终止 false:继续
+ **实现描述: 已超过截止时间或已被取消时终止, 并记录终止原因
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static bool invtd_search_is_stopped(invtd_search_page_t *page)
+{
+    if (MESG_DEADLINE_IS_EXPIRED(page->head->flag)) {
+        page->is_expired = true;
+        return true;
+    }
+    else if (invtd_cancel_is_cancelled(page->ctx->cancel, page->head->serial)) {
+        page->is_cancelled = true;
+        return true;
+    }
+
+    return false;
+}
+
+/******************************************************************************
+ **函数名称: invtd_search_add_item
  **功    能: 构建搜索应答项
  **输入参数:
- **     doc: 搜索列表
- **     xml: 应答结果树
+ **     page: 分页应答对象
+ **     url: URL
+ **     hit: 命中结果
  **输出参数: NONE
  **返    回: 0:Succ !0:Fail
- **实现描述:
+ **实现描述: 当前页已满且后续还有数据时, 立即发送当前页并新建下一页
  **注意事项:
+ **     1. 发送失败时page->xml可能为NULL
+ **     2. 每处理INVTD_DEADLINE_CHECK_NUM个条目检查一次截止时间及是否已取消,
+ **        超时或已取消则停止构建
  **作    者: # Qifeng.zou # 2016.05.04 01:33:38 #
  ******************************************************************************/
-static int invtd_search_list_trav(invt_word_doc_t *doc, xml_tree_t *xml)
+static int invtd_search_add_item(invtd_search_page_t *page, const char *url, const invtd_hit_t *hit)
 {
     xml_node_t *root, *item;
-    char freq[SRCH_SEG_FREQ_LEN];
+    char freq[SRCH_SEG_FREQ_LEN], score[SRCH_SEG_SCORE_LEN];
+    invtd_cntx_t *ctx = page->ctx;
+    xml_tree_t *xml = page->xml;
+
+    if (0 == (++page->count % INVTD_DEADLINE_CHECK_NUM)
+        && invtd_search_is_stopped(page))
+    {
+        return -1;
+    }
 
     root = xml->root->child;
 
-    snprintf(freq, sizeof(freq), "%d", doc->freq);
+    snprintf(freq, sizeof(freq), "%u", hit->freq);
+    snprintf(score, sizeof(score), "%u", hit->score);
 
     item = xml_add_child(xml, root, "ITEM", NULL);
     if (NULL == item) {
-        log_error(xml->log, "Add child failed! url:%s freq:%d", doc->url.str, doc->freq);
+        log_error(xml->log, "Add child failed! url:%s freq:%u", url, hit->freq);
         return -1;
     }
-    xml_add_attr(xml, item, "URL", doc->url.str);
+    xml_add_attr(xml, item, "URL", url);
     xml_add_attr(xml, item, "FREQ", freq);
+    xml_add_attr(xml, item, "SCORE", score);
+
+    ++page->num;
+    --page->left;
+
+    /* > 分页发送(最后一页由调用者发送) */
+    if ((0 == ctx->conf.page_size)
+        || (page->num < ctx->conf.page_size)
+        || (page->left <= 0))
+    {
+        return 0;
+    }
+
+    xml_add_attr(xml, root, "CODE", SRCH_CODE_OK);
+
+    page->xml = NULL;
+    page->num = 0;
+
+    invtd_search_send_and_free(ctx, xml, page->head, page->req, MESG_FLAG_MORE);
+
+    page->xml = invtd_search_rsp_creat(ctx);
+    if (NULL == page->xml) {
+        return -1;
+    }
+
     return 0;
 }
 
+/******************************************************************************
+ **函数名称: invtd_search_zip
+ **功    能: 压缩应答报体
+ **输入参数:
+ **     ctx: 上下文
+ **     head: 应答报头(主机字节序)
+ **     body: 原始报体
+ **输出参数:
+ **     total_len: 压缩后消息总长
+ **返    回: 压缩后的消息(报头+mesg_zip_body_t), 无需压缩或压缩无收益时返回NULL
+ **实现描述: 报头拷贝自原始报头, 置MESG_FLAG_ZIP标识并修正报体长度
+ **注意事项: 返回的内存由调用者释放
+ **作    者:
+ ******************************************************************************/
+static void *invtd_search_zip(invtd_cntx_t *ctx,
+        const mesg_header_t *head, const char *body, int *total_len)
+{
+    uLongf zlen;
+    mesg_header_t *zhead;
+    mesg_zip_body_t *zbody;
+
+    if (!ctx->conf.compress.enable
+        || (int)head->length < ctx->conf.compress.threshold
+        || head->length > MESG_ZIP_ORIG_MAX) /* 超出帧听层的解压上限 */
+    {
+        return NULL;
+    }
+
+    zlen = compressBound(head->length);
+
+    zhead = (mesg_header_t *)calloc(1, sizeof(mesg_header_t) + sizeof(mesg_zip_body_t) + zlen);
+    if (NULL == zhead) {
+        return NULL;
+    }
+
+    zbody = (mesg_zip_body_t *)(zhead + 1);
+
+    if (Z_OK != compress2((Bytef *)zbody->data, &zlen,
+                (const Bytef *)body, head->length, ctx->conf.compress.level)
+        || (zlen + sizeof(mesg_zip_body_t)) >= head->length)
+    {
+        free(zhead);
+        return NULL; /* 压缩失败或无收益 */
+    }
+
+    memcpy(zhead, head, sizeof(mesg_header_t));
+    zhead->flag |= MESG_FLAG_ZIP;
+    zhead->length = sizeof(mesg_zip_body_t) + zlen;
+    zbody->orig_len = htonl(head->length);
+
+    *total_len = MESG_TOTAL_LEN(zhead->length);
+
+    return (void *)zhead;
+}
+
 /******************************************************************************
  **函数名称: invtd_search_send_and_free
  **功    能: 从发送搜索结果并释放内存
  **输入参数:
  **     ctx: 上下文
  **     xml: 搜索结果信息
+ **     head: 请求报头(主机字节序)
  **     req: 搜索请求信息
+ **     flag: 附加标识(如: MESG_FLAG_MORE)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述: 从倒排表中查询结果，并将结果以XML树组织.
@@ -236,11 +668,11 @@ static int invtd_search_list_trav(invt_word_doc_t *doc, xml_tree_t *xml)
  **作    者: # Qifeng.zou # 2016.01.04 17:35:35 #
  ******************************************************************************/
 static int invtd_search_send_and_free(invtd_cntx_t *ctx, xml_tree_t *xml,
-        mesg_header_t *head, mesg_search_req_t *req, int orig)
+        mesg_header_t *head, mesg_search_req_t *req, uint32_t flag)
 {
-    void *addr = NULL;
+    void *addr = NULL, *zaddr;
     mesg_header_t *rsp; /* 应答 */
-    int body_len, total_len;
+    int body_len, total_len, zip_len;
 
     if (NULL == xml) { return 0; }
 
@@ -260,10 +692,21 @@ static int invtd_search_send_and_free(invtd_cntx_t *ctx, xml_tree_t *xml,
 
         MESG_HEAD_SET(rsp, MSG_SEARCH_RSP,
                 head->sid, head->nid, head->serial, body_len);
-        MESG_HEAD_HTON(rsp, rsp);
+        rsp->flag |= flag;
 
         xml_spack(xml, rsp->body);
 
+        /* 压缩报体(可选) */
+        zaddr = invtd_search_zip(ctx, rsp, rsp->body, &zip_len);
+        if (NULL != zaddr) {
+            free(addr);
+            addr = zaddr;
+            total_len = zip_len;
+            rsp = (mesg_header_t *)addr;
+        }
+
+        MESG_HEAD_HTON(rsp, rsp);
+
         /* 放入发送队列 */
         if (rtmq_proxy_async_send(ctx->frwder, MSG_SEARCH_RSP, addr, total_len)) {
             log_error(ctx->log, "Send response failed! serial:%ld words:%s",
@@ -288,8 +731,8 @@ static int invtd_search_send_and_free(invtd_cntx_t *ctx, xml_tree_t *xml,
  **     args: 附加参数
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 从倒排表中查询结果，并将结果返回给客户端
- **注意事项:
+ **实现描述: 从评分索引中查询结果，并将结果返回给客户端
+ **注意事项: 已超过截止时间或已被取消的请求不再处理(客户端已放弃等待)
  **作    者: # Qifeng.zou # 2015.05.08 #
  ******************************************************************************/
 int invtd_search_req_hdl(int type, int orig, char *buff, size_t len, void *args)
@@ -305,80 +748,33 @@ int invtd_search_req_hdl(int type, int orig, char *buff, size_t len, void *args)
         return INVT_ERR;
     }
 
-    /* > 从倒排表中搜索关键字 */
-    xml = invtd_search_query(ctx, &req);
+    /* > 丢弃已超时的请求 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! serial:%lu words:%s", head->serial, req.words);
+        return INVT_OK;
+    }
+    else if (invtd_cancel_is_cancelled(ctx->cancel, head->serial)) {
+        log_warn(ctx->log, "Request is cancelled! serial:%lu words:%s", head->serial, req.words);
+        return INVT_OK;
+    }
+
+    /* > 从评分索引中搜索关键字 */
+    xml = invtd_search_query(ctx, head, &req);
     if (NULL == xml) {
+        if (MESG_DEADLINE_IS_EXPIRED(head->flag)
+            || invtd_cancel_is_cancelled(ctx->cancel, head->serial))
+        {
+            return INVT_OK; /* 搜索途中超时或被取消 */
+        }
         log_error(ctx->log, "Search word form table failed! words:%s", req.words);
         return INVT_ERR;
     }
 
     /* > 发送搜索结果&释放内存 */
-    if (invtd_search_send_and_free(ctx, xml, head, &req, orig)) {
+    if (invtd_search_send_and_free(ctx, xml, head, &req, 0)) {
         log_error(ctx->log, "Search word form table failed! words:%s", req.words);
         return INVT_ERR;
     }
 
     return INVT_OK;
 }
-
-/******************************************************************************
- **函数名称: invtd_insert_word_req_hdl
- **功    能: 插入关键字的处理
- **输入参数:
- **     type: 消息类型
- **     orig: 源节点ID
- **     buff: 插入关键字-请求数据
- **     len: 数据长度
- **     args: 附加参数
- **输出参数: NONE
- **返    回: 0:成功 !0:失败
- **实现描述:
- **注意事项: 源节点ID(orig)将成为应答消息的目的节点ID(dest)
-    **作    者: # Qifeng.zou # 2015-06-17 21:37:55 #
- ******************************************************************************/
-int invtd_insert_word_req_hdl(int type, int orig, char *buff, size_t len, void *args)
-{
-    mesg_insert_word_rsp_t *rsp;
-    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
-    mesg_header_t *rsp_head, *head = (mesg_header_t *)buff;
-    mesg_insert_word_req_t *req = (mesg_insert_word_req_t *)(head + 1); /* 请求 */
-    char addr[sizeof(mesg_header_t) + sizeof(mesg_insert_word_rsp_t)];
-
-    /* > 转换字节序 */
-    MESG_HEAD_NTOH(head, head);
-    req->freq = ntohl(req->freq);
-
-    rsp_head = (mesg_header_t *)addr;
-    rsp = (mesg_insert_word_rsp_t *)(rsp_head + 1);
-
-    /* > 插入倒排表 */
-    pthread_rwlock_wrlock(&ctx->invtab_lock);
-    if (invtab_insert(ctx->invtab, req->word, req->url, req->freq)) {
-        pthread_rwlock_unlock(&ctx->invtab_lock);
-        log_error(ctx->log, "Insert invert table failed! serial:%s word:%s url:%s freq:%d",
-                head->serial, req->word, req->url, req->freq);
-        /* > 设置应答信息 */
-        rsp->code = MESG_INSERT_WORD_FAIL; // 失败
-        snprintf(rsp->word, sizeof(rsp->word), "%s", req->word);
-        goto INVTD_INSERT_WORD_RSP;
-    }
-    pthread_rwlock_unlock(&ctx->invtab_lock);
-
-    /* > 设置应答信息 */
-    rsp->code = MESG_INSERT_WORD_SUCC; // 成功
-    snprintf(rsp->word, sizeof(rsp->word), "%s", req->word);
-
-INVTD_INSERT_WORD_RSP:
-    /* > 发送应答信息 */
-    MESG_HEAD_SET(rsp_head, MSG_INSERT_WORD_RSP, head->sid,
-            head->nid, head->serial, sizeof(mesg_insert_word_rsp_t));
-    MESG_HEAD_HTON(rsp_head, rsp_head);
-    mesg_insert_word_resp_hton(rsp);
-
-    if (rtmq_proxy_async_send(ctx->frwder, MSG_INSERT_WORD_RSP, (void *)addr, sizeof(addr))) {
-        log_error(ctx->log, "Send response failed! serial:%s word:%s url:%s freq:%d",
-                head->serial, req->word, req->url, req->freq);
-    }
-
-    return INVT_OK;
-}
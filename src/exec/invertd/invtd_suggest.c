@@ -0,0 +1,95 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_suggest.c
+ ** 版本号: 1.0
+ ** 描  述: 搜索建议(前缀补全)
+ **         在前缀树词典中查找以给定前缀开头的关键字, 按文档频率降序返回前N个.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invertd.h"
+#include "invtd_mesg.h"
+
+/******************************************************************************
+ **函数名称: invtd_suggest_req_hdl
+ **功    能: 处理搜索建议请求
+ **输入参数:
+ **     type: 消息类型
+ **     orig: 源设备ID
+ **     buff: 搜索建议-请求数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 持读锁在前缀树中查找建议, 并拷贝关键字
+ **     2. 组装应答并发送
+ **注意事项:
+ **     1. 前缀树尚未建成时返回空列表
+ **     2. 前缀树由插入线程定期重建, 刚插入的关键字可能延迟INVTD_TRIE_REBUILD_INTV后可见
+ **作    者:
+ ******************************************************************************/
+int invtd_suggest_req_hdl(int type, int orig, char *buff, size_t len, void *args)
+{
+    int idx, num;
+    mesg_suggest_rsp_t *rsp;
+    mesg_header_t *rsp_head;
+    invtd_cntx_t *ctx = (invtd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)buff;
+    mesg_suggest_req_t *req = (mesg_suggest_req_t *)(head + 1); /* 请求 */
+    invtd_trie_item_t item[MESG_SUGGEST_MAX_NUM];
+    char addr[sizeof(mesg_header_t) + MESG_SUGGEST_RSP_LEN(MESG_SUGGEST_MAX_NUM)];
+
+    if (len < MESG_TOTAL_LEN(sizeof(mesg_suggest_req_t))) {
+        log_error(ctx->log, "Suggest request is too short! len:%lu", len);
+        return INVT_ERR;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+    mesg_suggest_req_ntoh(req);
+    req->prefix[sizeof(req->prefix) - 1] = '\0';
+    invtd_token_normalize(req->prefix, req->prefix, sizeof(req->prefix)); /* 与索引词一致 */
+
+    /* > 丢弃已超时的请求 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! serial:%lu prefix:%s", head->serial, req->prefix);
+        return INVT_OK;
+    }
+
+    num = (0 == req->num || req->num > MESG_SUGGEST_MAX_NUM)? MESG_SUGGEST_MAX_NUM : (int)req->num;
+
+    rsp_head = (mesg_header_t *)addr;
+    rsp = (mesg_suggest_rsp_t *)(rsp_head + 1);
+
+    /* > 查找建议 */
+    pthread_rwlock_rdlock(&ctx->invtab_lock);
+    num = (NULL == ctx->trie)? 0 : invtd_trie_suggest(ctx->trie, req->prefix, num, item);
+    for (idx=0; idx<num; ++idx) {
+        snprintf(rsp->item[idx].word, sizeof(rsp->item[idx].word),
+                "%s", ctx->index->term[item[idx].termid].word);
+        rsp->item[idx].df = item[idx].df;
+    }
+    pthread_rwlock_unlock(&ctx->invtab_lock);
+
+    rsp->num = num;
+
+    /* > 发送应答 */
+    MESG_HEAD_SET(rsp_head, MSG_SUGGEST_RSP, head->sid,
+            head->nid, head->serial, MESG_SUGGEST_RSP_LEN(num));
+    MESG_HEAD_HTON(rsp_head, rsp_head);
+    mesg_suggest_rsp_hton(rsp);
+
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_SUGGEST_RSP,
+                (void *)addr, MESG_TOTAL_LEN(MESG_SUGGEST_RSP_LEN(num))))
+    {
+        log_error(ctx->log, "Send suggest response failed! serial:%lu prefix:%s",
+                head->serial, req->prefix);
+        return INVT_ERR;
+    }
+
+    log_debug(ctx->log, "Suggest success! serial:%lu prefix:%s num:%d", head->serial, req->prefix, num);
+
+    return INVT_OK;
+}
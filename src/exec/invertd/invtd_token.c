@@ -0,0 +1,632 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_token.c
+ ** 版本号: 1.0
+ ** 描  述: 分词器
+ **         插入与查询共用, 保证两侧得到相同的词:
+ **         1. 规范化: 全角ASCII转半角, 全角空格转半角, ASCII字母转小写
+ **         2. 切分: 连续的单词字符组成一个词; 中日韩文字以双数组Trie词典做
+ **            正向最大匹配, 未登录的字单独成词
+ ** 作  者:
+ ******************************************************************************/
+#include "invtd_token.h"
+
+#define INVTD_TOKEN_CODE_NUM    (257)       /* 转移码数(0:词结束 1~256:字节+1) */
+#define INVTD_TOKEN_WORD_CHARS  "+_"       /* 可出现在词中的ASCII标点(如: c++) */
+#define INVTD_TOKEN_JOIN_CHARS  "-.#@&"    /* 只能出现在单词字符之间的ASCII标点(如: e-mail, a@b.com) */
+
+/* 兄弟结点(构建双数组时使用) */
+typedef struct
+{
+    int code;                               /* 转移码 */
+    int left;                               /* 子树词在有序词典中的起始位置 */
+    int right;                              /* 子树词在有序词典中的结束位置(不含) */
+} invtd_token_sib_t;
+
+/* 构建对象 */
+typedef struct
+{
+    invtd_token_t *tk;                      /* 分词器 */
+    char **word;                            /* 有序词典 */
+    uint8_t *used;                          /* 已被占用的base */
+    int next;                               /* 下一个可能空闲的位置 */
+} invtd_token_builder_t;
+
+/******************************************************************************
+ **函数名称: invtd_token_decode
+ **功    能: 解析一个UTF-8字符
+ **输入参数:
+ **     s: 字符串
+ **     len: 剩余长度
+ **输出参数:
+ **     cp: 码点(非法编码时为0xFFFD)
+ **返    回: 字符字节数
+ **实现描述:
+ **注意事项: 非法编码按单字节处理, 保证切分总能前进
+ **作    者:
+ ******************************************************************************/
+static inline int invtd_token_decode(const uint8_t *s, size_t len, uint32_t *cp)
+{
+    if (s[0] < 0x80) {
+        *cp = s[0];
+        return 1;
+    }
+    else if (0xC0 == (s[0] & 0xE0) && len >= 2 && 0x80 == (s[1] & 0xC0)) {
+        *cp = ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+        return 2;
+    }
+    else if (0xE0 == (s[0] & 0xF0) && len >= 3
+        && 0x80 == (s[1] & 0xC0) && 0x80 == (s[2] & 0xC0))
+    {
+        *cp = ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+        return 3;
+    }
+    else if (0xF0 == (s[0] & 0xF8) && len >= 4
+        && 0x80 == (s[1] & 0xC0) && 0x80 == (s[2] & 0xC0) && 0x80 == (s[3] & 0xC0))
+    {
+        *cp = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+        return 4;
+    }
+
+    *cp = 0xFFFD;
+    return 1;
+}
+
+/* 全角转半角 */
+static inline uint32_t invtd_token_fold(uint32_t cp)
+{
+    if (cp >= 0xFF01 && cp <= 0xFF5E) {
+        return cp - 0xFEE0;
+    }
+    else if (0x3000 == cp) {
+        return ' ';
+    }
+    return cp;
+}
+
+/* 非ASCII字符的类别 */
+static inline int invtd_token_class(uint32_t cp)
+{
+    if ((cp >= 0x2000 && cp <= 0x206F)      /* 通用标点 */
+        || (cp >= 0x3000 && cp <= 0x303F)   /* 中日韩标点 */
+        || (cp >= 0xFE30 && cp <= 0xFE4F)   /* 中日韩兼容标点 */
+        || (cp >= 0xFF00 && cp <= 0xFF65))  /* 全角/半角标点 */
+    {
+        return INVTD_TOKEN_SEP;
+    }
+    else if ((cp >= 0x2E80 && cp <= 0x2FDF) /* 部首 */
+        || (cp >= 0x3040 && cp <= 0x31FF)   /* 假名、注音 */
+        || (cp >= 0x3400 && cp <= 0x9FFF)   /* 汉字 */
+        || (cp >= 0xAC00 && cp <= 0xD7AF)   /* 谚文 */
+        || (cp >= 0xF900 && cp <= 0xFAFF)   /* 兼容汉字 */
+        || (cp >= 0x20000 && cp <= 0x2FFFF))/* 扩展汉字 */
+    {
+        return INVTD_TOKEN_CJK;
+    }
+    return INVTD_TOKEN_WORD;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_normalize
+ **功    能: 规范化字符串
+ **输入参数:
+ **     str: 字符串
+ **     size: 输出缓存长度
+ **输出参数:
+ **     out: 规范化后的字符串
+ **返    回: 规范化后的长度
+ **实现描述: 全角ASCII转半角, 全角空格转半角, ASCII字母转小写; 其他字符原样拷贝
+ **注意事项:
+ **     1. 规范化后长度不会超过原长度, 因此out可以与str相同
+ **     2. 超出输出缓存的字符被截断(不会截断在字符中间)
+ **作    者:
+ ******************************************************************************/
+int invtd_token_normalize(const char *str, char *out, size_t size)
+{
+    int n;
+    uint32_t cp;
+    size_t i = 0, len = strlen(str), olen = 0;
+    const uint8_t *s = (const uint8_t *)str;
+
+    while (i < len) {
+        n = invtd_token_decode(s + i, len - i, &cp);
+        cp = invtd_token_fold(cp);
+        if (cp < 0x80) {
+            if (olen + 1 >= size) {
+                break;
+            }
+            out[olen++] = (cp >= 'A' && cp <= 'Z')? cp + ('a' - 'A') : cp;
+        } else {
+            if (olen + n >= size) {
+                break;
+            }
+            memmove(out + olen, s + i, n);
+            olen += n;
+        }
+        i += n;
+    }
+
+    if (size > 0) {
+        out[olen] = '\0';
+    }
+
+    return (int)olen;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_match
+ **功    能: 正向最大匹配
+ **输入参数:
+ **     tk: 分词器
+ **     s: 文本
+ **     len: 剩余长度
+ **输出参数: NONE
+ **返    回: 匹配到的最长词的字节数(0:未匹配)
+ **实现描述: 自根结点按字节转移, 每到达一个状态便检查是否存在词结束转移
+ **注意事项: 最多转移max_len次
+ **作    者:
+ ******************************************************************************/
+static inline int invtd_token_match(const invtd_token_t *tk, const uint8_t *s, size_t len)
+{
+    size_t k;
+    int32_t st = 0, t;
+    int best = 0;
+    const invtd_token_unit_t *unit = tk->unit;
+
+    if (NULL == unit) {
+        return 0;
+    }
+
+    len = MIN(len, (size_t)tk->max_len);
+    for (k=0; k<len; ++k) {
+        t = unit[st].base + s[k] + 1;
+        if (t >= tk->size || unit[t].check != st + 1) {
+            break;
+        }
+        st = t;
+
+        t = unit[st].base; /* 词结束转移(code 0) */
+        if (t >= 0 && t < tk->size && unit[t].check == st + 1) {
+            best = k + 1;
+        }
+    }
+
+    return best;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_split
+ **功    能: 切分文本
+ **输入参数:
+ **     tk: 分词器
+ **     text: 文本(UTF-8)
+ **     len: 文本长度
+ **     cb: 切分回调
+ **     args: 回调参数
+ **输出参数: NONE
+ **返    回: 词数
+ **实现描述:
+ **     1. 单词字符: 规范化后累积, 遇到分隔符或中日韩文字时成词
+ **     2. 连接符: 只保留单词字符之间的单个连接符, 位于词首、词尾或连续出现时
+ **        视为分隔符(如: "search." => "search", "a..b" => "a"、"b")
+ **     3. 中日韩文字: 以词典做正向最大匹配, 未匹配时单字成词
+ **注意事项:
+ **     1. 中日韩文字不受规范化影响, 因此直接在原文上匹配
+ **     2. 超长的词被截断为INVTD_TOKEN_WORD_LEN-1字节
+ **     3. 回调返回非0时终止切分
+ **作    者:
+ ******************************************************************************/
+int invtd_token_split(const invtd_token_t *tk, const char *text, size_t len, invtd_token_cb_t cb, void *args)
+{
+    uint32_t cp;
+    size_t i = 0;
+    int n, cls, wlen = 0, wend = 0, pos = 0;
+    char word[INVTD_TOKEN_WORD_LEN];
+    const uint8_t *s = (const uint8_t *)text;
+
+#define INVTD_TOKEN_EMIT() /* 单词成词(去掉词尾的连接符) */\
+    wlen = wend; \
+    if (wlen > 0) { \
+        word[wlen] = '\0'; \
+        if (cb(word, wlen, pos++, args)) { return pos; } \
+        wlen = 0; \
+        wend = 0; \
+    }
+
+#define INVTD_TOKEN_PUTC(c) /* 累积ASCII单词字符(wend: 最后一个非连接符之后的位置) */\
+    if (INVTD_TOKEN_JOIN == tk->ascii[c]) { \
+        if (wlen != wend) { \
+            INVTD_TOKEN_EMIT(); /* 连续的连接符 */ \
+        } else if (wlen > 0 && wlen + 1 < INVTD_TOKEN_WORD_LEN) { \
+            word[wlen++] = (c); \
+        } \
+    } else if (INVTD_TOKEN_WORD == tk->ascii[c]) { \
+        if (wlen + 1 < INVTD_TOKEN_WORD_LEN) { \
+            word[wlen++] = ((c) >= 'A' && (c) <= 'Z')? (c) + ('a' - 'A') : (c); \
+            wend = wlen; \
+        } \
+    } else { \
+        INVTD_TOKEN_EMIT(); \
+    }
+
+    while (i < len) {
+        /* > ASCII快速路径 */
+        if (s[i] < 0x80) {
+            INVTD_TOKEN_PUTC(s[i]);
+            ++i;
+            continue;
+        }
+
+        n = invtd_token_decode(s + i, len - i, &cp);
+        cp = invtd_token_fold(cp);
+        if (cp < 0x80) { /* 全角ASCII */
+            INVTD_TOKEN_PUTC(cp);
+            i += n;
+            continue;
+        }
+
+        cls = invtd_token_class(cp);
+        if (INVTD_TOKEN_WORD == cls) {
+            if (wlen + n < INVTD_TOKEN_WORD_LEN) {
+                memcpy(word + wlen, s + i, n);
+                wlen += n;
+                wend = wlen;
+            }
+            i += n;
+            continue;
+        }
+
+        INVTD_TOKEN_EMIT();
+
+        if (INVTD_TOKEN_CJK == cls) {
+            /* > 正向最大匹配(未匹配时单字成词) */
+            n = MAX(invtd_token_match(tk, s + i, len - i), n);
+            memcpy(word, s + i, MIN(n, INVTD_TOKEN_WORD_LEN - 1));
+            wlen = MIN(n, INVTD_TOKEN_WORD_LEN - 1);
+            wend = wlen;
+            INVTD_TOKEN_EMIT();
+        }
+        i += n;
+    }
+
+    INVTD_TOKEN_EMIT();
+
+    return pos;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_resize
+ **功    能: 扩展双数组
+ **输入参数:
+ **     b: 构建对象
+ **     size: 所需长度
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 按2倍扩展, 新增部分清零
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static int invtd_token_resize(invtd_token_builder_t *b, int size)
+{
+    int max;
+    uint8_t *used;
+    invtd_token_unit_t *unit;
+    invtd_token_t *tk = b->tk;
+
+    if (size <= tk->size) {
+        return 0;
+    }
+
+    for (max=MAX(tk->size, 1024); max<size; max<<=1) ;
+
+    unit = (invtd_token_unit_t *)realloc(tk->unit, max * sizeof(invtd_token_unit_t));
+    if (NULL == unit) {
+        return -1;
+    }
+    tk->unit = unit;
+
+    used = (uint8_t *)realloc(b->used, max * sizeof(uint8_t));
+    if (NULL == used) {
+        return -1;
+    }
+    b->used = used;
+
+    memset(tk->unit + tk->size, 0, (max - tk->size) * sizeof(invtd_token_unit_t));
+    memset(b->used + tk->size, 0, (max - tk->size) * sizeof(uint8_t));
+    tk->size = max;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_insert
+ **功    能: 将子结点放入双数组
+ **输入参数:
+ **     b: 构建对象
+ **     parent: 父结点
+ **     depth: 子结点深度
+ **     left: 子树词在有序词典中的起始位置
+ **     right: 子树词在有序词典中的结束位置(不含)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 按第depth个字节将[left, right)分组, 每组为一个子结点
+ **     2. 自next起寻找能容纳所有子结点的base(首次适配)
+ **     3. 登记子结点后逐一递归
+ **注意事项: 已占满的前缀区域较密集时推进next, 避免重复扫描
+ **作    者:
+ ******************************************************************************/
+static int invtd_token_insert(invtd_token_builder_t *b, int parent, int depth, int left, int right)
+{
+    invtd_token_t *tk = b->tk;
+    invtd_token_sib_t sib[INVTD_TOKEN_CODE_NUM];
+    int i, j, num = 0, pos, begin, busy = 0, first = 1, code;
+
+    /* > 按字节分组 */
+    for (i=left; i<right; i=j) {
+        code = (uint8_t)b->word[i][depth];
+        code = ('\0' == code)? 0 : code + 1;
+        for (j=i+1; j<right; ++j) {
+            if (0 != code && (uint8_t)b->word[j][depth] + 1 == code) {
+                continue;
+            }
+            break;
+        }
+        sib[num].code = code;
+        sib[num].left = i;
+        sib[num++].right = j;
+    }
+
+    /* > 寻找base */
+    pos = MAX(sib[0].code + 1, b->next) - 1;
+    while (1) {
+        ++pos;
+        if (invtd_token_resize(b, pos + 1)) {
+            return -1;
+        }
+        if (0 != tk->unit[pos].check) {
+            ++busy;
+            continue;
+        }
+        else if (first) {
+            b->next = pos;
+            first = 0;
+        }
+
+        begin = pos - sib[0].code;
+        if (invtd_token_resize(b, begin + INVTD_TOKEN_CODE_NUM)) {
+            return -1;
+        }
+        else if (b->used[begin]) {
+            continue;
+        }
+
+        for (i=1; i<num; ++i) {
+            if (0 != tk->unit[begin + sib[i].code].check) {
+                break;
+            }
+        }
+        if (i == num) {
+            break;
+        }
+    }
+
+    if (busy > 0 && 1.0 * busy / (pos - b->next + 1) >= 0.95) {
+        b->next = pos;
+    }
+
+    /* > 登记子结点 */
+    b->used[begin] = 1;
+    tk->unit[parent].base = begin;
+    for (i=0; i<num; ++i) {
+        tk->unit[begin + sib[i].code].check = parent + 1;
+    }
+
+    for (i=0; i<num; ++i) {
+        if (0 == sib[i].code) {
+            tk->unit[begin].base = -1; /* 词结束 */
+            continue;
+        }
+        if (invtd_token_insert(b, begin + sib[i].code, depth + 1, sib[i].left, sib[i].right)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int invtd_token_word_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_load
+ **功    能: 加载词典
+ **输入参数:
+ **     path: 词典路径(每行一个词, 首个空白后的内容(如词频)忽略, #开头为注释)
+ **     log: 日志对象
+ **输出参数:
+ **     num: 词数
+ **返    回: 有序且去重的词典
+ **实现描述: 词经规范化后排序去重, 与切分时的规范化保持一致
+ **注意事项: 返回的内存由调用者释放
+ **作    者:
+ ******************************************************************************/
+static char **invtd_token_load(const char *path, int *num, log_cycle_t *log)
+{
+    FILE *fp;
+    char **word, **tmp, line[FILE_LINE_MAX_LEN], buf[INVTD_TOKEN_WORD_LEN];
+    int i, n = 0, max = 0;
+
+    fp = fopen(path, "r");
+    if (NULL == fp) {
+        log_error(log, "Open dictionary failed! path:%s errmsg:[%d] %s!", path, errno, strerror(errno));
+        return NULL;
+    }
+
+    word = NULL;
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        if ('#' == line[0]) {
+            continue;
+        }
+        line[strcspn(line, " \t\r\n")] = '\0';
+        if ('\0' == line[0] || strlen(line) >= INVTD_TOKEN_WORD_LEN) {
+            continue;
+        }
+
+        invtd_token_normalize(line, buf, sizeof(buf));
+
+        if (n >= max) {
+            max = MAX(2 * max, 1024);
+            tmp = (char **)realloc(word, max * sizeof(char *));
+            if (NULL == tmp) {
+                break;
+            }
+            word = tmp;
+        }
+
+        word[n] = strdup(buf);
+        if (NULL == word[n]) {
+            break;
+        }
+        ++n;
+    }
+
+    if (!feof(fp)) {
+        log_error(log, "Load dictionary failed! path:%s errmsg:[%d] %s!", path, errno, strerror(errno));
+        fclose(fp);
+        for (i=0; i<n; ++i) { free(word[i]); }
+        free(word);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    /* > 排序去重 */
+    if (n > 0) {
+        qsort(word, n, sizeof(char *), invtd_token_word_cmp);
+        for (max=1, i=1; i<n; ++i) {
+            if (0 == strcmp(word[i], word[max-1])) {
+                free(word[i]);
+                continue;
+            }
+            word[max++] = word[i];
+        }
+        n = max;
+    }
+
+    *num = n;
+
+    return word;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_creat
+ **功    能: 创建分词器
+ **输入参数:
+ **     dict: 词典路径(NULL或空串: 不加载词典, 中日韩文字单字成词)
+ **     log: 日志对象
+ **输出参数: NONE
+ **返    回: 分词器
+ **实现描述: 加载词典后构建双数组Trie
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+invtd_token_t *invtd_token_creat(const char *dict, log_cycle_t *log)
+{
+    int i, num = 0;
+    char **word = NULL;
+    invtd_token_t *tk;
+    invtd_token_builder_t b;
+
+    tk = (invtd_token_t *)calloc(1, sizeof(invtd_token_t));
+    if (NULL == tk) {
+        return NULL;
+    }
+
+    /* > ASCII字符类别 */
+    for (i=0; i<128; ++i) {
+        if (isalnum(i) || (0 != i && NULL != strchr(INVTD_TOKEN_WORD_CHARS, i))) {
+            tk->ascii[i] = INVTD_TOKEN_WORD;
+        } else if (0 != i && NULL != strchr(INVTD_TOKEN_JOIN_CHARS, i)) {
+            tk->ascii[i] = INVTD_TOKEN_JOIN;
+        } else {
+            tk->ascii[i] = INVTD_TOKEN_SEP;
+        }
+    }
+
+    if (NULL == dict || '\0' == dict[0]) {
+        return tk;
+    }
+
+    /* > 加载词典 */
+    word = invtd_token_load(dict, &num, log);
+    if (NULL == word) {
+        free(tk);
+        return NULL;
+    }
+
+    tk->word_num = num;
+    for (i=0; i<num; ++i) {
+        tk->max_len = MAX(tk->max_len, (int)strlen(word[i]));
+    }
+
+    /* > 构建双数组Trie */
+    memset(&b, 0, sizeof(b));
+
+    b.tk = tk;
+    b.word = word;
+    b.next = 1;
+
+    if (num > 0) {
+        if (invtd_token_resize(&b, INVTD_TOKEN_CODE_NUM)) {
+            num = -1;
+        } else {
+            tk->unit[0].check = -1; /* 根结点 */
+            b.used[0] = 1;
+            if (invtd_token_insert(&b, 0, 0, 0, num)) {
+                num = -1;
+            }
+        }
+    }
+
+    for (i=0; i<tk->word_num; ++i) {
+        free(word[i]);
+    }
+    free(word);
+    free(b.used);
+
+    if (num < 0) {
+        log_error(log, "Build dictionary failed! path:%s", dict);
+        invtd_token_destroy(tk);
+        return NULL;
+    }
+
+    log_info(log, "Load dictionary success! path:%s word:%d max_len:%d size:%d",
+            dict, tk->word_num, tk->max_len, tk->size);
+
+    return tk;
+}
+
+/******************************************************************************
+ **函数名称: invtd_token_destroy
+ **功    能: 销毁分词器
+ **输入参数:
+ **     tk: 分词器
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+void invtd_token_destroy(invtd_token_t *tk)
+{
+    if (NULL == tk) {
+        return;
+    }
+
+    free(tk->unit);
+    free(tk);
+}
@@ -0,0 +1,516 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: invtd_trie.c
+ ** 版本号: 1.0
+ ** 描  述: 前缀树词典
+ **         以评分索引的词典为输入, 构建紧凑的静态前缀树: 结点连续存放, 每个
+ **         结点的子树对应有序词典中的连续区间; 再以线段树维护区间内文档频率
+ **         最大的位置, 前缀补全只需O(|prefix|)定位区间, 再按文档频率取前N个.
+ ** 作  者:
+ ******************************************************************************/
+#include "cmd.h"
+#include "invtd_trie.h"
+
+/* 待排序的关键字 */
+typedef struct
+{
+    const char *word;                       /* 关键字 */
+    uint32_t termid;                        /* 词项ID */
+} invtd_trie_word_t;
+
+/* 候选区间 */
+typedef struct
+{
+    uint32_t lo;                            /* 起始位置 */
+    uint32_t hi;                            /* 结束位置(不含) */
+    uint32_t pos;                           /* 区间内文档频率最大的位置 */
+} invtd_trie_range_t;
+
+#define INVTD_TRIE_NONE     (UINT32_MAX)    /* 无效位置 */
+
+static int invtd_trie_word_cmp(const void *a, const void *b)
+{
+    return strcmp(((const invtd_trie_word_t *)a)->word, ((const invtd_trie_word_t *)b)->word);
+}
+
+/* 文档频率较大的位置(频率相同时取字典序靠前者) */
+static inline uint32_t invtd_trie_better(const invtd_trie_t *trie, uint32_t a, uint32_t b)
+{
+    if (INVTD_TRIE_NONE == a) {
+        return b;
+    }
+    else if (INVTD_TRIE_NONE == b) {
+        return a;
+    }
+
+    return (trie->df[a] > trie->df[b] || (trie->df[a] == trie->df[b] && a < b))? a : b;
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_build_node
+ **功    能: 构建子树
+ **输入参数:
+ **     trie: 前缀树
+ **     word: 有序关键字
+ **     nid: 结点下标
+ **     lo: 子树起始位置
+ **     hi: 子树结束位置(不含)
+ **     depth: 结点深度(即: 公共前缀长度)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 按第depth个字节分组, 每组为一个子结点; 子结点连续分配后再逐一递归
+ **注意事项: 结点数组已按上限预分配, 递归过程中不会移动
+ **作    者:
+ ******************************************************************************/
+static void invtd_trie_build_node(invtd_trie_t *trie,
+        const invtd_trie_word_t *word, uint32_t nid, uint32_t lo, uint32_t hi, int depth)
+{
+    uint8_t c;
+    uint32_t i, j, k;
+    invtd_trie_node_t *node = &trie->node[nid];
+
+    node->lo = lo;
+    node->hi = hi;
+
+    /* > 以此结点结束的词项(字典序最小) */
+    if (lo < hi && '\0' == word[lo].word[depth]) {
+        node->is_term = 1;
+        ++lo;
+    }
+
+    /* > 统计子结点数 */
+    for (i=lo; i<hi; i=j) {
+        c = (uint8_t)word[i].word[depth];
+        for (j=i+1; j<hi && (uint8_t)word[j].word[depth] == c; ++j) ;
+        ++node->child_num;
+    }
+
+    node->child = trie->node_num;
+    trie->node_num += node->child_num;
+
+    /* > 构建子结点 */
+    for (k=node->child, i=lo; i<hi; i=j, ++k) {
+        c = (uint8_t)word[i].word[depth];
+        for (j=i+1; j<hi && (uint8_t)word[j].word[depth] == c; ++j) ;
+        trie->node[k].label = c;
+        invtd_trie_build_node(trie, word, k, i, j, depth + 1);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_build
+ **功    能: 构建前缀树
+ **输入参数:
+ **     idx: 评分索引
+ **输出参数: NONE
+ **返    回: 前缀树
+ **实现描述:
+ **     1. 按字典序排列所有关键字
+ **     2. 自根结点递归构建前缀树
+ **     3. 以文档频率构建线段树
+ **注意事项: 调用者须持有读锁; 构建期间不阻塞搜索请求
+ **作    者:
+ ******************************************************************************/
+invtd_trie_t *invtd_trie_build(const invtd_index_t *idx)
+{
+    uint32_t i, max = 1;
+    invtd_trie_t *trie;
+    invtd_trie_node_t *node;
+    invtd_trie_word_t *word = NULL;
+
+    trie = (invtd_trie_t *)calloc(1, sizeof(invtd_trie_t));
+    if (NULL == trie) {
+        return NULL;
+    }
+
+    trie->ctm = time(NULL);
+    trie->update = idx->update;
+    trie->term_num = idx->term_num;
+
+    do {
+        /* > 按字典序排列 */
+        word = (invtd_trie_word_t *)calloc(trie->term_num + 1, sizeof(invtd_trie_word_t));
+        trie->termid = (uint32_t *)calloc(trie->term_num + 1, sizeof(uint32_t));
+        trie->df = (uint32_t *)calloc(trie->term_num + 1, sizeof(uint32_t));
+        if (NULL == word || NULL == trie->termid || NULL == trie->df) {
+            break;
+        }
+
+        for (i=0; i<trie->term_num; ++i) {
+            word[i].word = idx->term[i].word;
+            word[i].termid = i;
+            max += strlen(word[i].word);
+        }
+
+        qsort(word, trie->term_num, sizeof(invtd_trie_word_t), invtd_trie_word_cmp);
+
+        for (i=0; i<trie->term_num; ++i) {
+            trie->termid[i] = word[i].termid;
+            trie->df[i] = idx->term[word[i].termid].num;
+        }
+
+        /* > 构建前缀树(结点数不超过关键字总长+1) */
+        trie->node = (invtd_trie_node_t *)calloc(max, sizeof(invtd_trie_node_t));
+        if (NULL == trie->node) {
+            break;
+        }
+
+        trie->node_num = 1;
+        invtd_trie_build_node(trie, word, 0, 0, trie->term_num, 0);
+
+        node = (invtd_trie_node_t *)realloc(trie->node, trie->node_num * sizeof(invtd_trie_node_t));
+        if (NULL != node) {
+            trie->node = node;
+        }
+
+        /* > 构建线段树 */
+        for (trie->seg_size=1; trie->seg_size<trie->term_num; trie->seg_size<<=1) ;
+
+        trie->seg = (uint32_t *)calloc(2 * trie->seg_size, sizeof(uint32_t));
+        if (NULL == trie->seg) {
+            break;
+        }
+
+        for (i=0; i<trie->seg_size; ++i) {
+            trie->seg[trie->seg_size + i] = (i < trie->term_num)? i : INVTD_TRIE_NONE;
+        }
+        for (i=trie->seg_size-1; i>0; --i) {
+            trie->seg[i] = invtd_trie_better(trie, trie->seg[2*i], trie->seg[2*i + 1]);
+        }
+
+        free(word);
+        return trie;
+    } while (0);
+
+    free(word);
+    invtd_trie_destroy(trie);
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_destroy
+ **功    能: 销毁前缀树
+ **输入参数:
+ **     trie: 前缀树
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+void invtd_trie_destroy(invtd_trie_t *trie)
+{
+    if (NULL == trie) {
+        return;
+    }
+
+    free(trie->seg);
+    free(trie->node);
+    free(trie->df);
+    free(trie->termid);
+    free(trie);
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_argmax
+ **功    能: 查找区间内文档频率最大的位置
+ **输入参数:
+ **     trie: 前缀树
+ **     lo: 起始位置
+ **     hi: 结束位置(不含)
+ **输出参数: NONE
+ **返    回: 文档频率最大的位置
+ **实现描述: 自底向上遍历线段树, O(log n)
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static uint32_t invtd_trie_argmax(const invtd_trie_t *trie, uint32_t lo, uint32_t hi)
+{
+    uint32_t best = INVTD_TRIE_NONE;
+
+    for (lo += trie->seg_size, hi += trie->seg_size; lo < hi; lo >>= 1, hi >>= 1) {
+        if (lo & 1) {
+            best = invtd_trie_better(trie, best, trie->seg[lo++]);
+        }
+        if (hi & 1) {
+            best = invtd_trie_better(trie, best, trie->seg[--hi]);
+        }
+    }
+
+    return best;
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_find
+ **功    能: 查找前缀对应的结点
+ **输入参数:
+ **     trie: 前缀树
+ **     prefix: 前缀
+ **输出参数: NONE
+ **返    回: 结点(不存在时返回NULL)
+ **实现描述: 逐字节在子结点中二分查找
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static const invtd_trie_node_t *invtd_trie_find(const invtd_trie_t *trie, const char *prefix)
+{
+    uint8_t c;
+    uint32_t low, high, mid;
+    const invtd_trie_node_t *node = &trie->node[0];
+
+    for (; '\0' != *prefix; ++prefix) {
+        c = (uint8_t)*prefix;
+        low = node->child;
+        high = node->child + node->child_num;
+        while (low < high) {
+            mid = (low + high) >> 1;
+            if (trie->node[mid].label < c) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        if (low >= node->child + node->child_num || trie->node[low].label != c) {
+            return NULL;
+        }
+        node = &trie->node[low];
+    }
+
+    return node;
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_suggest
+ **功    能: 前缀补全
+ **输入参数:
+ **     trie: 前缀树
+ **     prefix: 前缀
+ **     num: 最多返回的建议数
+ **输出参数:
+ **     item: 建议列表(按文档频率降序)
+ **返    回: 建议数
+ **实现描述:
+ **     1. 定位前缀结点, 得到子树词项在有序词典中的区间
+ **     2. 取区间内文档频率最大者, 并将区间以其为界一分为二放回候选集, 重复num次
+ **注意事项: 代价为O(|prefix| + num * (num + log n)), 与匹配的词项数无关
+ **作    者:
+ ******************************************************************************/
+int invtd_trie_suggest(const invtd_trie_t *trie, const char *prefix, int num, invtd_trie_item_t *item)
+{
+    int i, best, cnt = 0, rnum = 0;
+    const invtd_trie_node_t *node;
+    invtd_trie_range_t range[2 * MESG_SUGGEST_MAX_NUM + 1], curr;
+
+    num = MIN(num, MESG_SUGGEST_MAX_NUM);
+
+    node = invtd_trie_find(trie, prefix);
+    if (NULL == node || node->lo >= node->hi) {
+        return 0;
+    }
+
+    range[rnum].lo = node->lo;
+    range[rnum].hi = node->hi;
+    range[rnum++].pos = invtd_trie_argmax(trie, node->lo, node->hi);
+
+    while (cnt < num && rnum > 0) {
+        /* > 取出候选区间中文档频率最大者 */
+        for (best=0, i=1; i<rnum; ++i) {
+            if (invtd_trie_better(trie, range[best].pos, range[i].pos) == range[i].pos) {
+                best = i;
+            }
+        }
+
+        curr = range[best];
+        range[best] = range[--rnum];
+
+        if (0 == trie->df[curr.pos]) {
+            break; /* 其余词项均已无倒排项(文档被重新索引) */
+        }
+
+        item[cnt].termid = trie->termid[curr.pos];
+        item[cnt++].df = trie->df[curr.pos];
+
+        /* > 拆分区间 */
+        if (curr.lo < curr.pos) {
+            range[rnum].lo = curr.lo;
+            range[rnum].hi = curr.pos;
+            range[rnum++].pos = invtd_trie_argmax(trie, curr.lo, curr.pos);
+        }
+        if (curr.pos + 1 < curr.hi) {
+            range[rnum].lo = curr.pos + 1;
+            range[rnum].hi = curr.hi;
+            range[rnum++].pos = invtd_trie_argmax(trie, curr.pos + 1, curr.hi);
+        }
+    }
+
+    return cnt;
+}
+
+/* 模糊匹配对象 */
+typedef struct
+{
+    const invtd_trie_t *trie;               /* 前缀树 */
+    const uint8_t *word;                    /* 查询词 */
+    int len;                                /* 查询词长度 */
+    int dist;                               /* 最大编辑距离 */
+
+    int num;                                /* 最多返回的匹配数 */
+    int cnt;                                /* 已找到的匹配数 */
+    invtd_trie_item_t *item;                /* 匹配列表(按编辑距离升序, 文档频率降序) */
+
+    uint8_t row[SRCH_WORD_LEN + INVTD_TRIE_FUZZY_MAX + 1][SRCH_WORD_LEN]; /* 各深度的编辑距离行 */
+} invtd_trie_fuzzy_t;
+
+/******************************************************************************
+ **函数名称: invtd_trie_fuzzy_add
+ **功    能: 添加模糊匹配结果
+ **输入参数:
+ **     fuzzy: 模糊匹配对象
+ **     pos: 词项在有序词典中的位置
+ **     dist: 编辑距离
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 按(编辑距离升序, 文档频率降序)插入有序列表, 超出num时淘汰末尾
+ **注意事项: num不超过MESG_SUGGEST_MAX_NUM, 插入排序即可
+ **作    者:
+ ******************************************************************************/
+static void invtd_trie_fuzzy_add(invtd_trie_fuzzy_t *fuzzy, uint32_t pos, int dist)
+{
+    int i;
+    uint32_t df = fuzzy->trie->df[pos];
+    invtd_trie_item_t *item = fuzzy->item;
+
+    if (0 == df) {
+        return; /* 已无倒排项 */
+    }
+
+    for (i=fuzzy->cnt; i>0; --i) {
+        if (item[i-1].dist < (uint32_t)dist
+            || (item[i-1].dist == (uint32_t)dist && item[i-1].df >= df))
+        {
+            break;
+        }
+        if (i < fuzzy->num) {
+            item[i] = item[i-1];
+        }
+    }
+
+    if (i >= fuzzy->num) {
+        return; /* 不优于已有结果 */
+    }
+
+    item[i].termid = fuzzy->trie->termid[pos];
+    item[i].df = df;
+    item[i].dist = dist;
+
+    if (fuzzy->cnt < fuzzy->num) {
+        ++fuzzy->cnt;
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_fuzzy_walk
+ **功    能: 遍历子树并计算编辑距离
+ **输入参数:
+ **     fuzzy: 模糊匹配对象
+ **     node: 当前结点(其编辑距离行为row[depth])
+ **     depth: 结点深度
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 以动态规划逐行模拟Levenshtein自动机: row[depth][j]为该结点对应前缀
+ **     与查询词前j个字节的编辑距离. 行内最小值超过当前上界时, 子树中不可能再有
+ **     满足条件的词项, 直接剪枝.
+ **注意事项: 结果已满时, 上界收紧为末尾结果的编辑距离
+ **作    者:
+ ******************************************************************************/
+static void invtd_trie_fuzzy_walk(invtd_trie_fuzzy_t *fuzzy, const invtd_trie_node_t *node, int depth)
+{
+    uint8_t c, *prev, *row, min, cost, val;
+    uint32_t k;
+    int j, bound;
+    const invtd_trie_t *trie = fuzzy->trie;
+
+    prev = fuzzy->row[depth];
+
+    /* > 以此结点结束的词项 */
+    if (node->is_term && prev[fuzzy->len] <= fuzzy->dist) {
+        invtd_trie_fuzzy_add(fuzzy, node->lo, prev[fuzzy->len]);
+    }
+
+    if (depth + 1 > fuzzy->len + fuzzy->dist) {
+        return; /* 更长的词项编辑距离必然超出上限 */
+    }
+
+    row = fuzzy->row[depth + 1];
+    for (k=node->child; k<node->child+node->child_num; ++k) {
+        c = trie->node[k].label;
+
+        /* > 计算下一行 */
+        row[0] = min = MIN(depth + 1, fuzzy->dist + 1);
+        for (j=1; j<=fuzzy->len; ++j) {
+            cost = (fuzzy->word[j-1] == c)? 0 : 1;
+            val = MIN(prev[j-1] + cost, MIN(prev[j], row[j-1]) + 1);
+            row[j] = MIN(val, fuzzy->dist + 1);
+            min = MIN(min, row[j]);
+        }
+
+        /* > 剪枝 */
+        bound = (fuzzy->cnt == fuzzy->num)? (int)fuzzy->item[fuzzy->num-1].dist : fuzzy->dist;
+        if (min > bound) {
+            continue;
+        }
+
+        invtd_trie_fuzzy_walk(fuzzy, &trie->node[k], depth + 1);
+    }
+}
+
+/******************************************************************************
+ **函数名称: invtd_trie_fuzzy
+ **功    能: 模糊匹配
+ **输入参数:
+ **     trie: 前缀树
+ **     word: 查询词
+ **     dist: 最大编辑距离(1~INVTD_TRIE_FUZZY_MAX)
+ **     num: 最多返回的匹配数
+ **输出参数:
+ **     item: 匹配列表(按编辑距离升序, 文档频率降序)
+ **返    回: 匹配数
+ **实现描述: 以Levenshtein自动机与前缀树求交, 只访问编辑距离可能不超过dist的结点,
+ **     代价与词典规模基本无关
+ **注意事项: 按字节计算编辑距离, 一个多字节字符的替换计为多次编辑
+ **作    者:
+ ******************************************************************************/
+int invtd_trie_fuzzy(const invtd_trie_t *trie, const char *word, int dist, int num, invtd_trie_item_t *item)
+{
+    int j;
+    invtd_trie_fuzzy_t *fuzzy;
+
+    fuzzy = (invtd_trie_fuzzy_t *)calloc(1, sizeof(invtd_trie_fuzzy_t));
+    if (NULL == fuzzy) {
+        return 0;
+    }
+
+    fuzzy->trie = trie;
+    fuzzy->word = (const uint8_t *)word;
+    fuzzy->len = MIN(strlen(word), SRCH_WORD_LEN - 1);
+    fuzzy->dist = MIN(MAX(dist, 0), INVTD_TRIE_FUZZY_MAX);
+    fuzzy->num = MIN(num, MESG_SUGGEST_MAX_NUM);
+    fuzzy->item = item;
+
+    /* > 根结点: 空串与查询词前j个字节的编辑距离为j */
+    for (j=0; j<=fuzzy->len; ++j) {
+        fuzzy->row[0][j] = MIN(j, fuzzy->dist + 1);
+    }
+
+    if (fuzzy->num > 0) {
+        invtd_trie_fuzzy_walk(fuzzy, &trie->node[0], 0);
+    }
+
+    num = fuzzy->cnt;
+
+    free(fuzzy);
+
+    return num;
+}
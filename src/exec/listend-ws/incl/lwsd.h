@@ -7,6 +7,9 @@
 #include "rb_tree.h"
 #include "avl_tree.h"
 #include "lwsd_conf.h"
+#include "lwsd_timer.h"
+#include "mesg_pend.h"
+#include "mesg_suggest.h"
 
 #include <libwebsockets.h>
 
@@ -47,8 +50,12 @@ typedef struct
 
     uint32_t wsi_seq;                       /* WSI序列号(递增) */
     uint32_t req_seq;                       /* REQ序列号(递增) */
+    time_t tm;                              /* 粗粒度时钟(每轮事件循环更新一次) */
+    lwsd_timer_wheel_t *timer;              /* 空闲超时时间轮(仅服务线程访问) */
     struct libwebsocket_context *lws;       /* LWS上下文 */
     rtmq_proxy_t *frwder;                   /* FRWDER服务 */
+    mesg_pend_tab_t *pend;                  /* 在途请求表(核对应答&统计时延) */
+    mesg_suggest_tab_t *suggest;            /* 搜索建议合并表(合并多个后端的建议) */
 } lwsd_cntx_t;
 
 #define LWSD_WSI_SEQ(ctx) (atomic32_inc(&(ctx)->wsi_seq))
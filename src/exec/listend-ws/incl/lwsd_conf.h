@@ -4,6 +4,8 @@
 #include "comm.h"
 #include "rtmq_proxy.h"
 
+#define LWSD_DEADLINE_DEF_TIMEOUT   (5000)  /* 请求默认有效期(毫秒) */
+
 /* LWS配置 */
 typedef struct
 {
@@ -18,6 +20,10 @@ typedef struct
 
     queue_conf_t sendq;                     /* 发送对列 */
 
+    struct {
+        bool enable;                        /* 是否开启WS压缩扩展(deflate-frame等) */
+    } compress;                             /* 压缩配置 */
+
     char key_path[FILE_PATH_MAX_LEN];       /* 键值路径 */
     char cert_path[FILE_PATH_MAX_LEN];      /* 鉴权路径 */
     char resource_path[FILE_PATH_MAX_LEN];  /* 资源路径 */
@@ -35,6 +41,8 @@ typedef struct
         int size;                           /* 单元大小 */
     } distq;                                /* 分发队列 */
 
+    int deadline;                           /* 请求有效期(毫秒, 0:不设置截止时间) */
+
     lws_conf_t lws;                         /* LWS配置 */
     rtmq_proxy_conf_t frwder;               /* FRWDER配置 */
 } lwsd_conf_t;
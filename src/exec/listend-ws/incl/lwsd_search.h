@@ -6,6 +6,8 @@
 #include "libwebsockets.h"
 
 #define LWSD_MARK_STR_LEN   (64)
+#define LWSD_CANCEL_SERIAL_NUM  (8)         /* 断开时可取消的最近请求数 */
+#define LWSD_KICK_GRACE_SEC     (5)         /* 踢下线的宽限期(秒, 期满仍未断开则强制关闭) */
 
 typedef int (*lws_reg_cb_t)(int type, char *data, size_t len, void *param);
 
@@ -22,7 +24,6 @@ typedef struct
 {
     void *addr;                             /* 起始地址 */
     size_t len;                             /* 总字节数 */
-    size_t offset;                          /* 发送字节数 */
 } lwsd_mesg_payload_t;
 
 /* 会话附加信息 */
@@ -32,6 +33,13 @@ typedef struct
     time_t              ctm;                /* 上线时间 */
     time_t              rtm;                /* 最新接收数据的时间 */
     struct libwebsocket *wsi;               /* 所属WSI */
+    bool                is_timeout;         /* 是否已空闲超时(待踢下线) */
+    lwsd_timer_node_t   timer;              /* 空闲超时定时器 */
+
+    /* 最近发出的请求(断开连接时据此取消仍在处理的请求) */
+    int                 serial_idx;         /* 下一个写入位置 */
+    uint64_t            serial[LWSD_CANCEL_SERIAL_NUM]; /* 请求流水号 */
+    time_t              stm[LWSD_CANCEL_SERIAL_NUM]; /* 请求发送时间 */
 
     char mark[LWSD_MARK_STR_LEN];           /* 备注信息 */
     list_t *send_list;                      /* 发送链表 */
@@ -40,6 +48,7 @@ typedef struct
 
 int lwsd_search_reg_add(lwsd_cntx_t *ctx, int type, lws_reg_cb_t proc, void *args);
 int lwsd_search_async_send(lwsd_cntx_t *ctx, uint64_t sid, const void *addr, size_t len);
+int lwsd_search_timeout_hdl(lwsd_timer_node_t *node, time_t now, void *args);
 int lwsd_callback_search_hdl(struct libwebsocket_context *lws,
         struct libwebsocket *wsi, enum libwebsocket_callback_reasons reason,
         void *user, void *in, size_t len);
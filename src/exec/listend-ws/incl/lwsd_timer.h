@@ -0,0 +1,45 @@
+#if !defined(__LWSD_TIMER_H__)
+#define __LWSD_TIMER_H__
+
+#include "comm.h"
+
+/* 时间轮参数(刻度: 秒)
+ *  第一层: 256个槽, 每槽1秒, 覆盖[0, 256)秒
+ *  第二层: 64个槽, 每槽256秒, 覆盖[256, 16384)秒 */
+#define LWSD_TW_L0_BITS     (8)
+#define LWSD_TW_L1_BITS     (6)
+#define LWSD_TW_L0_SIZE     (1 << LWSD_TW_L0_BITS)
+#define LWSD_TW_L1_SIZE     (1 << LWSD_TW_L1_BITS)
+#define LWSD_TW_L0_MASK     (LWSD_TW_L0_SIZE - 1)
+#define LWSD_TW_L1_MASK     (LWSD_TW_L1_SIZE - 1)
+#define LWSD_TW_SPAN        (LWSD_TW_L0_SIZE * LWSD_TW_L1_SIZE)  /* 时间轮最大跨度 */
+
+/* 定时器结点(嵌入到宿主结构中) */
+typedef struct _lwsd_timer_node_t
+{
+    time_t expire;                          /* 超时时间 */
+    struct _lwsd_timer_node_t *prev;        /* 前一结点 */
+    struct _lwsd_timer_node_t *next;        /* 后一结点 */
+} lwsd_timer_node_t;
+
+/* 超时回调(注: 回调前结点已从时间轮中摘除, 可在回调中重新加入) */
+typedef int (*lwsd_timer_cb_t)(lwsd_timer_node_t *node, time_t now, void *args);
+
+/* 分层时间轮 */
+typedef struct
+{
+    time_t curr;                            /* 当前刻度(已处理至此) */
+    int num;                                /* 定时器总数 */
+    lwsd_timer_node_t l0[LWSD_TW_L0_SIZE];  /* 第一层(哨兵结点) */
+    lwsd_timer_node_t l1[LWSD_TW_L1_SIZE];  /* 第二层(哨兵结点) */
+} lwsd_timer_wheel_t;
+
+#define LWSD_TIMER_IS_PENDING(node) (NULL != (node)->next)
+
+lwsd_timer_wheel_t *lwsd_timer_wheel_creat(time_t now);
+void lwsd_timer_wheel_destroy(lwsd_timer_wheel_t *tw);
+void lwsd_timer_add(lwsd_timer_wheel_t *tw, lwsd_timer_node_t *node, time_t expire);
+void lwsd_timer_del(lwsd_timer_wheel_t *tw, lwsd_timer_node_t *node);
+int lwsd_timer_wheel_run(lwsd_timer_wheel_t *tw, time_t now, lwsd_timer_cb_t proc, void *args);
+
+#endif /*__LWSD_TIMER_H__*/
@@ -227,9 +227,17 @@ static lwsd_cntx_t *lwsd_init(const lwsd_opt_t *opt, const lwsd_conf_t *conf, lo
     }
 
     ctx->log = log;
+    ctx->tm = time(NULL);
     memcpy(&ctx->conf, conf, sizeof(lwsd_conf_t));  /* 拷贝配置信息 */
 
     do {
+        /* > 创建空闲超时时间轮 */
+        ctx->timer = lwsd_timer_wheel_creat(ctx->tm);
+        if (NULL == ctx->timer) {
+            log_error(log, "Create timer wheel failed!");
+            break;
+        }
+
         /* > 创建LWS REG表 */
         ctx->lws_reg = avl_creat(NULL, (cmp_cb_t)lwsd_reg_cmp_cb);
         if (NULL == ctx->lws_reg) {
@@ -258,9 +266,26 @@ static lwsd_cntx_t *lwsd_init(const lwsd_opt_t *opt, const lwsd_conf_t *conf, lo
             break;
         }
 
+        /* > 初始化在途请求表 */
+        ctx->pend = mesg_pend_tab_creat(log);
+        if (NULL == ctx->pend) {
+            log_error(log, "Create pend table failed!");
+            break;
+        }
+
+        /* > 初始化搜索建议合并表 */
+        ctx->suggest = mesg_suggest_tab_creat();
+        if (NULL == ctx->suggest) {
+            log_error(log, "Create suggest table failed!");
+            break;
+        }
+
         return ctx;
     } while (0);
 
+    if (NULL != ctx->timer) {
+        lwsd_timer_wheel_destroy(ctx->timer);
+    }
     FREE(ctx);
     return NULL;
 }
@@ -285,7 +310,10 @@ static int lwsd_set_reg(lwsd_cntx_t *ctx)
     }
 
     LWSD_LWS_REG_CB(ctx, MSG_SEARCH_REQ, lwsd_search_req_hdl, ctx);
-    LWSD_LWS_REG_CB(ctx, MSG_INSERT_WORD_REQ, lwsd_insert_word_req_hdl, ctx);
+    LWSD_LWS_REG_CB(ctx, MSG_INSERT_WORD_REQ, lwsd_mesg_forward_hdl, ctx);
+    LWSD_LWS_REG_CB(ctx, MSG_SUGGEST_REQ, lwsd_suggest_req_hdl, ctx);
+    LWSD_LWS_REG_CB(ctx, MSG_INDEX_DOC_REQ, lwsd_mesg_forward_hdl, ctx);
+    LWSD_LWS_REG_CB(ctx, MSG_SET_DOC_SCORE_REQ, lwsd_mesg_forward_hdl, ctx);
 
 #define LWSD_RTQ_REG_CB(lsnd, type, proc, args) /* 注册队列数据回调 */\
     if (rtmq_proxy_reg_add((lsnd)->frwder, type, (rtmq_reg_cb_t)proc, (void *)args)) { \
@@ -294,7 +322,11 @@ static int lwsd_set_reg(lwsd_cntx_t *ctx)
     }
 
     LWSD_RTQ_REG_CB(ctx, MSG_SEARCH_RSP, lwsd_search_rsp_hdl, ctx);
-    LWSD_RTQ_REG_CB(ctx, MSG_INSERT_WORD_RSP, lwsd_insert_word_rsp_hdl, ctx);
+    LWSD_RTQ_REG_CB(ctx, MSG_INSERT_WORD_RSP, lwsd_mesg_relay_hdl, ctx);
+    LWSD_RTQ_REG_CB(ctx, MSG_SUGGEST_RSP, lwsd_suggest_rsp_hdl, ctx);
+    LWSD_RTQ_REG_CB(ctx, MSG_INDEX_DOC_RSP, lwsd_mesg_relay_hdl, ctx);
+    LWSD_RTQ_REG_CB(ctx, MSG_SET_DOC_SCORE_RSP, lwsd_mesg_relay_hdl, ctx);
+    LWSD_RTQ_REG_CB(ctx, MSG_BATCH_MESG, lwsd_batch_mesg_hdl, ctx);
 
     return LWSD_OK;
 }
@@ -349,9 +381,15 @@ static int lwsd_lws_launch(lwsd_cntx_t *ctx)
          * the number of ms in the second argument.
          */
         n = libwebsocket_service(lws, 50);
+
+        /* > 更新粗粒度时钟, 并处理空闲超时连接 */
+        ctx->tm = time(NULL);
+        lwsd_timer_wheel_run(ctx->timer, ctx->tm, lwsd_search_timeout_hdl, (void *)ctx);
     }
 
     libwebsocket_context_destroy(lws);
+    lwsd_timer_wheel_destroy(ctx->timer); /* 须在销毁LWS之后(销毁连接时会摘除定时器) */
+    ctx->timer = NULL;
     lwsl_notice("lws-access exited cleanly\n");
     closelog();
     return 0;
@@ -429,7 +467,9 @@ static int lwsd_lws_get_attr(const lwsd_opt_t *opt,
     info->iface = conf->iface;
     info->protocols = g_lwsd_protocols; // 设置协议回调
 #if !defined(LWS_NO_EXTENSIONS)
-    info->extensions = libwebsocket_get_internal_extensions();
+    if (conf->compress.enable) {
+        info->extensions = libwebsocket_get_internal_extensions(); // 协商压缩扩展
+    }
 #endif /*LWS_NO_EXTENSIONS*/
 
     if (!conf->is_use_ssl) {
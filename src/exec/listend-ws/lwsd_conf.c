@@ -7,6 +7,7 @@
  **         负责从代理服务配置文件(lsnd.xml)中提取有效信息
  ** 作  者: # Qifeng.zou # 2014.10.28 #
  ******************************************************************************/
+#include "cmd.h"
 #include "xml_tree.h" 
 #include "lwsd_conf.h"
 
@@ -145,6 +146,18 @@ static int lwsd_conf_load_comm(xml_tree_t *xml, lwsd_conf_t *conf, log_cycle_t *
 
     conf->distq.size = str_to_num(node->value.str);
 
+    /* > 请求有效期(可选) */
+    conf->deadline = LWSD_DEADLINE_DEF_TIMEOUT;
+
+    node = xml_query(xml, ".LISTEND.DEADLINE.TIMEOUT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->deadline = str_to_num(node->value.str);
+        if (conf->deadline < 0 || conf->deadline > MESG_DEADLINE_MAX) {
+            log_error(log, "Deadline timeout is invalid! timeout:%d", conf->deadline);
+            return -1;
+        }
+    }
+
     return 0;
 }
 
@@ -320,6 +333,42 @@ static int lwsd_conf_parse_lws_path(xml_tree_t *xml, lws_conf_t *conf, log_cycle
     return 0;
 }
 
+/******************************************************************************
+ **函数名称: lwsd_conf_parse_lws_compress
+ **功    能: 加载压缩配置
+ **输入参数: 
+ **     xml: 配置树
+ **     log: 日志对象
+ **输出参数:
+ **     conf: 配置信息
+ **返    回: 0:成功 !0:失败
+ **实现描述: 提取配置文件中的数据
+ **注意事项:
+ **     1. COMPRESS标签可选, 未配置时不开启压缩
+ **     2. 压缩级别由libwebsockets编译期决定, 此处只控制是否协商压缩扩展
+ **作    者:
+ ******************************************************************************/
+static int lwsd_conf_parse_lws_compress(xml_tree_t *xml, lws_conf_t *conf, log_cycle_t *log)
+{
+    xml_node_t *node, *fix;
+
+    conf->compress.enable = false;
+
+    /* > 定位压缩标签 */
+    fix = xml_query(xml, ".LISTEND.LWS.COMPRESS");
+    if (NULL == fix) {
+        return 0;
+    }
+
+    /* > 获取开关 */
+    node = xml_search(xml, fix, "ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        conf->compress.enable = true;
+    }
+
+    return 0;
+}
+
 /******************************************************************************
  **函数名称: lwsd_conf_load_lws
  **功    能: 加载LWS配置
@@ -371,6 +420,12 @@ static int lwsd_conf_load_lws(xml_tree_t *xml, lwsd_conf_t *lcf, log_cycle_t *lo
         return -1;
     }
 
+    /* > 加载压缩配置 */
+    if (lwsd_conf_parse_lws_compress(xml, conf, log)) {
+        log_error(log, "Parse compress of lws configuration failed!");
+        return -1;
+    }
+
     return 0;
 }
 
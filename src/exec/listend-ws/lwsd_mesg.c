@@ -11,6 +11,7 @@
 #include "lwsd.h"
 #include "lwsd_mesg.h"
 #include "lwsd_search.h"
+#include "mesg_zip.h"
 
 /******************************************************************************
  **函数名称: lwsd_search_req_hdl
@@ -23,21 +24,49 @@
  **输出参数:
  **返    回: 0:成功 !0:失败
  **实现描述: 请求数据的内存结构: 流水信息 + 消息头 + 消息体
- **注意事项: 需要将协议头转换为网络字节序
+ **注意事项:
+ **     1. 需要将协议头转换为网络字节序
+ **     2. 客户端未指定截止时间时按配置设置, 已超时的请求直接丢弃
+ **     3. 转发前登记在途请求, 以便核对应答
  **作    者: # Qifeng.zou # 2015.05.28 23:11:54 #
  ******************************************************************************/
 int lwsd_search_req_hdl(unsigned int type, void *data, int length, void *args)
 {
+    uint64_t serial;
     lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
     mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
 
     log_debug(ctx->log, "serial:%lu length:%d body:%s!", head->serial, length, head->body);
 
+    /* > 设置截止时间 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! serial:%lu", head->serial);
+        return 0;
+    }
+    else if (!(head->flag & MESG_FLAG_DEADLINE) && ctx->conf.deadline > 0) {
+        head->flag = MESG_DEADLINE_SET(head->flag, ctx->conf.deadline);
+    }
+
+    /* > 登记在途请求 */
+    serial = head->serial;
+    if (mesg_pend_add(ctx->pend, serial, head->sid, (head->flag & MESG_FLAG_DEADLINE)?
+            MESG_DEADLINE_LEFT(head->flag) : MESG_DEADLINE_MAX))
+    {
+        log_error(ctx->log, "Pend table is full! sid:%lu serial:%lu", head->sid, serial);
+        return -1;
+    }
+
     /* > 转换字节序 */
     MESG_HEAD_HTON(head, head);
 
     /* > 转发搜索请求 */
-    return rtmq_proxy_async_send(ctx->frwder, type, data, length);
+    if (rtmq_proxy_async_send(ctx->frwder, type, data, length)) {
+        mesg_pend_del(ctx->pend, serial);
+        log_error(ctx->log, "Push search request failed! serial:%lu", serial);
+        return -1;
+    }
+
+    return 0;
 }
 
 /******************************************************************************
@@ -52,57 +81,165 @@ int lwsd_search_req_hdl(unsigned int type, void *data, int length, void *args)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
- **注意事项:
+ **注意事项: 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
  **作    者: # Qifeng.zou # 2015.06.10 #
  ******************************************************************************/
 int lwsd_search_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int ret;
+    mesg_header_t *rsp;
     lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
     mesg_header_t *head = (mesg_header_t *)data;
 
     /* > 转化字节序 */
     MESG_HEAD_NTOH(head, head);
 
-    log_trace(ctx->log, "body:%s", head->body);
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, head->serial, head->sid, head->flag, NULL)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", head->sid, head->serial);
+        return 0;
+    }
 
-    return lwsd_search_async_send(ctx, head->sid, data, len);
+    if (!(head->flag & MESG_FLAG_ZIP)) {
+        log_trace(ctx->log, "body:%s", head->body);
+        return lwsd_search_async_send(ctx, head->sid, data, len);
+    }
+
+    /* > 解压报体(WS链路压缩由permessage-deflate负责) */
+    rsp = mesg_unzip(head, head->body, &len, ctx->log);
+    if (NULL == rsp) {
+        return -1;
+    }
+
+    log_trace(ctx->log, "body:%s", rsp->body);
+
+    ret = lwsd_search_async_send(ctx, rsp->sid, rsp, len);
+
+    free(rsp);
+
+    return ret;
 }
 
 /******************************************************************************
- **函数名称: lwsd_insert_word_req_hdl
- **功    能: 插入关键字的处理函数
+ **函数名称: lwsd_mesg_forward
+ **功    能: 登记在途请求并转发至转发层
  **输入参数:
- **     type: 全局对象
+ **     ctx: 全局对象
+ **     type: 消息类型
+ **     data: 请求数据(报头为主机字节序)
+ **     length: 数据长度(报头 + 报体)
+ **     timeout: 在途请求的超时时间(毫秒)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 登记在途请求 > 转换报头字节序 > 转发; 转发失败时撤销在途请求
+ **注意事项: 报头被原地转换为网络字节序, 报体原样转发
+ **作    者:
+ ******************************************************************************/
+static int lwsd_mesg_forward(lwsd_cntx_t *ctx,
+        unsigned int type, void *data, int length, int timeout)
+{
+    uint64_t serial;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
+
+    /* > 登记在途请求 */
+    serial = head->serial;
+    if (mesg_pend_add(ctx->pend, serial, head->sid, timeout)) {
+        log_error(ctx->log, "Pend table is full! type:%u sid:%lu serial:%lu", type, head->sid, serial);
+        return -1;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_HTON(head, head);
+
+    if (rtmq_proxy_async_send(ctx->frwder, type, data, length)) {
+        mesg_pend_del(ctx->pend, serial);
+        log_error(ctx->log, "Push request failed! type:%u serial:%lu", type, serial);
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: lwsd_index_doc_too_large
+ **功    能: 拒绝过大的文档索引请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     head: 请求报头(主机字节序)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 应答码为MESG_INDEX_DOC_TOO_LARGE, 并带回请求中的URL; 应答报头保持主机字节序(与其他应答一致)
+ **注意事项: 超过FRWDER.SENDQ.SIZE的请求无法放入发送队列, 若不显式拒绝, 客户端只能等到超时
+ **作    者:
+ ******************************************************************************/
+static int lwsd_index_doc_too_large(lwsd_cntx_t *ctx, const mesg_header_t *head)
+{
+    int len;
+    mesg_header_t *rsp;
+    mesg_index_doc_rsp_t *body;
+    const mesg_index_doc_req_t *req = (const mesg_index_doc_req_t *)(head + 1);
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_index_doc_rsp_t)];
+
+    memset(addr, 0, sizeof(addr));
+
+    rsp = (mesg_header_t *)addr;
+    body = (mesg_index_doc_rsp_t *)(rsp + 1);
+
+    body->code = MESG_INDEX_DOC_TOO_LARGE;
+    memcpy(body->url, req->url, sizeof(body->url));
+    mesg_index_doc_rsp_hton(body);
+
+    len = sizeof(mesg_index_doc_rsp_t);
+
+    MESG_HEAD_SET(rsp, MSG_INDEX_DOC_RSP, head->sid, head->nid, head->serial, len);
+
+    return lwsd_search_async_send(ctx, head->sid, addr, MESG_TOTAL_LEN(len));
+}
+
+/******************************************************************************
+ **函数名称: lwsd_mesg_forward_hdl
+ **功    能: 转发类请求的处理函数(插入关键字/文档索引/设置静态得分)
+ **输入参数:
+ **     type: 消息类型
  **     data: 数据内容
- **     length: 数据长度
+ **     length: 数据长度(报头 + 报体)
  **     args: 附加参数
  **输出参数:
  **返    回: 0:成功 !0:失败
- **实现描述: 请求数据的内存结构: 流水信息 + 消息头 + 消息体
- **注意事项: 需要将协议头转换为网络字节序
- **作    者: # Qifeng.zou # 2015.06.17 21:34:49 #
+ **实现描述: 校验报体长度后登记在途请求, 原样转发至转发层(由转发层按类型路由)
+ **注意事项:
+ **     1. 报体原样转发, 由倒排服务解析
+ **     2. 文档索引请求超过FRWDER.SENDQ.SIZE时, 直接回复MESG_INDEX_DOC_TOO_LARGE
+ **作    者:
  ******************************************************************************/
-int lwsd_insert_word_req_hdl(unsigned int type, void *data, int length, void *args)
+int lwsd_mesg_forward_hdl(unsigned int type, void *data, int length, void *args)
 {
-    mesg_header_t *head;
-    mesg_insert_word_req_t *req;
+    size_t min;
     lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
 
-    head = (mesg_header_t *)data; // 消息头
-    req = (mesg_insert_word_req_t *)(head + 1);
+    min = mesg_forward_body_min(type);
+    if (0 == min || length < (int)MESG_TOTAL_LEN(min)) {
+        log_error(ctx->log, "Request is invalid! type:%u length:%d", type, length);
+        return -1;
+    }
 
-    log_debug(ctx->log, "serial:%lu word:%s url:%s freq:%d",
-            head->serial, req->word, req->url, ntohl(req->freq));
+    log_debug(ctx->log, "type:%u sid:%lu serial:%lu length:%d",
+            type, head->sid, head->serial, length);
 
-    /* > 转换字节序 */
-    MESG_HEAD_HTON(head, head);
+    /* > 拒绝过大的文档 */
+    if (MSG_INDEX_DOC_REQ == type && length > ctx->conf.frwder.sendq.size) {
+        log_warn(ctx->log, "Document is too large! serial:%lu length:%d max:%d",
+                head->serial, length, ctx->conf.frwder.sendq.size);
+        return lwsd_index_doc_too_large(ctx, head);
+    }
 
-    return rtmq_proxy_async_send(ctx->frwder, type, data, length);
+    return lwsd_mesg_forward(ctx, type, data, length, MESG_DEADLINE_MAX);
 }
 
 /******************************************************************************
- **函数名称: lwsd_search_rsp_hdl
- **功    能: 插入关键字的应答
+ **函数名称: lwsd_mesg_relay_hdl
+ **功    能: 转发类请求的应答处理函数(插入关键字/文档索引/设置静态得分)
  **输入参数:
  **     type: 数据类型
  **     orig: 源结点ID
@@ -111,21 +248,187 @@ int lwsd_insert_word_req_hdl(unsigned int type, void *data, int length, void *ar
  **     args: 附加参数
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 核对在途请求后回送给客户端(报头为主机字节序)
  **注意事项:
- **作    者: # Qifeng.zou # 2015.06.10 #
+ **     1. 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
+ **     2. 写请求被转发层发给所属分区的所有副本, 只在收齐各副本的应答后回送一次
+ **作    者:
  ******************************************************************************/
-int lwsd_insert_word_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
+int lwsd_mesg_relay_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    bool is_done;
     lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
     mesg_header_t *head = (mesg_header_t *)data;
-    mesg_insert_word_rsp_t *rsp = (mesg_insert_word_rsp_t *)(head + 1);
 
-    log_debug(ctx->log, "type:%d len:%d word:%s", type, len, rsp->word);
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, head);
+
+    log_debug(ctx->log, "type:%d len:%lu sid:%lu serial:%lu", type, len, head->sid, head->serial);
+
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, head->serial, head->sid, head->flag, &is_done)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", head->sid, head->serial);
+        return 0;
+    }
+    else if (!is_done) {
+        return 0; /* 等待其他副本的应答 */
+    }
+
+    /* > 放入发送队列 */
+    return lwsd_search_async_send(ctx, head->sid, data, len);
+}
+
+/******************************************************************************
+ **函数名称: lwsd_suggest_req_hdl
+ **功    能: 搜索建议请求的处理函数
+ **输入参数:
+ **     type: 全局对象
+ **     data: 数据内容
+ **     length: 数据长度(报头 + 报体)
+ **     args: 附加参数
+ **输出参数:
+ **返    回: 0:成功 !0:失败
+ **实现描述: 设置截止时间并登记合并项后, 转发至转发层(与搜索请求同路由)
+ **注意事项: 合并项须在转发前登记, 否则可能错过先到的应答
+ **作    者:
+ ******************************************************************************/
+int lwsd_suggest_req_hdl(unsigned int type, void *data, int length, void *args)
+{
+    uint64_t serial;
+    lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
+    mesg_suggest_req_t *req = (mesg_suggest_req_t *)(head + 1);
+
+    if (length < (int)MESG_TOTAL_LEN(sizeof(mesg_suggest_req_t))) {
+        log_error(ctx->log, "Suggest request is too short! length:%d", length);
+        return -1;
+    }
+
+    log_debug(ctx->log, "serial:%lu prefix:%.*s num:%u",
+            head->serial, (int)sizeof(req->prefix), req->prefix, ntohl(req->num));
+
+    /* > 设置截止时间 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! serial:%lu", head->serial);
+        return 0;
+    }
+    else if (!(head->flag & MESG_FLAG_DEADLINE) && ctx->conf.deadline > 0) {
+        head->flag = MESG_DEADLINE_SET(head->flag, ctx->conf.deadline);
+    }
+
+    /* > 登记合并项并转发 */
+    serial = head->serial;
+    mesg_suggest_add(ctx->suggest, serial, ntohl(req->num));
+
+    if (lwsd_mesg_forward(ctx, type, data, length, (head->flag & MESG_FLAG_DEADLINE)?
+            MESG_DEADLINE_LEFT(head->flag) : MESG_DEADLINE_MAX))
+    {
+        mesg_suggest_del(ctx->suggest, serial);
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: lwsd_suggest_rsp_hdl
+ **功    能: 搜索建议的应答
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 需要转发的数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 核对在途请求, 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
+ **     2. 请求被分发至多个后端时, 暂存各后端的建议, 收齐后按文档频率合并再发送
+ **注意事项: 各后端只返回本地前N个建议, 合并结果与全局前N个可能略有差异
+ **作    者:
+ ******************************************************************************/
+int lwsd_suggest_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    int ret;
+    bool is_done;
+    lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data, *rsp;
 
     /* > 转换字节序 */
     MESG_HEAD_NTOH(head, head);
 
+    log_debug(ctx->log, "type:%d len:%lu serial:%lu", type, len, head->serial);
+
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, head->serial, head->sid, head->flag, &is_done)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", head->sid, head->serial);
+        return 0;
+    }
+
+    /* > 合并各后端的建议 */
+    ret = mesg_suggest_merge(ctx->suggest, head, head->body, is_done, &rsp);
+    if (MESG_SUGGEST_WAIT == ret) {
+        return 0; /* 等待其他后端的应答 */
+    }
+    else if (MESG_SUGGEST_DONE == ret) {
+        ret = lwsd_search_async_send(ctx, head->sid, rsp, MESG_TOTAL_LEN(rsp->length));
+        free(rsp);
+        return ret;
+    }
+
     /* > 放入发送队列 */
     return lwsd_search_async_send(ctx, head->sid, data, len);
 }
+
+/******************************************************************************
+ **函数名称: lwsd_batch_mesg_hdl
+ **功    能: 批量消息的处理
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 批量消息(报头 + 消息1 + 消息2 + ...)
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 逐条拆出消息, 按消息类型交由对应的应答处理函数
+ **注意事项: 各消息的报头均为网络字节序; 长度异常时丢弃剩余消息
+ **作    者:
+ ******************************************************************************/
+int lwsd_batch_mesg_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    int num = 0;
+    size_t off, total;
+    mesg_header_t *mesg;
+    lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
+
+    for (off=sizeof(mesg_header_t); off + sizeof(mesg_header_t) <= len; off += total, ++num) {
+        mesg = (mesg_header_t *)(data + off);
+        total = MESG_TOTAL_LEN(MESG_NHEAD_LENGTH(mesg));
+        if (off + total > len) {
+            log_error(ctx->log, "Batch message is corrupted! orig:%d off:%lu len:%lu", orig, off, len);
+            return -1;
+        }
+
+        switch (MESG_NHEAD_TYPE(mesg)) {
+            case MSG_SEARCH_RSP:
+                lwsd_search_rsp_hdl(MSG_SEARCH_RSP, orig, (char *)mesg, total, args);
+                break;
+            case MSG_SUGGEST_RSP:
+                lwsd_suggest_rsp_hdl(MSG_SUGGEST_RSP, orig, (char *)mesg, total, args);
+                break;
+            case MSG_INSERT_WORD_RSP:
+            case MSG_INDEX_DOC_RSP:
+            case MSG_SET_DOC_SCORE_RSP:
+                lwsd_mesg_relay_hdl(MESG_NHEAD_TYPE(mesg), orig, (char *)mesg, total, args);
+                break;
+            default:
+                log_error(ctx->log, "Unknown message type in batch! type:%u", MESG_NHEAD_TYPE(mesg));
+                break;
+        }
+    }
+
+    log_trace(ctx->log, "Batch message! orig:%d num:%d len:%lu", orig, num, len);
+
+    return 0;
+}
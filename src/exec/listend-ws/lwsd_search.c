@@ -1,3 +1,4 @@
+#include "cmd.h"
 #include "comm.h"
 #include "redo.h"
 #include "lwsd.h"
@@ -8,6 +9,7 @@
 static int lwsd_search_wsi_user_init(lwsd_cntx_t *ctx,
         struct libwebsocket *wsi, lwsd_search_user_data_t *user);
 static int lwsd_search_wsi_destroy(lwsd_cntx_t *ctx, lwsd_search_user_data_t *user);
+static int lwsd_search_cancel(lwsd_cntx_t *ctx, lwsd_search_user_data_t *user);
 static int lwsd_search_cmd_hdl(lwsd_cntx_t *ctx,
         struct libwebsocket_context *lws, struct libwebsocket *wsi,
         lwsd_search_user_data_t *user, void *in, size_t len);
@@ -142,8 +144,9 @@ static int lwsd_search_wsi_user_init(lwsd_cntx_t *ctx,
     lwsd_conf_t *conf = &ctx->conf;
 
     /* > 初始化数据 */
-    user->ctm = time(NULL);
+    user->ctm = ctx->tm;
     user->rtm = user->ctm;
+    user->is_timeout = false;
     user->sid = tlz_gen_sid(conf->nid, 0, LWSD_WSI_SEQ(ctx));
     user->wsi = wsi;
     snprintf(user->mark, sizeof(user->mark), "SEARCH");
@@ -173,6 +176,9 @@ static int lwsd_search_wsi_user_init(lwsd_cntx_t *ctx,
         return -1;
     }
 
+    /* > 加入空闲超时时间轮 */
+    lwsd_timer_add(ctx->timer, &user->timer, user->rtm + conf->lws.connections.timeout);
+
     log_debug(ctx->log, "Insert wsi map success! sid:%lu", user->sid);
 
     return 0;
@@ -219,6 +225,12 @@ static int lwsd_search_wsi_destroy(lwsd_cntx_t *ctx, lwsd_search_user_data_t *us
         user->pl = NULL;
     }
 
+    /* > 取消仍在处理的请求 */
+    lwsd_search_cancel(ctx, user);
+
+    /* > 移除空闲超时定时器 */
+    lwsd_timer_del(ctx->timer, &user->timer);
+
     /* > 查找&清理wsi映射表 */
     key.sid = user->sid;
 
@@ -230,6 +242,64 @@ static int lwsd_search_wsi_destroy(lwsd_cntx_t *ctx, lwsd_search_user_data_t *us
     return lwsd_search_wsi_user_free(ctx, user);
 }
 
+/******************************************************************************
+ **函数名称: lwsd_search_cancel
+ **功    能: 取消会话仍在处理的请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     user: WS实例附加数据
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 将截止时间内发出的请求流水号通过MSG_CANCEL_REQ通知转发服务,
+ **          由转发服务和倒排服务丢弃尚未处理完成的请求; 同时删除本地在途请求,
+ **          此后到达的应答作为孤儿应答丢弃
+ **注意事项: 取消请求无应答; 已处理完成的请求被取消时, 对端直接忽略
+ **作    者:
+ ******************************************************************************/
+static int lwsd_search_cancel(lwsd_cntx_t *ctx, lwsd_search_user_data_t *user)
+{
+    int idx, num = 0;
+    mesg_header_t *head;
+    mesg_cancel_req_t *req;
+    lwsd_conf_t *conf = &ctx->conf;
+    time_t expire = (conf->deadline? conf->deadline : MESG_DEADLINE_MAX) / 1000 + 1;
+    char addr[sizeof(mesg_header_t) + MESG_CANCEL_REQ_LEN(LWSD_CANCEL_SERIAL_NUM)];
+
+    head = (mesg_header_t *)addr;
+    req = (mesg_cancel_req_t *)(head + 1);
+
+    for (idx=0; idx<LWSD_CANCEL_SERIAL_NUM; ++idx) {
+        if (0 == user->serial[idx]
+            || ctx->tm - user->stm[idx] > expire)
+        {
+            continue; /* 已超过截止时间的请求无需取消 */
+        }
+        mesg_pend_del(ctx->pend, user->serial[idx]);
+        req->serial[num++] = user->serial[idx];
+    }
+
+    if (0 == num) {
+        return 0;
+    }
+
+    req->num = num;
+
+    MESG_HEAD_SET(head, MSG_CANCEL_REQ, user->sid, conf->nid, 0, MESG_CANCEL_REQ_LEN(num));
+    MESG_HEAD_HTON(head, head);
+    mesg_cancel_req_hton(req);
+
+    if (rtmq_proxy_async_send(ctx->frwder, MSG_CANCEL_REQ,
+            (void *)addr, sizeof(mesg_header_t) + MESG_CANCEL_REQ_LEN(num)))
+    {
+        log_error(ctx->log, "Send cancel request failed! sid:%lu num:%d", user->sid, num);
+        return -1;
+    }
+
+    log_debug(ctx->log, "Send cancel request success! sid:%lu num:%d", user->sid, num);
+
+    return 0;
+}
+
 /******************************************************************************
  **函数名称: lwsd_search_cmd_hdl
  **功    能: 对SEARCH协议命令的处理
@@ -253,7 +323,7 @@ static int lwsd_search_cmd_hdl(lwsd_cntx_t *ctx,
     lwsd_conf_t *conf = &ctx->conf;
     mesg_header_t *head = (mesg_header_t *)in;
 
-    user->rtm = time(NULL);
+    user->rtm = ctx->tm;
 
     /* > 字节序转换 */
     MESG_HEAD_NTOH(head, head);
@@ -275,6 +345,11 @@ static int lwsd_search_cmd_hdl(lwsd_cntx_t *ctx,
         return -1;
     }
 
+    /* > 记录请求流水号(断开连接时用于取消) */
+    user->serial[user->serial_idx] = head->serial;
+    user->stm[user->serial_idx] = ctx->tm;
+    user->serial_idx = (user->serial_idx + 1) % LWSD_CANCEL_SERIAL_NUM;
+
     return reg->proc(head->type, in, len, reg->args);
 }
 
@@ -297,13 +372,12 @@ static int lwsd_search_send_data(lwsd_cntx_t *ctx,
         struct libwebsocket *wsi, lwsd_search_user_data_t *user)
 {
     int n;
-    size_t left, m;
-    time_t tm = time(NULL), diff;
-    enum lws_write_protocol protocol;
+    size_t m, len;
+    time_t diff;
     lws_conf_t *conf = &ctx->conf.lws;
 
-    diff = tm - user->rtm;
-    if (diff > conf->connections.timeout) {
+    diff = ctx->tm - user->rtm;
+    if (user->is_timeout || diff > conf->connections.timeout) {
         log_error(ctx->log, "Connection is timeout! sid:%u ctm:%lu diff:%lu mark:%s",
                 user->sid, user->ctm, diff, user->mark);
         return -1; /* 强制踢下线 */
@@ -324,23 +398,23 @@ static int lwsd_search_send_data(lwsd_cntx_t *ctx,
             }
         }
 
-        left = user->pl->len - user->pl->offset;
+        /* > 对端窗口不足以容纳整帧时, 等待下次可写事件 */
+        if ((size_t)-1 != m && m < user->pl->len) {
+            break;
+        }
 
-        /* > 发送数据 */
-        protocol = (left != user->pl->len)? LWS_WRITE_HTTP : LWS_WRITE_BINARY;
+        /* > 发送数据(注: 每条消息独立成帧, 未发完部分由LWS缓存并续发) */
+        len = user->pl->len;
 
         n = lws_write(wsi, (unsigned char *)user->pl->addr
-                + user->pl->offset + LWS_SEND_BUFFER_PRE_PADDING, left, protocol);
-        if (n < 0) {
+                + LWS_SEND_BUFFER_PRE_PADDING, len, LWS_WRITE_BINARY);
+
+        mem_dealloc(NULL, user->pl); /* 释放空间 */
+        user->pl = NULL;
+
+        if (n < (int)len) {
             log_error(ctx->log, "Send data failed! n:%d", n);
-            mem_dealloc(NULL, user->pl); /* 释放空间 */
-            user->pl = NULL;
             return -1;
-        } else if (n != (int)left) {
-            user->pl->offset += n;
-        } else {
-            mem_dealloc(NULL, user->pl); /* 释放空间 */
-            user->pl = NULL;
         }
     } while(!lws_send_pipe_choked(wsi));
 
@@ -349,6 +423,57 @@ static int lwsd_search_send_data(lwsd_cntx_t *ctx,
     return 0;
 }
 
+/******************************************************************************
+ **函数名称: lwsd_search_timeout_hdl
+ **功    能: 空闲超时处理
+ **输入参数:
+ **     node: 定时器结点
+ **     now: 当前时间
+ **     args: 全局对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 期间有数据交互时, 按最新接收时间重新加入时间轮(惰性续期)
+ **     2. 确已超时时, 设置超时标识并触发可写事件, 由可写回调返回-1踢下线
+ **     3. 对端不读数据时可写事件可能永远不会触发, 因此踢下线时以宽限期重新加入
+ **        时间轮, 宽限期满仍未断开时直接关闭套接字, 由LWS按断开流程回收连接
+ **注意事项: 收包时只更新rtm, 不操作时间轮, 从而保证收包路径O(1)且无额外开销
+ **作    者:
+ ******************************************************************************/
+int lwsd_search_timeout_hdl(lwsd_timer_node_t *node, time_t now, void *args)
+{
+    lwsd_cntx_t *ctx = (lwsd_cntx_t *)args;
+    lws_conf_t *conf = &ctx->conf.lws;
+    lwsd_search_user_data_t *user = (lwsd_search_user_data_t *)
+        ((char *)node - offsetof(lwsd_search_user_data_t, timer));
+
+    /* > 宽限期满仍未断开: 强制关闭 */
+    if (user->is_timeout) {
+        log_error(ctx->log, "Connection is still alive after kicked! sid:%lu ctm:%lu rtm:%lu mark:%s",
+                user->sid, user->ctm, user->rtm, user->mark);
+
+        shutdown(libwebsocket_get_socket_fd(user->wsi), SHUT_RDWR);
+        lwsd_timer_add(ctx->timer, node, now + LWSD_KICK_GRACE_SEC);
+        return 0;
+    }
+
+    /* > 期间有数据交互: 续期 */
+    if (user->rtm + conf->connections.timeout > now) {
+        lwsd_timer_add(ctx->timer, node, user->rtm + conf->connections.timeout);
+        return 0;
+    }
+
+    /* > 确已超时: 踢下线 */
+    log_debug(ctx->log, "Connection is idle timeout! sid:%lu ctm:%lu rtm:%lu mark:%s",
+            user->sid, user->ctm, user->rtm, user->mark);
+
+    user->is_timeout = true;
+    lws_callback_on_writable(ctx->lws, user->wsi);
+    lwsd_timer_add(ctx->timer, node, now + LWSD_KICK_GRACE_SEC);
+
+    return 0;
+}
+
 /******************************************************************************
  **函数名称: lwsd_search_async_send
  **功    能: 将数据放入发送链表
@@ -397,11 +522,10 @@ int lwsd_search_async_send(lwsd_cntx_t *ctx, uint64_t sid, const void *addr, siz
         return -1;
     }
 
-    pl = (lwsd_mesg_payload_t *)item;
+    pl = (lwsd_mesg_payload_t *)data;
     pl->addr = (void *)(pl + 1);
     memcpy(pl->addr + LWS_SEND_BUFFER_PRE_PADDING, addr, len);
     pl->len = len;
-    pl->offset = 0;
 
     if (list_rpush(user->send_list, data)) {
         log_error(ctx->log, "Push data into send list failed! sid:%lu", user->sid);
@@ -0,0 +1,214 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: lwsd_timer.c
+ ** 版本号: 1.0
+ ** 描  述: 分层时间轮
+ **         用于管理海量连接的空闲超时, 插入/删除O(1), 超时处理均摊O(1).
+ ** 作  者:
+ ******************************************************************************/
+#include "lwsd_timer.h"
+
+/* 将结点挂入链表尾部 */
+#define LWSD_TIMER_LINK(head, node) do { \
+    (node)->prev = (head)->prev; \
+    (node)->next = (head); \
+    (head)->prev->next = (node); \
+    (head)->prev = (node); \
+} while(0)
+
+/* 将结点从链表中摘除 */
+#define LWSD_TIMER_UNLINK(node) do { \
+    (node)->prev->next = (node)->next; \
+    (node)->next->prev = (node)->prev; \
+    (node)->prev = NULL; \
+    (node)->next = NULL; \
+} while(0)
+
+/******************************************************************************
+ **函数名称: lwsd_timer_wheel_creat
+ **功    能: 创建时间轮
+ **输入参数:
+ **     now: 当前时间
+ **输出参数: NONE
+ **返    回: 时间轮对象
+ **实现描述:
+ **注意事项: 时间轮只能由单个线程访问(服务线程), 因此内部不加锁.
+ **作    者:
+ ******************************************************************************/
+lwsd_timer_wheel_t *lwsd_timer_wheel_creat(time_t now)
+{
+    int idx;
+    lwsd_timer_wheel_t *tw;
+
+    tw = (lwsd_timer_wheel_t *)calloc(1, sizeof(lwsd_timer_wheel_t));
+    if (NULL == tw) {
+        return NULL;
+    }
+
+    tw->curr = now;
+
+    for (idx=0; idx<LWSD_TW_L0_SIZE; ++idx) {
+        tw->l0[idx].prev = &tw->l0[idx];
+        tw->l0[idx].next = &tw->l0[idx];
+    }
+
+    for (idx=0; idx<LWSD_TW_L1_SIZE; ++idx) {
+        tw->l1[idx].prev = &tw->l1[idx];
+        tw->l1[idx].next = &tw->l1[idx];
+    }
+
+    return tw;
+}
+
+/******************************************************************************
+ **函数名称: lwsd_timer_wheel_destroy
+ **功    能: 销毁时间轮
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 结点内存由宿主负责释放
+ **作    者:
+ ******************************************************************************/
+void lwsd_timer_wheel_destroy(lwsd_timer_wheel_t *tw)
+{
+    free(tw);
+}
+
+/******************************************************************************
+ **函数名称: lwsd_timer_add
+ **功    能: 添加定时器
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器结点
+ **     expire: 超时时间
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 根据超时时间与当前刻度的差值选择所在层次和槽位
+ **注意事项:
+ **     1. 已在时间轮中的结点会先被摘除
+ **     2. 超出时间轮跨度的结点放入第二层末槽, 级联时再重新计算位置
+ **作    者:
+ ******************************************************************************/
+void lwsd_timer_add(lwsd_timer_wheel_t *tw, lwsd_timer_node_t *node, time_t expire)
+{
+    time_t diff;
+
+    if (LWSD_TIMER_IS_PENDING(node)) {
+        LWSD_TIMER_UNLINK(node);
+        --tw->num;
+    }
+
+    node->expire = expire;
+    if (expire <= tw->curr) {
+        expire = tw->curr + 1; /* 当前槽已处理, 放入下一刻度 */
+    }
+
+    diff = expire - tw->curr;
+    if (diff >= LWSD_TW_SPAN) {
+        expire = tw->curr + LWSD_TW_SPAN - 1;
+        diff = LWSD_TW_SPAN - 1;
+    }
+
+    if (diff < LWSD_TW_L0_SIZE) {
+        LWSD_TIMER_LINK(&tw->l0[expire & LWSD_TW_L0_MASK], node);
+    } else {
+        LWSD_TIMER_LINK(&tw->l1[(expire >> LWSD_TW_L0_BITS) & LWSD_TW_L1_MASK], node);
+    }
+
+    ++tw->num;
+}
+
+/******************************************************************************
+ **函数名称: lwsd_timer_del
+ **功    能: 删除定时器
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器结点
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 结点未在时间轮中时, 直接返回
+ **作    者:
+ ******************************************************************************/
+void lwsd_timer_del(lwsd_timer_wheel_t *tw, lwsd_timer_node_t *node)
+{
+    if (!LWSD_TIMER_IS_PENDING(node)) {
+        return;
+    }
+
+    LWSD_TIMER_UNLINK(node);
+    --tw->num;
+}
+
+/******************************************************************************
+ **函数名称: lwsd_timer_cascade
+ **功    能: 将第二层的某个槽级联到第一层
+ **输入参数:
+ **     tw: 时间轮
+ **     idx: 第二层槽位
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 依次摘除槽内结点, 并按其超时时间重新加入时间轮
+ **注意事项: 级联发生在处理当前槽之前, 因此恰好在当前刻度超时的结点直接放入当前槽
+ **作    者:
+ ******************************************************************************/
+static void lwsd_timer_cascade(lwsd_timer_wheel_t *tw, int idx)
+{
+    lwsd_timer_node_t *head = &tw->l1[idx], *node;
+
+    while (head->next != head) {
+        node = head->next;
+        LWSD_TIMER_UNLINK(node);
+        if (node->expire <= tw->curr) {
+            LWSD_TIMER_LINK(&tw->l0[tw->curr & LWSD_TW_L0_MASK], node);
+            continue;
+        }
+        --tw->num;
+        lwsd_timer_add(tw, node, node->expire);
+    }
+}
+
+/******************************************************************************
+ **函数名称: lwsd_timer_wheel_run
+ **功    能: 推进时间轮, 并处理已超时的定时器
+ **输入参数:
+ **     tw: 时间轮
+ **     now: 当前时间
+ **     proc: 超时回调
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 本次超时的定时器个数
+ **实现描述: 逐刻度推进至now; 每当第一层转完一圈时, 将第二层对应槽级联下来.
+ **注意事项: 回调前结点已摘除, 回调中可以重新添加(如: 连接在此期间有数据交互)
+ **作    者:
+ ******************************************************************************/
+int lwsd_timer_wheel_run(lwsd_timer_wheel_t *tw, time_t now, lwsd_timer_cb_t proc, void *args)
+{
+    int num = 0;
+    lwsd_timer_node_t *head, *node;
+
+    while (tw->curr < now) {
+        ++tw->curr;
+
+        /* > 第一层转完一圈: 级联第二层 */
+        if (0 == (tw->curr & LWSD_TW_L0_MASK)) {
+            lwsd_timer_cascade(tw,
+                (tw->curr >> LWSD_TW_L0_BITS) & LWSD_TW_L1_MASK);
+        }
+
+        /* > 处理当前槽 */
+        head = &tw->l0[tw->curr & LWSD_TW_L0_MASK];
+        while (head->next != head) {
+            node = head->next;
+            LWSD_TIMER_UNLINK(node);
+            --tw->num;
+            ++num;
+            proc(node, now, args);
+        }
+    }
+
+    return num;
+}
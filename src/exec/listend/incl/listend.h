@@ -5,6 +5,10 @@
 #include "comm.h"
 #include "listend.h"
 #include "lsnd_conf.h"
+#include "lsnd_flight.h"
+#include "lsnd_limit.h"
+#include "mesg_pend.h"
+#include "mesg_suggest.h"
 
 #define LSND_DEF_CONF_PATH      "../conf/listend.xml"     /* 默认配置路径 */
 
@@ -33,6 +37,10 @@ typedef struct
 
     agent_cntx_t *agent;                    /* 代理服务 */
     rtmq_proxy_t *frwder;                   /* FRWDER服务 */
+    lsnd_flight_tab_t *flight;              /* 在途请求表(未开启请求合并时为NULL) */
+    lsnd_limit_t *limit;                    /* 限流对象(未开启限流时为NULL) */
+    mesg_pend_tab_t *pend;                  /* 在途请求表(核对应答&统计时延) */
+    mesg_suggest_tab_t *suggest;            /* 搜索建议合并表(合并多个后端的建议) */
 } lsnd_cntx_t;
 
 int lsnd_getopt(int argc, char **argv, lsnd_opt_t *opt);
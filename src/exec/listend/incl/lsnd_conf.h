@@ -5,6 +5,14 @@
 #include "agent.h"
 #include "rtmq_proxy.h"
 
+#define LSND_COALESCE_DEF_TTL   (3)     /* 合并项默认存活时间(秒) */
+#define LSND_LIMIT_DEF_RATE     (50)    /* 单会话默认请求速率(个/秒) */
+#define LSND_LIMIT_DEF_BURST    (100)   /* 单会话默认突发请求数 */
+#define LSND_LIMIT_DEF_INFLIGHT (4096)  /* 默认全局在途请求上限 */
+#define LSND_LIMIT_DEF_TIMEOUT  (3)     /* 在途请求默认超时时间(秒) */
+#define LSND_LIMIT_WIN_MAX      (64)    /* 在途请求超时时间上限(秒) */
+#define LSND_DEADLINE_DEF_TIMEOUT   (5000)  /* 请求默认有效期(毫秒) */
+
 /* 侦听配置 */
 typedef struct
 {
@@ -17,6 +25,22 @@ typedef struct
         int max;                    /* 队列长度 */
         int size;                   /* 单元大小 */
     } distq;                        /* 分发队列 */
+
+    int deadline;                   /* 请求有效期(毫秒, 0:不设置截止时间) */
+
+    struct {
+        bool enable;                /* 是否开启请求合并 */
+        int ttl;                    /* 合并项最长存活时间(秒) */
+    } coalesce;                     /* 请求合并配置 */
+
+    struct {
+        bool enable;                /* 是否开启限流 */
+        int rate;                   /* 单会话请求速率(个/秒) */
+        int burst;                  /* 单会话突发请求数(令牌桶容量) */
+        int inflight;               /* 全局在途请求上限(超过时返回繁忙) */
+        int timeout;                /* 在途请求超时时间(秒, 超时未应答不再计入在途) */
+    } limit;                        /* 限流配置 */
+
     agent_conf_t agent;             /* 代理配置 */
     rtmq_proxy_conf_t frwder;       /* FRWDER配置 */
 } lsnd_conf_t;
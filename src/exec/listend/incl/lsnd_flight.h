@@ -0,0 +1,64 @@
+#if !defined(__LSND_FLIGHT_H__)
+#define __LSND_FLIGHT_H__
+
+#include "comm.h"
+
+#define LSND_FLIGHT_BKT_NUM     (4096)      /* 哈希桶数(必须为2的次方) */
+#define LSND_FLIGHT_BKT_MASK    (LSND_FLIGHT_BKT_NUM - 1)
+
+/* 合并结果 */
+typedef enum
+{
+    LSND_FLIGHT_LEADER                      /* 领头请求(需转发至后端) */
+    , LSND_FLIGHT_WAIT                      /* 已挂入在途请求(无需转发) */
+} lsnd_flight_join_e;
+
+/* 等待者 */
+typedef struct _lsnd_flight_waiter_t
+{
+    uint64_t sid;                           /* 会话ID */
+    uint64_t serial;                        /* 请求流水号 */
+    struct _lsnd_flight_waiter_t *next;     /* 下一等待者 */
+} lsnd_flight_waiter_t;
+
+/* 在途请求 */
+typedef struct _lsnd_flight_t
+{
+    uint32_t hash;                          /* 报体哈希值 */
+    time_t ctm;                             /* 创建时间 */
+    uint64_t serial;                        /* 领头请求流水号(以此匹配应答) */
+    bool is_open;                           /* 是否允许合并(收到首帧应答后关闭) */
+    bool is_done;                           /* 是否已结束(收齐所有后端的末帧应答或已过期) */
+    int ref;                                /* 引用计数 */
+
+    lsnd_flight_waiter_t *waiters;          /* 等待者链表(关闭合并后只读) */
+    int num;                                /* 等待者个数 */
+
+    struct _lsnd_flight_t *body_next;       /* 报体哈希链 */
+    struct _lsnd_flight_t *serial_next;     /* 流水号哈希链 */
+    struct _lsnd_flight_t *prev, *next;     /* 时间序链表(用于过期清理) */
+    struct _lsnd_flight_t *expire_next;     /* 过期链表(待通知等待者) */
+
+    size_t len;                             /* 报体长度 */
+    char body[0];                           /* 请求报体 */
+} lsnd_flight_t;
+
+/* 在途请求表 */
+typedef struct
+{
+    int ttl;                                /* 最长存活时间(秒) */
+    pthread_mutex_t lock;                   /* 互斥锁 */
+
+    int num;                                /* 在途请求数 */
+    lsnd_flight_t *head, *tail;             /* 时间序链表(先进先出) */
+    lsnd_flight_t *body_bkt[LSND_FLIGHT_BKT_NUM]; /* 以报体为键 */
+    lsnd_flight_t *serial_bkt[LSND_FLIGHT_BKT_NUM]; /* 以流水号为键 */
+} lsnd_flight_tab_t;
+
+lsnd_flight_tab_t *lsnd_flight_tab_creat(int ttl);
+int lsnd_flight_join(lsnd_flight_tab_t *tab, uint64_t sid,
+        uint64_t serial, const void *body, size_t len, lsnd_flight_t **expired);
+lsnd_flight_t *lsnd_flight_query(lsnd_flight_tab_t *tab, uint64_t serial, bool is_done);
+void lsnd_flight_release(lsnd_flight_tab_t *tab, lsnd_flight_t *flight);
+
+#endif /*__LSND_FLIGHT_H__*/
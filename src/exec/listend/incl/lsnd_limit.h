@@ -0,0 +1,56 @@
+#if !defined(__LSND_LIMIT_H__)
+#define __LSND_LIMIT_H__
+
+#include "comm.h"
+#include "lsnd_conf.h"
+
+#define LSND_LIMIT_BKT_NUM      (65536)     /* 令牌桶槽位数(必须为2的次方) */
+#define LSND_LIMIT_LOCK_NUM     (64)        /* 令牌桶分段锁数(必须为2的次方) */
+#define LSND_LIMIT_SLOT_NUM     (65536)     /* 在途请求槽位数(必须为2的次方) */
+#define LSND_LIMIT_TOKEN        (1000)      /* 单个请求消耗的令牌数 */
+
+/* 会话令牌桶 */
+typedef struct
+{
+    uint64_t sid;                           /* 会话ID(0:空闲) */
+    uint64_t utm;                           /* 最近补充令牌的时间(微秒) */
+    int64_t tokens;                         /* 令牌数 */
+} lsnd_bucket_t;
+
+/* 在途请求 */
+typedef struct
+{
+    uint64_t serial;                        /* 流水号(0:空闲) */
+    time_t ctm;                             /* 发送时间(秒) */
+} lsnd_inflight_t;
+
+/* 在途统计窗口(每秒一格) */
+typedef struct
+{
+    time_t sec;                             /* 所属秒 */
+    int num;                                /* 该秒发出且尚未应答的请求数 */
+} lsnd_inflight_win_t;
+
+/* 限流对象 */
+typedef struct
+{
+    int rate;                               /* 单会话请求速率(个/秒) */
+    int64_t burst;                          /* 令牌桶容量(令牌数) */
+    int inflight;                           /* 全局在途请求上限 */
+    int timeout;                            /* 在途请求超时时间(秒) */
+
+    pthread_mutex_t bkt_lock[LSND_LIMIT_LOCK_NUM]; /* 令牌桶分段锁 */
+    lsnd_bucket_t bkt[LSND_LIMIT_BKT_NUM];  /* 会话令牌桶(以sid为键, 冲突时覆盖) */
+
+    pthread_mutex_t lock;                   /* 在途统计锁 */
+    lsnd_inflight_win_t win[LSND_LIMIT_WIN_MAX]; /* 在途统计窗口 */
+    lsnd_inflight_t slot[LSND_LIMIT_SLOT_NUM]; /* 在途请求(以serial为键, 冲突时覆盖) */
+} lsnd_limit_t;
+
+lsnd_limit_t *lsnd_limit_creat(int rate, int burst, int inflight, int timeout);
+bool lsnd_limit_rate(lsnd_limit_t *limit, uint64_t sid);
+bool lsnd_limit_is_busy(lsnd_limit_t *limit);
+void lsnd_limit_inflight_add(lsnd_limit_t *limit, uint64_t serial);
+void lsnd_limit_inflight_done(lsnd_limit_t *limit, uint64_t serial);
+
+#endif /*__LSND_LIMIT_H__*/
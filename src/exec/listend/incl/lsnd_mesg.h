@@ -4,7 +4,12 @@
 int lsnd_search_req_hdl(unsigned int type, void *data, int length, void *args);
 int lsnd_search_rsp_hdl(int type, int orig, char *data, size_t len, void *args);
 
-int lsnd_insert_word_req_hdl(unsigned int type, void *data, int length, void *args);
-int lsnd_insert_word_rsp_hdl(int type, int orig, char *data, size_t len, void *args);
+int lsnd_mesg_forward_hdl(unsigned int type, void *data, int length, void *args);
+int lsnd_mesg_relay_hdl(int type, int orig, char *data, size_t len, void *args);
+
+int lsnd_suggest_req_hdl(unsigned int type, void *data, int length, void *args);
+int lsnd_suggest_rsp_hdl(int type, int orig, char *data, size_t len, void *args);
+
+int lsnd_batch_mesg_hdl(int type, int orig, char *data, size_t len, void *args);
 
 #endif /*__LSND_MESG_H__*/
@@ -182,6 +182,39 @@ static lsnd_cntx_t *lsnd_init(lsnd_conf_t *conf, log_cycle_t *log)
             break;
         }
 
+        /* > 初始化在途请求表 */
+        ctx->pend = mesg_pend_tab_creat(log);
+        if (NULL == ctx->pend) {
+            log_error(log, "Create pend table failed!");
+            break;
+        }
+
+        /* > 初始化搜索建议合并表 */
+        ctx->suggest = mesg_suggest_tab_creat();
+        if (NULL == ctx->suggest) {
+            log_error(log, "Create suggest table failed!");
+            break;
+        }
+
+        /* > 初始化请求合并表 */
+        if (conf->coalesce.enable) {
+            ctx->flight = lsnd_flight_tab_creat(conf->coalesce.ttl);
+            if (NULL == ctx->flight) {
+                log_error(log, "Create flight table failed!");
+                break;
+            }
+        }
+
+        /* > 初始化限流对象 */
+        if (conf->limit.enable) {
+            ctx->limit = lsnd_limit_creat(conf->limit.rate,
+                    conf->limit.burst, conf->limit.inflight, conf->limit.timeout);
+            if (NULL == ctx->limit) {
+                log_error(log, "Create limit object failed!");
+                break;
+            }
+        }
+
         return ctx;
     } while (0);
 
@@ -208,7 +241,10 @@ static int lsnd_set_reg(lsnd_cntx_t *ctx)
     }
 
     LSND_AGT_REG_CB(ctx, MSG_SEARCH_REQ, lsnd_search_req_hdl, ctx);
-    LSND_AGT_REG_CB(ctx, MSG_INSERT_WORD_REQ, lsnd_insert_word_req_hdl, ctx);
+    LSND_AGT_REG_CB(ctx, MSG_INSERT_WORD_REQ, lsnd_mesg_forward_hdl, ctx);
+    LSND_AGT_REG_CB(ctx, MSG_SUGGEST_REQ, lsnd_suggest_req_hdl, ctx);
+    LSND_AGT_REG_CB(ctx, MSG_INDEX_DOC_REQ, lsnd_mesg_forward_hdl, ctx);
+    LSND_AGT_REG_CB(ctx, MSG_SET_DOC_SCORE_REQ, lsnd_mesg_forward_hdl, ctx);
 
 #define LSND_RTQ_REG_CB(lsnd, type, proc, args) /* 注册队列数据回调 */\
     if (rtmq_proxy_reg_add((lsnd)->frwder, type, (rtmq_reg_cb_t)proc, (void *)args)) { \
@@ -217,7 +253,11 @@ static int lsnd_set_reg(lsnd_cntx_t *ctx)
     }
 
     LSND_RTQ_REG_CB(ctx, MSG_SEARCH_RSP, lsnd_search_rsp_hdl, ctx);
-    LSND_RTQ_REG_CB(ctx, MSG_INSERT_WORD_RSP, lsnd_insert_word_rsp_hdl, ctx);
+    LSND_RTQ_REG_CB(ctx, MSG_INSERT_WORD_RSP, lsnd_mesg_relay_hdl, ctx);
+    LSND_RTQ_REG_CB(ctx, MSG_SUGGEST_RSP, lsnd_suggest_rsp_hdl, ctx);
+    LSND_RTQ_REG_CB(ctx, MSG_INDEX_DOC_RSP, lsnd_mesg_relay_hdl, ctx);
+    LSND_RTQ_REG_CB(ctx, MSG_SET_DOC_SCORE_RSP, lsnd_mesg_relay_hdl, ctx);
+    LSND_RTQ_REG_CB(ctx, MSG_BATCH_MESG, lsnd_batch_mesg_hdl, ctx);
 
     return LSND_OK;
 }
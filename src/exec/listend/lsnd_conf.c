@@ -7,6 +7,7 @@
  **         负责从代理服务配置文件(lsnd.xml)中提取有效信息
  ** 作  者: # Qifeng.zou # 2014.10.28 #
  ******************************************************************************/
+#include "cmd.h"
 #include "xml_tree.h" 
 #include "lsnd_conf.h"
 
@@ -15,6 +16,7 @@ static int lsnd_conf_parse(xml_tree_t *xml, agent_conf_t *conf, log_cycle_t *log
 static int lsnd_conf_load_comm(xml_tree_t *xml, lsnd_conf_t *conf, log_cycle_t *log);
 static int lsnd_conf_load_agent(xml_tree_t *xml, lsnd_conf_t *conf, log_cycle_t *log);
 static int lsnd_conf_load_frwder(xml_tree_t *xml, lsnd_conf_t *lcf, log_cycle_t *log);
+static int lsnd_conf_load_limit(xml_tree_t *xml, lsnd_conf_t *conf, log_cycle_t *log);
 
 /******************************************************************************
  **函数名称: lsnd_load_conf
@@ -69,6 +71,12 @@ int lsnd_load_conf(const char *path, lsnd_conf_t *conf, log_cycle_t *log)
             break;
         }
 
+        /* > 加载限流配置 */
+        if (lsnd_conf_load_limit(xml, conf, log)) {
+            log_error(log, "Load limit conf failed! path:%s", path);
+            break;
+        }
+
         /* > 释放XML树 */
         xml_destroy(xml);
         return 0;
@@ -154,6 +162,40 @@ static int lsnd_conf_load_comm(xml_tree_t *xml, lsnd_conf_t *conf, log_cycle_t *
 
     conf->distq.size = str_to_num(node->value.str);
 
+    /* > 请求有效期(可选) */
+    conf->deadline = LSND_DEADLINE_DEF_TIMEOUT;
+
+    node = xml_query(xml, ".LISTEND.DEADLINE.TIMEOUT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->deadline = str_to_num(node->value.str);
+        if (conf->deadline < 0 || conf->deadline > MESG_DEADLINE_MAX) {
+            log_error(log, "Deadline timeout is invalid! timeout:%d", conf->deadline);
+            return -1;
+        }
+    }
+
+    /* > 请求合并配置(可选) */
+    conf->coalesce.enable = false;
+    conf->coalesce.ttl = LSND_COALESCE_DEF_TTL;
+
+    fix = xml_query(xml, ".LISTEND.COALESCE");
+    if (NULL == fix) {
+        return 0;
+    }
+
+    node = xml_search(xml, fix, "ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        conf->coalesce.enable = true;
+    }
+
+    node = xml_search(xml, fix, "TTL");
+    if (NULL != node && 0 != node->value.len) {
+        conf->coalesce.ttl = str_to_num(node->value.str);
+        if (conf->coalesce.ttl <= 0) {
+            conf->coalesce.ttl = LSND_COALESCE_DEF_TTL;
+        }
+    }
+
     return 0;
 }
 
@@ -475,3 +517,77 @@ static int lsnd_conf_load_frwder(xml_tree_t *xml, lsnd_conf_t *lcf, log_cycle_t
 
     return 0;
 }
+
+/******************************************************************************
+ **函数名称: lsnd_conf_load_limit
+ **功    能: 加载限流配置
+ **输入参数:
+ **     xml: XML配置
+ **     log: 日志对象
+ **输出参数:
+ **     conf: 配置信息
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: LIMIT标签可选, 未配置时不限流
+ **作    者:
+ ******************************************************************************/
+static int lsnd_conf_load_limit(xml_tree_t *xml, lsnd_conf_t *conf, log_cycle_t *log)
+{
+    xml_node_t *fix, *node;
+
+    conf->limit.enable = false;
+    conf->limit.rate = LSND_LIMIT_DEF_RATE;
+    conf->limit.burst = LSND_LIMIT_DEF_BURST;
+    conf->limit.inflight = LSND_LIMIT_DEF_INFLIGHT;
+    conf->limit.timeout = LSND_LIMIT_DEF_TIMEOUT;
+
+    fix = xml_query(xml, ".LISTEND.LIMIT");
+    if (NULL == fix) {
+        return 0;
+    }
+
+    node = xml_search(xml, fix, "ENABLE");
+    if (NULL != node && !strcasecmp(node->value.str, "on")) {
+        conf->limit.enable = true;
+    }
+
+    /* > 单会话令牌桶 */
+    node = xml_search(xml, fix, "RATE");
+    if (NULL != node && 0 != node->value.len) {
+        conf->limit.rate = str_to_num(node->value.str);
+        if (conf->limit.rate <= 0) {
+            log_error(log, "Limit rate is invalid! rate:%d", conf->limit.rate);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, fix, "BURST");
+    if (NULL != node && 0 != node->value.len) {
+        conf->limit.burst = str_to_num(node->value.str);
+        if (conf->limit.burst <= 0) {
+            log_error(log, "Limit burst is invalid! burst:%d", conf->limit.burst);
+            return -1;
+        }
+    }
+
+    /* > 全局在途上限 */
+    node = xml_search(xml, fix, "INFLIGHT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->limit.inflight = str_to_num(node->value.str);
+        if (conf->limit.inflight <= 0) {
+            log_error(log, "Limit inflight is invalid! inflight:%d", conf->limit.inflight);
+            return -1;
+        }
+    }
+
+    node = xml_search(xml, fix, "TIMEOUT");
+    if (NULL != node && 0 != node->value.len) {
+        conf->limit.timeout = str_to_num(node->value.str);
+        if (conf->limit.timeout <= 0 || conf->limit.timeout > LSND_LIMIT_WIN_MAX) {
+            log_error(log, "Limit timeout is invalid! timeout:%d", conf->limit.timeout);
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,378 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: lsnd_flight.c
+ ** 版本号: 1.0
+ ** 描  述: 在途请求合并(single-flight)
+ **         相同报体的搜索请求在途时, 只向后端转发领头请求, 其余请求挂在领头
+ **         请求上等待; 应答到达后再分发给所有等待者.
+ ** 作  者:
+ ******************************************************************************/
+#include "lsnd_flight.h"
+
+#define LSND_FLIGHT_SERIAL_IDX(serial) /* 流水号哈希 */\
+    ((uint32_t)((serial) ^ ((serial) >> 32)) & LSND_FLIGHT_BKT_MASK)
+
+/******************************************************************************
+ **函数名称: lsnd_flight_hash
+ **功    能: 计算报体哈希值(FNV-1a)
+ **输入参数:
+ **     body: 报体
+ **     len: 报体长度
+ **输出参数: NONE
+ **返    回: 哈希值
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static uint32_t lsnd_flight_hash(const void *body, size_t len)
+{
+    size_t idx;
+    uint32_t hash = 2166136261U;
+    const unsigned char *p = (const unsigned char *)body;
+
+    for (idx=0; idx<len; ++idx) {
+        hash ^= p[idx];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_tab_creat
+ **功    能: 创建在途请求表
+ **输入参数:
+ **     ttl: 最长存活时间(秒)
+ **输出参数: NONE
+ **返    回: 在途请求表
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+lsnd_flight_tab_t *lsnd_flight_tab_creat(int ttl)
+{
+    lsnd_flight_tab_t *tab;
+
+    tab = (lsnd_flight_tab_t *)calloc(1, sizeof(lsnd_flight_tab_t));
+    if (NULL == tab) {
+        return NULL;
+    }
+
+    tab->ttl = ttl;
+    pthread_mutex_init(&tab->lock, NULL);
+
+    return tab;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_free
+ **功    能: 释放在途请求
+ **输入参数:
+ **     flight: 在途请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void lsnd_flight_free(lsnd_flight_t *flight)
+{
+    lsnd_flight_waiter_t *waiter, *next;
+
+    for (waiter = flight->waiters; NULL != waiter; waiter = next) {
+        next = waiter->next;
+        free(waiter);
+    }
+
+    free(flight);
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_close
+ **功    能: 关闭合并(从报体哈希链中摘除)
+ **输入参数:
+ **     tab: 在途请求表
+ **     flight: 在途请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 关闭后等待者链表不再变化, 因此分发时无需加锁
+ **作    者:
+ ******************************************************************************/
+static void lsnd_flight_close(lsnd_flight_tab_t *tab, lsnd_flight_t *flight)
+{
+    lsnd_flight_t **pp;
+
+    if (!flight->is_open) {
+        return;
+    }
+
+    pp = &tab->body_bkt[flight->hash & LSND_FLIGHT_BKT_MASK];
+    for (; NULL != *pp; pp = &(*pp)->body_next) {
+        if (*pp == flight) {
+            *pp = flight->body_next;
+            break;
+        }
+    }
+
+    flight->body_next = NULL;
+    flight->is_open = false;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_done
+ **功    能: 结束在途请求(从各索引中摘除)
+ **输入参数:
+ **     tab: 在途请求表
+ **     flight: 在途请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 无引用时直接释放, 否则由最后一个引用者释放
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void lsnd_flight_done(lsnd_flight_tab_t *tab, lsnd_flight_t *flight)
+{
+    lsnd_flight_t **pp;
+
+    lsnd_flight_close(tab, flight);
+
+    /* > 从流水号哈希链中摘除 */
+    pp = &tab->serial_bkt[LSND_FLIGHT_SERIAL_IDX(flight->serial)];
+    for (; NULL != *pp; pp = &(*pp)->serial_next) {
+        if (*pp == flight) {
+            *pp = flight->serial_next;
+            break;
+        }
+    }
+
+    /* > 从时间序链表中摘除 */
+    if (NULL != flight->prev) {
+        flight->prev->next = flight->next;
+    } else {
+        tab->head = flight->next;
+    }
+
+    if (NULL != flight->next) {
+        flight->next->prev = flight->prev;
+    } else {
+        tab->tail = flight->prev;
+    }
+
+    --tab->num;
+    flight->is_done = true;
+
+    if (0 == flight->ref) {
+        lsnd_flight_free(flight);
+    }
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_expire
+ **功    能: 清理过期的在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     now: 当前时间
+ **输出参数:
+ **     expired: 存在等待者的过期项链表(通过expire_next串联)
+ **返    回: VOID
+ **实现描述: 时间序链表按创建时间有序, 从表头开始清理直到遇到未过期项
+ **注意事项:
+ **     1. 存在等待者的过期项增加引用后交由调用者通知等待者, 通知完毕后
+ **        须逐一调用lsnd_flight_release()
+ **     2. 过期项的应答到达后, 只会发给领头请求的会话
+ **作    者:
+ ******************************************************************************/
+static void lsnd_flight_expire(lsnd_flight_tab_t *tab, time_t now, lsnd_flight_t **expired)
+{
+    lsnd_flight_t *flight;
+
+    while (NULL != tab->head && tab->head->ctm + tab->ttl <= now) {
+        flight = tab->head;
+        if (flight->num > 0) {
+            ++flight->ref;
+            flight->expire_next = *expired;
+            *expired = flight;
+        }
+        lsnd_flight_done(tab, flight);
+    }
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_join
+ **功    能: 加入在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     sid: 会话ID
+ **     serial: 请求流水号
+ **     body: 请求报体
+ **     len: 报体长度
+ **输出参数:
+ **     expired: 存在等待者的过期项链表(需通知等待者, 见lsnd_flight_expire())
+ **返    回: LSND_FLIGHT_LEADER:需转发 LSND_FLIGHT_WAIT:已合并
+ **实现描述:
+ **     1. 存在报体相同且仍允许合并的在途请求时, 挂入其等待者链表
+ **     2. 否则新建在途请求, 并由本请求作为领头请求转发至后端
+ **注意事项:
+ **     1. 内存不足时按领头请求处理, 保证请求不丢失
+ **     2. 领头请求转发失败时, 须调用lsnd_flight_query(is_done:true)摘除在途请求
+ **        并通知已挂入的等待者
+ **作    者:
+ ******************************************************************************/
+int lsnd_flight_join(lsnd_flight_tab_t *tab, uint64_t sid,
+        uint64_t serial, const void *body, size_t len, lsnd_flight_t **expired)
+{
+    uint32_t hash;
+    lsnd_flight_t *flight;
+    lsnd_flight_waiter_t *waiter;
+    time_t now = time(NULL);
+
+    hash = lsnd_flight_hash(body, len);
+
+    *expired = NULL;
+
+    pthread_mutex_lock(&tab->lock);
+
+    lsnd_flight_expire(tab, now, expired);
+
+    /* > 查找相同的在途请求 */
+    flight = tab->body_bkt[hash & LSND_FLIGHT_BKT_MASK];
+    for (; NULL != flight; flight = flight->body_next) {
+        if (flight->hash == hash && flight->len == len
+            && !memcmp(flight->body, body, len))
+        {
+            break;
+        }
+    }
+
+    if (NULL != flight) {
+        waiter = (lsnd_flight_waiter_t *)calloc(1, sizeof(lsnd_flight_waiter_t));
+        if (NULL == waiter) {
+            pthread_mutex_unlock(&tab->lock);
+            return LSND_FLIGHT_LEADER;
+        }
+
+        waiter->sid = sid;
+        waiter->serial = serial;
+        waiter->next = flight->waiters;
+        flight->waiters = waiter;
+        ++flight->num;
+
+        pthread_mutex_unlock(&tab->lock);
+        return LSND_FLIGHT_WAIT;
+    }
+
+    /* > 新建在途请求 */
+    flight = (lsnd_flight_t *)calloc(1, sizeof(lsnd_flight_t) + len);
+    if (NULL == flight) {
+        pthread_mutex_unlock(&tab->lock);
+        return LSND_FLIGHT_LEADER;
+    }
+
+    flight->hash = hash;
+    flight->ctm = now;
+    flight->serial = serial;
+    flight->is_open = true;
+    flight->len = len;
+    memcpy(flight->body, body, len);
+
+    flight->body_next = tab->body_bkt[hash & LSND_FLIGHT_BKT_MASK];
+    tab->body_bkt[hash & LSND_FLIGHT_BKT_MASK] = flight;
+
+    flight->serial_next = tab->serial_bkt[LSND_FLIGHT_SERIAL_IDX(serial)];
+    tab->serial_bkt[LSND_FLIGHT_SERIAL_IDX(serial)] = flight;
+
+    flight->prev = tab->tail;
+    if (NULL != tab->tail) {
+        tab->tail->next = flight;
+    } else {
+        tab->head = flight;
+    }
+    tab->tail = flight;
+    ++tab->num;
+
+    pthread_mutex_unlock(&tab->lock);
+
+    return LSND_FLIGHT_LEADER;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_query
+ **功    能: 通过领头请求流水号查找在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     serial: 应答流水号
+ **     is_done: 是否已收齐所有后端的末帧应答
+ **输出参数: NONE
+ **返    回: 存在等待者时返回在途请求, 否则返回NULL
+ **实现描述:
+ **     1. 收到首帧应答后关闭合并, 防止后来者错过之前的分页
+ **     2. 收齐所有后端的末帧应答后从表中摘除
+ **注意事项:
+ **     1. 返回非NULL时, 使用完毕后必须调用lsnd_flight_release()
+ **     2. 请求被分发至多个后端时, 每个后端各有一帧末帧应答, 因此不能以单帧的
+ **        MESG_FLAG_MORE判断结束, 而应以在途请求表(mesg_pend_done)的结论为准
+ **作    者:
+ ******************************************************************************/
+lsnd_flight_t *lsnd_flight_query(lsnd_flight_tab_t *tab, uint64_t serial, bool is_done)
+{
+    lsnd_flight_t *flight;
+
+    pthread_mutex_lock(&tab->lock);
+
+    flight = tab->serial_bkt[LSND_FLIGHT_SERIAL_IDX(serial)];
+    for (; NULL != flight; flight = flight->serial_next) {
+        if (flight->serial == serial) {
+            break;
+        }
+    }
+
+    if (NULL == flight) {
+        pthread_mutex_unlock(&tab->lock);
+        return NULL;
+    }
+
+    lsnd_flight_close(tab, flight);
+
+    if (0 == flight->num) {
+        if (is_done) {
+            lsnd_flight_done(tab, flight);
+        }
+        pthread_mutex_unlock(&tab->lock);
+        return NULL;
+    }
+
+    ++flight->ref;
+    if (is_done) {
+        lsnd_flight_done(tab, flight);
+    }
+
+    pthread_mutex_unlock(&tab->lock);
+
+    return flight;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_flight_release
+ **功    能: 释放在途请求的引用
+ **输入参数:
+ **     tab: 在途请求表
+ **     flight: 在途请求
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+void lsnd_flight_release(lsnd_flight_tab_t *tab, lsnd_flight_t *flight)
+{
+    pthread_mutex_lock(&tab->lock);
+
+    --flight->ref;
+    if (0 == flight->ref && flight->is_done) {
+        lsnd_flight_free(flight);
+    }
+
+    pthread_mutex_unlock(&tab->lock);
+}
@@ -0,0 +1,224 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: lsnd_limit.c
+ ** 版本号: 1.0
+ ** 描  述: 请求准入控制
+ **         1. 单会话令牌桶: 限制每个会话的请求速率, 防止个别客户端挤占接收队列
+ **         2. 全局在途上限: 发往后端且尚未应答的请求数超过上限时, 直接返回繁忙,
+ **            避免请求在队列中堆积而放大排队时延
+ ** 作  者:
+ ******************************************************************************/
+#include "lsnd_limit.h"
+
+/* 哈希(MurmurHash3 fmix64) */
+static inline uint64_t lsnd_limit_hash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+#define LSND_LIMIT_BKT_IDX(h)   ((h) & (LSND_LIMIT_BKT_NUM - 1))
+#define LSND_LIMIT_LOCK_IDX(h)  (((h) >> 16) & (LSND_LIMIT_LOCK_NUM - 1))
+#define LSND_LIMIT_SLOT_IDX(h)  ((h) & (LSND_LIMIT_SLOT_NUM - 1))
+
+/******************************************************************************
+ **函数名称: lsnd_limit_creat
+ **功    能: 创建限流对象
+ **输入参数:
+ **     rate: 单会话请求速率(个/秒)
+ **     burst: 单会话突发请求数
+ **     inflight: 全局在途请求上限
+ **     timeout: 在途请求超时时间(秒)
+ **输出参数: NONE
+ **返    回: 限流对象
+ **实现描述:
+ **注意事项: timeout不能超过LSND_LIMIT_WIN_MAX
+ **作    者:
+ ******************************************************************************/
+lsnd_limit_t *lsnd_limit_creat(int rate, int burst, int inflight, int timeout)
+{
+    int idx;
+    lsnd_limit_t *limit;
+
+    limit = (lsnd_limit_t *)calloc(1, sizeof(lsnd_limit_t));
+    if (NULL == limit) {
+        return NULL;
+    }
+
+    limit->rate = rate;
+    limit->burst = (int64_t)burst * LSND_LIMIT_TOKEN;
+    limit->inflight = inflight;
+    limit->timeout = MIN(timeout, LSND_LIMIT_WIN_MAX);
+
+    for (idx=0; idx<LSND_LIMIT_LOCK_NUM; ++idx) {
+        pthread_mutex_init(&limit->bkt_lock[idx], NULL);
+    }
+    pthread_mutex_init(&limit->lock, NULL);
+
+    return limit;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_limit_rate
+ **功    能: 单会话速率检查
+ **输入参数:
+ **     limit: 限流对象
+ **     sid: 会话ID
+ **输出参数: NONE
+ **返    回: true:放行 false:超速
+ **实现描述:
+ **     1. 按距上次补充的时长补充令牌, 不超过桶容量
+ **     2. 令牌足够时扣除一个请求的令牌并放行
+ **注意事项: 槽位被其他会话占用时直接覆盖(新会话以满桶开始), 以固定内存换取
+ **          少量误放行; 不会误拒正常会话
+ **作    者:
+ ******************************************************************************/
+bool lsnd_limit_rate(lsnd_limit_t *limit, uint64_t sid)
+{
+    bool pass;
+    struct timeval tv;
+    uint64_t now, h = lsnd_limit_hash(sid);
+    lsnd_bucket_t *bkt = &limit->bkt[LSND_LIMIT_BKT_IDX(h)];
+    pthread_mutex_t *lock = &limit->bkt_lock[LSND_LIMIT_LOCK_IDX(h)];
+
+    gettimeofday(&tv, NULL);
+    now = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+    pthread_mutex_lock(lock);
+
+    if (bkt->sid != sid) {
+        bkt->sid = sid;
+        bkt->utm = now;
+        bkt->tokens = limit->burst;
+    }
+    else if (now > bkt->utm) {
+        /* 每微秒补充rate*LSND_LIMIT_TOKEN/1000000个令牌 */
+        bkt->tokens += (int64_t)((now - bkt->utm) * limit->rate / 1000);
+        if (bkt->tokens > limit->burst) {
+            bkt->tokens = limit->burst;
+        }
+        bkt->utm = now;
+    }
+
+    pass = (bkt->tokens >= LSND_LIMIT_TOKEN);
+    if (pass) {
+        bkt->tokens -= LSND_LIMIT_TOKEN;
+    }
+
+    pthread_mutex_unlock(lock);
+
+    return pass;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_limit_inflight_num
+ **功    能: 统计在途请求数
+ **输入参数:
+ **     limit: 限流对象
+ **     now: 当前时间(秒)
+ **输出参数: NONE
+ **返    回: 在途请求数
+ **实现描述: 累加超时时间内各秒的在途数, 超时未应答的请求自然移出窗口
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static int lsnd_limit_inflight_num(lsnd_limit_t *limit, time_t now)
+{
+    int idx, num = 0;
+
+    for (idx=0; idx<limit->timeout; ++idx) {
+        if (now - limit->win[idx].sec < limit->timeout) {
+            num += limit->win[idx].num;
+        }
+    }
+
+    return num;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_limit_is_busy
+ **功    能: 判断后端是否繁忙
+ **输入参数:
+ **     limit: 限流对象
+ **输出参数: NONE
+ **返    回: true:繁忙 false:空闲
+ **实现描述: 在途请求数达到上限即为繁忙
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+bool lsnd_limit_is_busy(lsnd_limit_t *limit)
+{
+    int num;
+
+    pthread_mutex_lock(&limit->lock);
+    num = lsnd_limit_inflight_num(limit, time(NULL));
+    pthread_mutex_unlock(&limit->lock);
+
+    return (num >= limit->inflight);
+}
+
+/******************************************************************************
+ **函数名称: lsnd_limit_inflight_add
+ **功    能: 登记在途请求
+ **输入参数:
+ **     limit: 限流对象
+ **     serial: 流水号
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 计入当前秒的统计窗口, 并记录发送时间以便应答时扣减
+ **注意事项: 槽位冲突时直接覆盖, 被覆盖的请求待超时后移出窗口
+ **作    者:
+ ******************************************************************************/
+void lsnd_limit_inflight_add(lsnd_limit_t *limit, uint64_t serial)
+{
+    time_t now = time(NULL);
+    lsnd_inflight_win_t *win = &limit->win[now % limit->timeout];
+    lsnd_inflight_t *slot = &limit->slot[LSND_LIMIT_SLOT_IDX(lsnd_limit_hash(serial))];
+
+    pthread_mutex_lock(&limit->lock);
+
+    if (win->sec != now) {
+        win->sec = now;
+        win->num = 0;
+    }
+    ++win->num;
+
+    slot->serial = serial;
+    slot->ctm = now;
+
+    pthread_mutex_unlock(&limit->lock);
+}
+
+/******************************************************************************
+ **函数名称: lsnd_limit_inflight_done
+ **功    能: 在途请求已结束
+ **输入参数:
+ **     limit: 限流对象
+ **     serial: 流水号
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 从发送时所在秒的统计窗口中扣减
+ **注意事项: 收到末帧应答或发送失败时调用
+ **作    者:
+ ******************************************************************************/
+void lsnd_limit_inflight_done(lsnd_limit_t *limit, uint64_t serial)
+{
+    lsnd_inflight_win_t *win;
+    lsnd_inflight_t *slot = &limit->slot[LSND_LIMIT_SLOT_IDX(lsnd_limit_hash(serial))];
+
+    pthread_mutex_lock(&limit->lock);
+
+    if (slot->serial == serial) {
+        win = &limit->win[slot->ctm % limit->timeout];
+        if (win->sec == slot->ctm && win->num > 0) {
+            --win->num;
+        }
+        slot->serial = 0;
+    }
+
+    pthread_mutex_unlock(&limit->lock);
+}
@@ -12,6 +12,99 @@
 #include "search.h"
 #include "listend.h"
 #include "lsnd_mesg.h"
+#include "mesg_zip.h"
+
+/******************************************************************************
+ **函数名称: lsnd_search_busy_rsp
+ **功    能: 发送繁忙应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     head: 请求报头(主机字节序)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 应答报体为固定的SEARCH-RSP, 返回码为SRCH_CODE_BUSY
+ **注意事项: 过载时调用, 因此不构建XML树, 直接格式化报体
+ **作    者:
+ ******************************************************************************/
+static int lsnd_search_busy_rsp(lsnd_cntx_t *ctx, const mesg_header_t *head)
+{
+    int len;
+    mesg_header_t *rsp;
+    char addr[sizeof(mesg_header_t) + 64];
+
+    rsp = (mesg_header_t *)addr;
+
+    len = snprintf(rsp->body, sizeof(addr) - sizeof(mesg_header_t),
+            "<SEARCH-RSP CODE=\"%s\"/>", SRCH_CODE_BUSY);
+
+    MESG_HEAD_SET(rsp, MSG_SEARCH_RSP, head->sid, head->nid, head->serial, len);
+    MESG_HEAD_HTON(rsp, rsp);
+
+    return agent_async_send(ctx->agent, MSG_SEARCH_RSP, head->sid, addr, MESG_TOTAL_LEN(len));
+}
+
+/******************************************************************************
+ **函数名称: lsnd_search_flight_busy
+ **功    能: 向合并请求的等待者发送繁忙应答
+ **输入参数:
+ **     ctx: 全局对象
+ **     head: 请求报头(主机字节序, 用于填充应答的结点ID)
+ **     flight: 已摘除的在途请求(由lsnd_flight_query()或过期清理返回)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 以各等待者的sid和serial逐一发送繁忙应答, 再释放在途请求的引用
+ **注意事项: 领头请求转发失败或在途请求过期时调用, 避免等待者永远得不到应答
+ **作    者:
+ ******************************************************************************/
+static void lsnd_search_flight_busy(lsnd_cntx_t *ctx,
+        const mesg_header_t *head, lsnd_flight_t *flight)
+{
+    mesg_header_t hhead;
+    lsnd_flight_waiter_t *waiter;
+
+    memcpy(&hhead, head, sizeof(hhead));
+
+    for (waiter = flight->waiters; NULL != waiter; waiter = waiter->next) {
+        hhead.sid = waiter->sid;
+        hhead.serial = waiter->serial;
+
+        if (lsnd_search_busy_rsp(ctx, &hhead)) {
+            log_error(ctx->log, "Send busy response failed! sid:%lu serial:%lu",
+                    waiter->sid, waiter->serial);
+        }
+    }
+
+    lsnd_flight_release(ctx->flight, flight);
+}
+
+/******************************************************************************
+ **函数名称: lsnd_search_flight_abort
+ **功    能: 摘除领头请求的在途合并项
+ **输入参数:
+ **     ctx: 全局对象
+ **     head: 领头请求报头(主机字节序)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 领头请求未能转发至后端, 其应答永远不会到达, 因此立即结束合并项,
+ **          并向已挂入的等待者返回繁忙应答
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void lsnd_search_flight_abort(lsnd_cntx_t *ctx, const mesg_header_t *head)
+{
+    lsnd_flight_t *flight;
+
+    if (NULL == ctx->flight) {
+        return;
+    }
+
+    flight = lsnd_flight_query(ctx->flight, head->serial, true);
+    if (NULL == flight) {
+        return;
+    }
+
+    lsnd_search_flight_busy(ctx, head, flight);
+}
 
 /******************************************************************************
  **函数名称: lsnd_search_req_hdl
@@ -24,22 +117,152 @@
  **输出参数:
  **返    回: 0:成功 !0:失败
  **实现描述: 请求数据的内存结构: 流水信息 + 消息头 + 消息体
- **注意事项: 需要将协议头转换为网络字节序
+ **注意事项:
+ **     1. 需要将协议头转换为网络字节序
+ **     2. 开启请求合并时, 与在途请求相同的请求不再转发, 待应答到达后统一分发
+ **     3. 开启限流时, 会话超速或后端在途请求过多时直接返回繁忙应答
+ **     4. 客户端未指定截止时间时按配置设置, 已超时的请求直接丢弃
+ **     5. 转发前登记在途请求, 以便核对应答; 在途表已满时返回繁忙应答
+ **     6. 领头请求无法转发时, 摘除其在途合并项, 并向已挂入的等待者返回繁忙应答
  **作    者: # Qifeng.zou # 2015.05.28 23:11:54 #
  ******************************************************************************/
 int lsnd_search_req_hdl(unsigned int type, void *data, int length, void *args)
 {
+    int ret;
+    uint64_t serial;
+    mesg_header_t hhead;
+    lsnd_flight_t *expired, *next;
     lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
     mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
 
     log_debug(ctx->log, "sid:%lu serial:%lu length:%d body:%s!",
             head->sid, head->serial, length, head->body);
 
+    /* > 设置截止时间 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! sid:%lu serial:%lu", head->sid, head->serial);
+        return 0;
+    }
+    else if (!(head->flag & MESG_FLAG_DEADLINE) && ctx->conf.deadline > 0) {
+        head->flag = MESG_DEADLINE_SET(head->flag, ctx->conf.deadline);
+    }
+
+    /* > 准入控制 */
+    if (NULL != ctx->limit) {
+        if (!lsnd_limit_rate(ctx->limit, head->sid)) {
+            log_warn(ctx->log, "Session exceeds rate limit! sid:%lu serial:%lu",
+                    head->sid, head->serial);
+            return lsnd_search_busy_rsp(ctx, head);
+        }
+        else if (lsnd_limit_is_busy(ctx->limit)) {
+            log_warn(ctx->log, "Too many in-flight requests! sid:%lu serial:%lu",
+                    head->sid, head->serial);
+            return lsnd_search_busy_rsp(ctx, head);
+        }
+    }
+
+    /* > 合并相同的在途请求 */
+    if (NULL != ctx->flight) {
+        ret = lsnd_flight_join(ctx->flight,
+                head->sid, head->serial, head->body, head->length, &expired);
+
+        /* > 通知过期项的等待者 */
+        for (; NULL != expired; expired = next) {
+            next = expired->expire_next;
+            log_warn(ctx->log, "Coalesced request is expired! serial:%lu waiters:%d",
+                    expired->serial, expired->num);
+            lsnd_search_flight_busy(ctx, head, expired);
+        }
+
+        if (LSND_FLIGHT_WAIT == ret) {
+            log_debug(ctx->log, "Coalesced into in-flight request! sid:%lu serial:%lu",
+                    head->sid, head->serial);
+            return 0;
+        }
+    }
+
+    /* > 登记在途请求 */
+    serial = head->serial;
+    if (mesg_pend_add(ctx->pend, serial, head->sid, (head->flag & MESG_FLAG_DEADLINE)?
+            MESG_DEADLINE_LEFT(head->flag) : MESG_DEADLINE_MAX))
+    {
+        log_warn(ctx->log, "Pend table is full! sid:%lu serial:%lu", head->sid, serial);
+        lsnd_search_flight_abort(ctx, head);
+        return lsnd_search_busy_rsp(ctx, head);
+    }
+
+    if (NULL != ctx->limit) {
+        lsnd_limit_inflight_add(ctx->limit, serial);
+    }
+
     /* > 转换字节序 */
+    memcpy(&hhead, head, sizeof(hhead));
+
     MESG_HEAD_HTON(head, head);
 
     /* > 转发搜索请求 */
-    return rtmq_proxy_async_send(ctx->frwder, type, data, length);
+    if (rtmq_proxy_async_send(ctx->frwder, type, data, length)) {
+        mesg_pend_del(ctx->pend, serial);
+        if (NULL != ctx->limit) {
+            lsnd_limit_inflight_done(ctx->limit, serial);
+        }
+        log_error(ctx->log, "Push search request failed! serial:%lu", serial);
+        lsnd_search_flight_abort(ctx, &hhead);
+        lsnd_search_busy_rsp(ctx, &hhead);
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_search_rsp_send
+ **功    能: 发送搜索应答(含合并请求的分发)
+ **输入参数:
+ **     ctx: 全局对象
+ **     type: 数据类型
+ **     hhead: 应答报头(主机字节序)
+ **     data: 应答数据(报头为网络字节序)
+ **     len: 数据长度
+ **     is_done: 是否已收齐所有后端的末帧应答
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 先发给领头请求的会话, 再改写报头中的sid和serial后逐一发给等待者
+ **注意事项: 发送接口会拷贝数据, 因此可以复用同一块内存
+ **作    者:
+ ******************************************************************************/
+static int lsnd_search_rsp_send(lsnd_cntx_t *ctx,
+        int type, const mesg_header_t *hhead, void *data, size_t len, bool is_done)
+{
+    int ret;
+    lsnd_flight_t *flight;
+    lsnd_flight_waiter_t *waiter;
+    mesg_header_t *head = (mesg_header_t *)data;
+
+    ret = agent_async_send(ctx->agent, type, hhead->sid, data, len);
+    if (NULL == ctx->flight) {
+        return ret;
+    }
+
+    /* > 分发给合并的等待者 */
+    flight = lsnd_flight_query(ctx->flight, hhead->serial, is_done);
+    if (NULL == flight) {
+        return ret;
+    }
+
+    for (waiter = flight->waiters; NULL != waiter; waiter = waiter->next) {
+        head->sid = hton64(waiter->sid);
+        head->serial = hton64(waiter->serial);
+
+        if (agent_async_send(ctx->agent, type, waiter->sid, data, len)) {
+            log_error(ctx->log, "Send coalesced response failed! sid:%lu serial:%lu",
+                    waiter->sid, waiter->serial);
+        }
+    }
+
+    lsnd_flight_release(ctx->flight, flight);
+
+    return ret;
 }
 
 /******************************************************************************
@@ -55,57 +278,269 @@ int lsnd_search_req_hdl(unsigned int type, void *data, int length, void *args)
  **返    回: 0:成功 !0:失败
  **实现描述:
  **注意事项:
+ **     1. 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
+ **     2. 请求被分发至多个后端时, 收齐所有后端的末帧应答后才释放限流的在途计数
  **作    者: # Qifeng.zou # 2015.06.10 #
  ******************************************************************************/
 int lsnd_search_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int ret;
+    bool is_done;
     lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
-    mesg_header_t *head = (mesg_header_t *)data, hhead;
+    mesg_header_t *head = (mesg_header_t *)data, hhead, *rsp;
 
     /* > 转化字节序 */
     MESG_HEAD_NTOH(head, &hhead);
 
     MESG_HEAD_PRINT(ctx->log, &hhead)
-    log_debug(ctx->log, "body:%s", head->body);
 
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, hhead.serial, hhead.sid, hhead.flag, &is_done)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", hhead.sid, hhead.serial);
+        return 0;
+    }
+
+    /* > 收齐所有后端的末帧应答: 结束在途请求 */
+    if (NULL != ctx->limit && is_done) {
+        lsnd_limit_inflight_done(ctx->limit, hhead.serial);
+    }
+
+    if (!(hhead.flag & MESG_FLAG_ZIP)) {
+        log_debug(ctx->log, "body:%s", head->body);
+        return lsnd_search_rsp_send(ctx, type, &hhead, data, len, is_done);
+    }
+
+    /* > 解压报体(客户端无需感知压缩) */
+    rsp = mesg_unzip(&hhead, head->body, &len, ctx->log);
+    if (NULL == rsp) {
+        return -1;
+    }
+
+    log_debug(ctx->log, "body:%s", rsp->body);
+
+    MESG_HEAD_HTON(rsp, rsp);
+
+    ret = lsnd_search_rsp_send(ctx, type, &hhead, rsp, len, is_done);
+
+    free(rsp);
+
+    return ret;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_mesg_forward
+ **功    能: 登记在途请求并转发至转发层
+ **输入参数:
+ **     ctx: 全局对象
+ **     type: 消息类型
+ **     data: 请求数据(报头为主机字节序)
+ **     length: 数据长度(报头 + 报体)
+ **     timeout: 在途请求的超时时间(毫秒)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 登记在途请求 > 转换报头字节序 > 转发; 转发失败时撤销在途请求
+ **注意事项: 报头被原地转换为网络字节序, 报体原样转发
+ **作    者:
+ ******************************************************************************/
+static int lsnd_mesg_forward(lsnd_cntx_t *ctx,
+        unsigned int type, void *data, int length, int timeout)
+{
+    uint64_t serial;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
+
+    /* > 登记在途请求 */
+    serial = head->serial;
+    if (mesg_pend_add(ctx->pend, serial, head->sid, timeout)) {
+        log_error(ctx->log, "Pend table is full! type:%u sid:%lu serial:%lu", type, head->sid, serial);
+        return -1;
+    }
+
+    /* > 转换字节序 */
+    MESG_HEAD_HTON(head, head);
+
+    if (rtmq_proxy_async_send(ctx->frwder, type, data, length)) {
+        mesg_pend_del(ctx->pend, serial);
+        log_error(ctx->log, "Push request failed! type:%u serial:%lu", type, serial);
+        return -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: lsnd_index_doc_too_large
+ **功    能: 拒绝过大的文档索引请求
+ **输入参数:
+ **     ctx: 全局对象
+ **     head: 请求报头(主机字节序)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 应答码为MESG_INDEX_DOC_TOO_LARGE, 并带回请求中的URL; 应答报头转换为网络字节序后放入发送队列
+ **注意事项: 超过FRWDER.SENDQ.SIZE的请求无法放入发送队列, 若不显式拒绝, 客户端只能等到超时
+ **作    者:
+ ******************************************************************************/
+static int lsnd_index_doc_too_large(lsnd_cntx_t *ctx, const mesg_header_t *head)
+{
+    int len;
+    mesg_header_t *rsp;
+    mesg_index_doc_rsp_t *body;
+    const mesg_index_doc_req_t *req = (const mesg_index_doc_req_t *)(head + 1);
+    char addr[sizeof(mesg_header_t) + sizeof(mesg_index_doc_rsp_t)];
+
+    memset(addr, 0, sizeof(addr));
+
+    rsp = (mesg_header_t *)addr;
+    body = (mesg_index_doc_rsp_t *)(rsp + 1);
+
+    body->code = MESG_INDEX_DOC_TOO_LARGE;
+    memcpy(body->url, req->url, sizeof(body->url));
+    mesg_index_doc_rsp_hton(body);
+
+    len = sizeof(mesg_index_doc_rsp_t);
+
+    MESG_HEAD_SET(rsp, MSG_INDEX_DOC_RSP, head->sid, head->nid, head->serial, len);
+    MESG_HEAD_HTON(rsp, rsp);
+
+    return agent_async_send(ctx->agent, MSG_INDEX_DOC_RSP, head->sid, addr, MESG_TOTAL_LEN(len));
+}
+
+/******************************************************************************
+ **函数名称: lsnd_mesg_forward_hdl
+ **功    能: 转发类请求的处理函数(插入关键字/文档索引/设置静态得分)
+ **输入参数:
+ **     type: 消息类型
+ **     data: 数据内容
+ **     length: 数据长度(报头 + 报体)
+ **     args: 附加参数
+ **输出参数:
+ **返    回: 0:成功 !0:失败
+ **实现描述: 校验报体长度后登记在途请求, 原样转发至转发层(由转发层按类型路由)
+ **注意事项:
+ **     1. 报体原样转发, 由倒排服务解析
+ **     2. 文档索引请求超过FRWDER.SENDQ.SIZE时, 直接回复MESG_INDEX_DOC_TOO_LARGE
+ **作    者:
+ ******************************************************************************/
+int lsnd_mesg_forward_hdl(unsigned int type, void *data, int length, void *args)
+{
+    size_t min;
+    lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
+
+    min = mesg_forward_body_min(type);
+    if (0 == min || length < (int)MESG_TOTAL_LEN(min)) {
+        log_error(ctx->log, "Request is invalid! type:%u length:%d", type, length);
+        return -1;
+    }
+
+    log_debug(ctx->log, "type:%u sid:%lu serial:%lu length:%d",
+            type, head->sid, head->serial, length);
+
+    /* > 拒绝过大的文档 */
+    if (MSG_INDEX_DOC_REQ == type && length > ctx->conf.frwder.sendq.size) {
+        log_warn(ctx->log, "Document is too large! serial:%lu length:%d max:%d",
+                head->serial, length, ctx->conf.frwder.sendq.size);
+        return lsnd_index_doc_too_large(ctx, head);
+    }
+
+    return lsnd_mesg_forward(ctx, type, data, length, MESG_DEADLINE_MAX);
+}
+
+/******************************************************************************
+ **函数名称: lsnd_mesg_relay_hdl
+ **功    能: 转发类请求的应答处理函数(插入关键字/文档索引/设置静态得分)
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 需要转发的数据
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 核对在途请求后原样回送给客户端
+ **注意事项:
+ **     1. 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
+ **     2. 写请求被转发层发给所属分区的所有副本, 只在收齐各副本的应答后回送一次
+ **作    者:
+ ******************************************************************************/
+int lsnd_mesg_relay_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    bool is_done;
+    lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data, hhead;
+
+    /* > 转换字节序 */
+    MESG_HEAD_NTOH(head, &hhead);
+
+    MESG_HEAD_PRINT(ctx->log, &hhead)
+
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, hhead.serial, hhead.sid, hhead.flag, &is_done)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", hhead.sid, hhead.serial);
+        return 0;
+    }
+    else if (!is_done) {
+        return 0; /* 等待其他副本的应答 */
+    }
+
+    /* > 放入发送队列 */
     return agent_async_send(ctx->agent, type, hhead.sid, data, len);
 }
 
 /******************************************************************************
- **函数名称: lsnd_insert_word_req_hdl
- **功    能: 插入关键字的处理函数
+ **函数名称: lsnd_suggest_req_hdl
+ **功    能: 搜索建议请求的处理函数
  **输入参数:
  **     type: 全局对象
  **     data: 数据内容
- **     length: 数据长度
+ **     length: 数据长度(报头 + 报体)
  **     args: 附加参数
  **输出参数:
  **返    回: 0:成功 !0:失败
- **实现描述: 请求数据的内存结构: 流水信息 + 消息头 + 消息体
- **注意事项: 需要将协议头转换为网络字节序
- **作    者: # Qifeng.zou # 2015.06.17 21:34:49 #
+ **实现描述: 设置截止时间并登记合并项后, 转发至转发层(与搜索请求同路由)
+ **注意事项: 合并项须在转发前登记, 否则可能错过先到的应答
+ **作    者:
  ******************************************************************************/
-int lsnd_insert_word_req_hdl(unsigned int type, void *data, int length, void *args)
+int lsnd_suggest_req_hdl(unsigned int type, void *data, int length, void *args)
 {
-    mesg_header_t *head;
-    mesg_insert_word_req_t *req;
+    uint64_t serial;
     lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
+    mesg_header_t *head = (mesg_header_t *)data; /* 消息头 */
+    mesg_suggest_req_t *req = (mesg_suggest_req_t *)(head + 1);
 
-    head = (mesg_header_t *)data; // 消息头
-    req = (mesg_insert_word_req_t *)(head + 1);
+    if (length < (int)MESG_TOTAL_LEN(sizeof(mesg_suggest_req_t))) {
+        log_error(ctx->log, "Suggest request is too short! length:%d", length);
+        return -1;
+    }
 
-    log_debug(ctx->log, "sid:%lu, serial:%lu word:%s url:%s freq:%d",
-            head->sid, head->serial, req->word, req->url, ntohl(req->freq));
+    log_debug(ctx->log, "sid:%lu serial:%lu prefix:%.*s num:%u",
+            head->sid, head->serial, (int)sizeof(req->prefix), req->prefix, ntohl(req->num));
 
-    /* > 转换字节序 */
-    MESG_HEAD_HTON(head, head);
+    /* > 设置截止时间 */
+    if (MESG_DEADLINE_IS_EXPIRED(head->flag)) {
+        log_warn(ctx->log, "Request is expired! sid:%lu serial:%lu", head->sid, head->serial);
+        return 0;
+    }
+    else if (!(head->flag & MESG_FLAG_DEADLINE) && ctx->conf.deadline > 0) {
+        head->flag = MESG_DEADLINE_SET(head->flag, ctx->conf.deadline);
+    }
+
+    /* > 登记合并项并转发 */
+    serial = head->serial;
+    mesg_suggest_add(ctx->suggest, serial, ntohl(req->num));
+
+    if (lsnd_mesg_forward(ctx, type, data, length, (head->flag & MESG_FLAG_DEADLINE)?
+            MESG_DEADLINE_LEFT(head->flag) : MESG_DEADLINE_MAX))
+    {
+        mesg_suggest_del(ctx->suggest, serial);
+        return -1;
+    }
 
-    return rtmq_proxy_async_send(ctx->frwder, type, data, length);
+    return 0;
 }
 
 /******************************************************************************
- **函数名称: lsnd_search_rsp_hdl
- **功    能: 插入关键字的应答
+ **函数名称: lsnd_suggest_rsp_hdl
+ **功    能: 搜索建议的应答
  **输入参数:
  **     type: 数据类型
  **     orig: 源结点ID
@@ -115,21 +550,95 @@ int lsnd_insert_word_req_hdl(unsigned int type, void *data, int length, void *ar
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
- **注意事项:
- **作    者: # Qifeng.zou # 2015.06.10 #
+ **     1. 核对在途请求, 无对应在途请求的应答(孤儿、重复或迟到的应答)直接丢弃
+ **     2. 请求被分发至多个后端时, 暂存各后端的建议, 收齐后按文档频率合并再发送
+ **注意事项: 各后端只返回本地前N个建议, 合并结果与全局前N个可能略有差异
+ **作    者:
  ******************************************************************************/
-int lsnd_insert_word_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
+int lsnd_suggest_rsp_hdl(int type, int orig, char *data, size_t len, void *args)
 {
+    int ret;
+    bool is_done;
     lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
-    mesg_header_t *head = (mesg_header_t *)data, hhead;
-    mesg_insert_word_rsp_t *rsp = (mesg_insert_word_rsp_t *)(head + 1);
+    mesg_header_t *head = (mesg_header_t *)data, hhead, *rsp;
 
     /* > 转换字节序 */
     MESG_HEAD_NTOH(head, &hhead);
 
     MESG_HEAD_PRINT(ctx->log, &hhead)
-    log_debug(ctx->log, "type:%d len:%d word:%s", type, len, rsp->word);
+
+    /* > 核对在途请求 */
+    if (mesg_pend_done(ctx->pend, hhead.serial, hhead.sid, hhead.flag, &is_done)) {
+        log_debug(ctx->log, "Drop orphan response! sid:%lu serial:%lu", hhead.sid, hhead.serial);
+        return 0;
+    }
+
+    /* > 合并各后端的建议 */
+    ret = mesg_suggest_merge(ctx->suggest, &hhead, head->body, is_done, &rsp);
+    if (MESG_SUGGEST_WAIT == ret) {
+        return 0; /* 等待其他后端的应答 */
+    }
+    else if (MESG_SUGGEST_DONE == ret) {
+        len = MESG_TOTAL_LEN(rsp->length);
+        MESG_HEAD_HTON(rsp, rsp);
+        ret = agent_async_send(ctx->agent, type, hhead.sid, rsp, len);
+        free(rsp);
+        return ret;
+    }
 
     /* > 放入发送队列 */
     return agent_async_send(ctx->agent, type, hhead.sid, data, len);
 }
+
+/******************************************************************************
+ **函数名称: lsnd_batch_mesg_hdl
+ **功    能: 批量消息的处理
+ **输入参数:
+ **     type: 数据类型
+ **     orig: 源结点ID
+ **     data: 批量消息(报头 + 消息1 + 消息2 + ...)
+ **     len: 数据长度
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 逐条拆出消息, 按消息类型交由对应的应答处理函数
+ **注意事项: 各消息的报头均为网络字节序; 长度异常时丢弃剩余消息
+ **作    者:
+ ******************************************************************************/
+int lsnd_batch_mesg_hdl(int type, int orig, char *data, size_t len, void *args)
+{
+    int num = 0;
+    size_t off, total;
+    mesg_header_t *mesg;
+    lsnd_cntx_t *ctx = (lsnd_cntx_t *)args;
+
+    for (off=sizeof(mesg_header_t); off + sizeof(mesg_header_t) <= len; off += total, ++num) {
+        mesg = (mesg_header_t *)(data + off);
+        total = MESG_TOTAL_LEN(MESG_NHEAD_LENGTH(mesg));
+        if (off + total > len) {
+            log_error(ctx->log, "Batch message is corrupted! orig:%d off:%lu len:%lu", orig, off, len);
+            return -1;
+        }
+
+        switch (MESG_NHEAD_TYPE(mesg)) {
+            case MSG_SEARCH_RSP:
+                lsnd_search_rsp_hdl(MSG_SEARCH_RSP, orig, (char *)mesg, total, args);
+                break;
+            case MSG_SUGGEST_RSP:
+                lsnd_suggest_rsp_hdl(MSG_SUGGEST_RSP, orig, (char *)mesg, total, args);
+                break;
+            case MSG_INSERT_WORD_RSP:
+            case MSG_INDEX_DOC_RSP:
+            case MSG_SET_DOC_SCORE_RSP:
+                lsnd_mesg_relay_hdl(MESG_NHEAD_TYPE(mesg), orig, (char *)mesg, total, args);
+                break;
+            default:
+                log_error(ctx->log, "Unknown message type in batch! type:%u", MESG_NHEAD_TYPE(mesg));
+                break;
+        }
+    }
+
+    log_trace(ctx->log, "Batch message! orig:%d num:%d len:%lu", orig, num, len);
+
+    return 0;
+}
@@ -36,15 +36,103 @@ typedef enum
     , MSG_SUB_REQ                       /* 订阅请求 */
     , MSG_SUB_RSP                       /* 订阅应答 */
 
+    , MSG_CANCEL_REQ                    /* 取消请求(客户端已断开, 无需应答) */
+
+    , MSG_BATCH_MESG                    /* 批量消息(报体为多个完整的消息: 报头+报体, 网络字节序) */
+
+    , MSG_SUGGEST_REQ                   /* 搜索建议请求(前缀补全) */
+    , MSG_SUGGEST_RSP                   /* 搜索建议应答 */
+
+    , MSG_INDEX_DOC_REQ                 /* 文档索引请求(服务端分词) */
+    , MSG_INDEX_DOC_RSP                 /* 文档索引应答 */
+
+    , MSG_SET_DOC_SCORE_REQ             /* 设置文档静态得分请求 */
+    , MSG_SET_DOC_SCORE_RSP             /* 设置文档静态得分应答 */
+
     , MSG_TYPE_TOTAL                    /* 消息类型总数 */
 } mesg_type_e;
 
 ////////////////////////////////////////////////////////////////////////////////
+/* 消息标识扩展位(mesg_header_t::flag)
+ *  注: 低8位由mesg.h使用(MSG_FLAG_SYS/MSG_FLAG_USR), 业务扩展位从第8位开始 */
+#define MESG_FLAG_ZIP       (0x00000100)    /* 报体已压缩(格式: mesg_zip_body_t) */
+#define MESG_FLAG_MORE      (0x00000200)    /* 应答未结束(后续还有分页帧) */
+#define MESG_FLAG_DEADLINE  (0x00000400)    /* 请求携带截止时间(存于flag的高16位) */
+#define MESG_FLAG_FANOUT    (0x00000800)    /* 应答携带扇出数(存于flag的高16位) */
+
+/* 请求截止时间
+ *  注: 取毫秒时间戳的低16位, 以回绕差值判断是否超时, 因此有效期不能超过
+ *      MESG_DEADLINE_MAX; 跨主机比较依赖各结点的时钟同步(NTP) */
+#define MESG_DEADLINE_SHIFT (16)
+#define MESG_DEADLINE_MAX   (30000)         /* 有效期上限(毫秒) */
+
+static inline uint16_t mesg_deadline_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint16_t)((uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+/* 设置截止时间(flag:主机字节序 timeout:有效期(毫秒)) */
+#define MESG_DEADLINE_SET(flag, timeout) \
+    (((flag) & 0x0000FFFF) | MESG_FLAG_DEADLINE \
+     | ((uint32_t)(uint16_t)(mesg_deadline_now() \
+        + MIN((timeout), MESG_DEADLINE_MAX)) << MESG_DEADLINE_SHIFT))
+
+/* 剩余时间(毫秒, <=0:已超时) */
+#define MESG_DEADLINE_LEFT(flag) \
+    ((int16_t)((uint16_t)((flag) >> MESG_DEADLINE_SHIFT) - mesg_deadline_now()))
+
+/* 是否已超时(未携带截止时间的请求永不超时) */
+#define MESG_DEADLINE_IS_EXPIRED(flag) \
+    (((flag) & MESG_FLAG_DEADLINE) && (MESG_DEADLINE_LEFT(flag) <= 0))
+
+/* 应答扇出数
+ *  注: 转发层将请求分发至多个倒排服务时, 在每帧应答中写入本次分发的结点数,
+ *      帧听层据此判断是否已收齐所有结点的末帧应答; 未携带时视为1.
+ *      高16位在请求中存放截止时间, 在应答中存放扇出数, 两者互不冲突 */
+#define MESG_FANOUT_SHIFT   (16)
+
+/* 设置扇出数(flag:主机字节序 num:扇出数) */
+#define MESG_FANOUT_SET(flag, num) \
+    (((flag) & 0x0000FFFF) | MESG_FLAG_FANOUT \
+     | ((uint32_t)(uint16_t)(num) << MESG_FANOUT_SHIFT))
+
+/* 获取扇出数(flag:主机字节序) */
+#define MESG_FANOUT_GET(flag) \
+    ((((flag) & MESG_FLAG_FANOUT) && ((flag) >> MESG_FANOUT_SHIFT))? \
+        (int)((flag) >> MESG_FANOUT_SHIFT) : 1)
+
+/* 读取网络字节序报头中的字段(转发层只读取路由所需字段, 无需整头转换字节序) */
+#define MESG_NHEAD_TYPE(head)       ntohl((head)->type)
+#define MESG_NHEAD_FLAG(head)       ntohl((head)->flag)
+#define MESG_NHEAD_LENGTH(head)     ntohl((head)->length)
+#define MESG_NHEAD_SID(head)        ntoh64((head)->sid)
+#define MESG_NHEAD_SERIAL(head)     ntoh64((head)->serial)
+
+/* 压缩报体 */
+#define MESG_ZIP_ORIG_MAX   (4 * 1024 * 1024) /* 压缩前报体长度上限(字节, 超出时不压缩, 解压时拒绝) */
+typedef struct
+{
+    uint32_t orig_len;                  /* 压缩前报体长度(网络字节序) */
+    char data[0];                       /* 压缩数据(zlib) */
+} mesg_zip_body_t;
+
+////////////////////////////////////////////////////////////////////////////////
+/* 搜索应答返回码(SEARCH-RSP::CODE) */
+#define SRCH_CODE_OK        "0000"          /* 返回OK */
+#define SRCH_CODE_ERR       "0001"          /* 异常错误 */
+#define SRCH_CODE_NO_DATA   "0002"          /* 无数据 */
+#define SRCH_CODE_BUSY      "0003"          /* 系统繁忙(请求被限流或过载保护拒绝) */
+
 /* 搜索消息结构 */
 #define SRCH_WORD_LEN       (128)
 typedef struct
 {
     char words[SRCH_WORD_LEN];          /* 搜索关键字 */
+    int fuzzy;                          /* 模糊匹配的最大编辑距离(0:精确匹配) */
 } mesg_search_req_t;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -73,6 +161,134 @@ typedef struct
     (rsp)->code = ntohl((rsp)->code); \
 } while(0)
 
+////////////////////////////////////////////////////////////////////////////////
+/* 文档索引请求
+ *  报体: mesg_index_doc_req_t + 标题(title_len字节) + 正文(body_len字节), UTF-8编码 */
+typedef struct
+{
+    char url[URL_MAX_LEN];              /* URL */
+    uint32_t title_len;                 /* 标题长度 */
+    uint32_t body_len;                  /* 正文长度 */
+    char text[0];                       /* 标题 + 正文(无需结束符) */
+} mesg_index_doc_req_t;
+
+#define mesg_index_doc_req_hton(req) do { /* 主机 > 网络 */\
+    (req)->title_len = htonl((req)->title_len); \
+    (req)->body_len = htonl((req)->body_len); \
+} while(0)
+
+#define mesg_index_doc_req_ntoh(req) do { /* 网络 > 主机 */\
+    (req)->title_len = ntohl((req)->title_len); \
+    (req)->body_len = ntohl((req)->body_len); \
+} while(0)
+
+/* 文档索引应答 */
+typedef struct
+{
+#define MESG_INDEX_DOC_FAIL     (0)
+#define MESG_INDEX_DOC_SUCC     (1)
+#define MESG_INDEX_DOC_TOO_LARGE (2)   /* 文档过大(超过帧听层至转发层的队列单元大小, 被帧听层拒绝) */
+    int code;                           /* 应答码 */
+    uint32_t term_num;                  /* 索引的词项数 */
+    char url[URL_MAX_LEN];              /* URL */
+} mesg_index_doc_rsp_t;
+
+#define mesg_index_doc_rsp_hton(rsp) do { /* 主机 > 网络 */\
+    (rsp)->code = htonl((rsp)->code); \
+    (rsp)->term_num = htonl((rsp)->term_num); \
+} while(0)
+
+#define mesg_index_doc_rsp_ntoh(rsp) do { /* 网络 > 主机 */\
+    (rsp)->code = ntohl((rsp)->code); \
+    (rsp)->term_num = ntohl((rsp)->term_num); \
+} while(0)
+
+////////////////////////////////////////////////////////////////////////////////
+/* 设置文档静态得分请求 */
+#define MESG_DOC_SCORE_MAX      (10000) /* 静态得分上限(万分制) */
+typedef struct
+{
+    char url[URL_MAX_LEN];              /* URL */
+    uint32_t score;                     /* 静态得分(0~MESG_DOC_SCORE_MAX, 如PageRank、站点质量等) */
+} mesg_set_doc_score_req_t;
+
+#define mesg_set_doc_score_req_hton(req) do { /* 主机 > 网络 */\
+    (req)->score = htonl((req)->score); \
+} while(0)
+
+#define mesg_set_doc_score_req_ntoh(req) do { /* 网络 > 主机 */\
+    (req)->score = ntohl((req)->score); \
+} while(0)
+
+/* 设置文档静态得分应答 */
+typedef struct
+{
+#define MESG_SET_DOC_SCORE_FAIL (0)
+#define MESG_SET_DOC_SCORE_SUCC (1)
+    int code;                           /* 应答码 */
+    uint32_t score;                     /* 静态得分 */
+    char url[URL_MAX_LEN];              /* URL */
+} mesg_set_doc_score_rsp_t;
+
+#define mesg_set_doc_score_rsp_hton(rsp) do { /* 主机 > 网络 */\
+    (rsp)->code = htonl((rsp)->code); \
+    (rsp)->score = htonl((rsp)->score); \
+} while(0)
+
+#define mesg_set_doc_score_rsp_ntoh(rsp) do { /* 网络 > 主机 */\
+    (rsp)->code = ntohl((rsp)->code); \
+    (rsp)->score = ntohl((rsp)->score); \
+} while(0)
+
+////////////////////////////////////////////////////////////////////////////////
+/* 搜索建议请求 */
+#define MESG_SUGGEST_MAX_NUM    (32)    /* 单次最多返回的建议数 */
+typedef struct
+{
+    char prefix[SRCH_WORD_LEN];         /* 前缀 */
+    uint32_t num;                       /* 最多返回的建议数 */
+} mesg_suggest_req_t;
+
+#define mesg_suggest_req_hton(req) do { /* 主机 > 网络 */\
+    (req)->num = htonl((req)->num); \
+} while(0)
+
+#define mesg_suggest_req_ntoh(req) do { /* 网络 > 主机 */\
+    (req)->num = ntohl((req)->num); \
+} while(0)
+
+/* 搜索建议项 */
+typedef struct
+{
+    char word[SRCH_WORD_LEN];           /* 关键字 */
+    uint32_t df;                        /* 文档频率 */
+} mesg_suggest_item_t;
+
+/* 搜索建议应答(按文档频率降序) */
+typedef struct
+{
+    uint32_t num;                       /* 建议数 */
+    mesg_suggest_item_t item[0];        /* 建议列表 */
+} mesg_suggest_rsp_t;
+
+#define MESG_SUGGEST_RSP_LEN(num) (sizeof(mesg_suggest_rsp_t) + (num) * sizeof(mesg_suggest_item_t))
+
+#define mesg_suggest_rsp_hton(rsp) do { /* 主机 > 网络 */\
+    uint32_t _idx; \
+    for (_idx=0; _idx<(rsp)->num; ++_idx) { \
+        (rsp)->item[_idx].df = htonl((rsp)->item[_idx].df); \
+    } \
+    (rsp)->num = htonl((rsp)->num); \
+} while(0)
+
+#define mesg_suggest_rsp_ntoh(rsp) do { /* 网络 > 主机 */\
+    uint32_t _idx; \
+    (rsp)->num = ntohl((rsp)->num); \
+    for (_idx=0; _idx<(rsp)->num; ++_idx) { \
+        (rsp)->item[_idx].df = ntohl((rsp)->item[_idx].df); \
+    } \
+} while(0)
+
 ////////////////////////////////////////////////////////////////////////////////
 /* 订阅请求 */
 typedef struct
@@ -108,4 +324,49 @@ typedef struct
     (rsp)->type = ntohl((rsp)->type); \
 } while(0)
 
+////////////////////////////////////////////////////////////////////////////////
+/* 取消请求 */
+#define MESG_CANCEL_MAX_NUM (64)        /* 单次最多取消的请求数 */
+typedef struct
+{
+    uint32_t num;                       /* 待取消的请求数 */
+    uint64_t serial[0];                 /* 待取消请求的流水号 */
+} __attribute__((packed)) mesg_cancel_req_t;
+
+#define MESG_CANCEL_REQ_LEN(num) (sizeof(mesg_cancel_req_t) + (num) * sizeof(uint64_t))
+
+#define mesg_cancel_req_hton(req) do { /* 主机 > 网络 */\
+    uint32_t _idx; \
+    for (_idx=0; _idx<(req)->num; ++_idx) { \
+        (req)->serial[_idx] = hton64((req)->serial[_idx]); \
+    } \
+    (req)->num = htonl((req)->num); \
+} while(0)
+
+#define mesg_cancel_req_ntoh(req) do { /* 网络 > 主机 */\
+    uint32_t _idx; \
+    (req)->num = ntohl((req)->num); \
+    for (_idx=0; _idx<(req)->num; ++_idx) { \
+        (req)->serial[_idx] = ntoh64((req)->serial[_idx]); \
+    } \
+} while(0)
+
+////////////////////////////////////////////////////////////////////////////////
+/* 转发类请求报体的最小长度
+ *  注: 帧听层对插入关键字、文档索引等请求只登记在途请求并原样转发,
+ *      转发前据此校验报体长度(返回0表示该类型不支持转发) */
+static inline size_t mesg_forward_body_min(uint32_t type)
+{
+    switch (type) {
+        case MSG_INSERT_WORD_REQ:
+            return sizeof(mesg_insert_word_req_t);
+        case MSG_INDEX_DOC_REQ:
+            return sizeof(mesg_index_doc_req_t);
+        case MSG_SET_DOC_SCORE_REQ:
+            return sizeof(mesg_set_doc_score_req_t);
+        default:
+            return 0;
+    }
+}
+
 #endif /*__CMD_H__*/
@@ -0,0 +1,63 @@
+#if !defined(__MESG_PEND_H__)
+#define __MESG_PEND_H__
+
+#include "log.h"
+#include "comm.h"
+#include "cmd.h"
+
+#define MESG_PEND_STRIPE_NUM    (16)        /* 在途表分段数(每段一把锁) */
+#define MESG_PEND_STRIPE_SIZE   (4096)      /* 每段槽位数(必须为2的次方) */
+#define MESG_PEND_GRACE         (500)       /* 截止时间之后的宽限时长(毫秒, 容忍时钟偏差) */
+#define MESG_PEND_HIST_NUM      (32)        /* 时延直方图桶数(第i桶: [2^i, 2^(i+1))微秒) */
+#define MESG_PEND_STAT_INTERVAL (60)        /* 时延统计输出间隔(秒) */
+
+/* 在途请求 */
+typedef struct
+{
+    uint64_t serial;                        /* 请求流水号(0:空闲) */
+    uint64_t sid;                           /* 发起请求的会话ID */
+    bool is_answered;                       /* 是否已收到首帧应答 */
+    int finals;                             /* 已收到的末帧应答数(每个后端结点一帧) */
+    uint64_t stm;                           /* 发送时间(微秒) */
+    uint64_t etm;                           /* 过期时间(微秒) */
+} mesg_pend_t;
+
+/* 在途表分段(线性探测开放寻址) */
+typedef struct
+{
+    pthread_mutex_t lock;                   /* 分段锁 */
+    mesg_pend_t slot[MESG_PEND_STRIPE_SIZE];/* 槽位 */
+} mesg_pend_stripe_t;
+
+/* 时延统计 */
+typedef struct
+{
+    volatile uint32_t first[MESG_PEND_HIST_NUM]; /* 首帧应答时延直方图 */
+    volatile uint32_t last[MESG_PEND_HIST_NUM]; /* 末帧应答时延直方图 */
+    volatile uint32_t orphan;               /* 丢弃的孤儿应答数(无对应在途请求) */
+    volatile uint32_t expired;              /* 超时未应答的请求数 */
+} mesg_pend_stat_t;
+
+/* 在途请求表
+ *  注: 记录已转发至后端且尚未应答完毕的请求, 用于:
+ *      1. 在第一跳丢弃孤儿应答(请求不存在、会话不匹配、重复或迟到的应答)
+ *      2. 统计每个请求的应答时延
+ *      3. 请求被转发层分发至多个倒排服务时, 收齐所有结点的末帧应答才算结束
+ *  由帧听层(listend)与WebSocket帧听层(listend-ws)共用 */
+typedef struct
+{
+    log_cycle_t *log;                       /* 日志对象 */
+
+    mesg_pend_stripe_t stripe[MESG_PEND_STRIPE_NUM]; /* 在途表(以serial为键) */
+
+    pthread_mutex_t stat_lock;              /* 统计输出锁 */
+    time_t stat_tm;                         /* 上次输出统计的时间 */
+    mesg_pend_stat_t stat;                  /* 时延统计 */
+} mesg_pend_tab_t;
+
+mesg_pend_tab_t *mesg_pend_tab_creat(log_cycle_t *log);
+int mesg_pend_add(mesg_pend_tab_t *tab, uint64_t serial, uint64_t sid, int timeout);
+void mesg_pend_del(mesg_pend_tab_t *tab, uint64_t serial);
+int mesg_pend_done(mesg_pend_tab_t *tab, uint64_t serial, uint64_t sid, uint32_t flag, bool *is_done);
+
+#endif /*__MESG_PEND_H__*/
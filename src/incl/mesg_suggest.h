@@ -0,0 +1,52 @@
+#if !defined(__MESG_SUGGEST_H__)
+#define __MESG_SUGGEST_H__
+
+#include "log.h"
+#include "comm.h"
+#include "mesg.h"
+#include "cmd.h"
+
+#define MESG_SUGGEST_BKT_NUM    (1024)      /* 哈希桶数(必须为2的次方) */
+#define MESG_SUGGEST_BKT_MASK   (MESG_SUGGEST_BKT_NUM - 1)
+#define MESG_SUGGEST_TTL        (MESG_DEADLINE_MAX / 1000 + 1) /* 合并项最长存活时间(秒) */
+
+/* 合并结果 */
+typedef enum
+{
+    MESG_SUGGEST_PASS                       /* 无需合并(原样转发) */
+    , MESG_SUGGEST_WAIT                     /* 已合并, 等待其他后端的应答 */
+    , MESG_SUGGEST_DONE                     /* 已收齐, 返回合并后的应答 */
+} mesg_suggest_merge_e;
+
+/* 合并项 */
+typedef struct _mesg_suggest_t
+{
+    uint64_t serial;                        /* 请求流水号 */
+    time_t ctm;                             /* 创建时间 */
+    int max;                                /* 请求的建议数 */
+
+    int num;                                /* 已合并的建议数 */
+    int size;                               /* 建议列表容量 */
+    mesg_suggest_item_t *item;              /* 已合并的建议(df为主机字节序) */
+
+    struct _mesg_suggest_t *next;           /* 哈希链 */
+} mesg_suggest_t;
+
+/* 搜索建议合并表
+ *  注: 建议请求被转发层分发至多个倒排服务时, 各结点只返回本地的前N个建议,
+ *      帧听层需收齐所有结点的应答后按文档频率合并, 再返回前N个给客户端.
+ *  由帧听层(listend)与WebSocket帧听层(listend-ws)共用 */
+typedef struct
+{
+    pthread_mutex_t lock;                   /* 互斥锁 */
+    int num;                                /* 合并项个数 */
+    mesg_suggest_t *bkt[MESG_SUGGEST_BKT_NUM]; /* 以serial为键 */
+} mesg_suggest_tab_t;
+
+mesg_suggest_tab_t *mesg_suggest_tab_creat(void);
+int mesg_suggest_add(mesg_suggest_tab_t *tab, uint64_t serial, int max);
+void mesg_suggest_del(mesg_suggest_tab_t *tab, uint64_t serial);
+int mesg_suggest_merge(mesg_suggest_tab_t *tab, const mesg_header_t *head,
+        const void *body, bool is_done, mesg_header_t **rsp);
+
+#endif /*__MESG_SUGGEST_H__*/
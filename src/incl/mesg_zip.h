@@ -0,0 +1,11 @@
+#if !defined(__MESG_ZIP_H__)
+#define __MESG_ZIP_H__
+
+#include "log.h"
+#include "comm.h"
+#include "mesg.h"
+#include "cmd.h"
+
+mesg_header_t *mesg_unzip(const mesg_header_t *head, const void *body, size_t *len, log_cycle_t *log);
+
+#endif /*__MESG_ZIP_H__*/
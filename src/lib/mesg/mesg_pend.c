@@ -0,0 +1,404 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: mesg_pend.c
+ ** 版本号: 1.0
+ ** 描  述: 在途请求表
+ **         记录已转发至后端的请求(流水号、会话ID、发送时间), 应答到达时核对:
+ **         无对应请求、会话不匹配、重复或迟到的应答在第一跳直接丢弃;
+ **         同时按请求统计首帧/末帧应答时延, 定期输出百分位.
+ **         请求被分发至多个后端时, 以应答携带的扇出数判断是否已收齐末帧应答.
+ ** 作  者:
+ ******************************************************************************/
+#include "mesg_pend.h"
+
+/* 在途表哈希(MurmurHash3 fmix64) */
+static inline uint64_t mesg_pend_hash(uint64_t serial)
+{
+    serial ^= serial >> 33;
+    serial *= 0xFF51AFD7ED558CCDULL;
+    serial ^= serial >> 33;
+
+    return serial;
+}
+
+#define MESG_PEND_STRIPE(h)     ((h) & (MESG_PEND_STRIPE_NUM - 1))
+#define MESG_PEND_HOME(h)       (((h) >> 8) & (MESG_PEND_STRIPE_SIZE - 1))
+#define MESG_PEND_NEXT(pos)     (((pos) + 1) & (MESG_PEND_STRIPE_SIZE - 1))
+
+/* 获取当前时间(微秒) */
+static inline uint64_t mesg_pend_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_tab_creat
+ **功    能: 创建在途请求表
+ **输入参数:
+ **     log: 日志对象
+ **输出参数: NONE
+ **返    回: 在途请求表
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+mesg_pend_tab_t *mesg_pend_tab_creat(log_cycle_t *log)
+{
+    int idx;
+    mesg_pend_tab_t *tab;
+
+    tab = (mesg_pend_tab_t *)calloc(1, sizeof(mesg_pend_tab_t));
+    if (NULL == tab) {
+        return NULL;
+    }
+
+    tab->log = log;
+    tab->stat_tm = time(NULL);
+
+    for (idx=0; idx<MESG_PEND_STRIPE_NUM; ++idx) {
+        pthread_mutex_init(&tab->stripe[idx].lock, NULL);
+    }
+    pthread_mutex_init(&tab->stat_lock, NULL);
+
+    return tab;
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_hist_add
+ **功    能: 记录时延样本
+ **输入参数:
+ **     hist: 时延直方图
+ **     usec: 时延(微秒)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 第i桶记录[2^i, 2^(i+1))微秒的样本数
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void mesg_pend_hist_add(volatile uint32_t *hist, uint64_t usec)
+{
+    int bkt = 0;
+
+    while ((usec >>= 1) && bkt < MESG_PEND_HIST_NUM - 1) {
+        ++bkt;
+    }
+
+    atomic32_inc((uint32_t *)&hist[bkt]);
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_hist_percentile
+ **功    能: 计算时延百分位值
+ **输入参数:
+ **     hist: 时延直方图
+ **     total: 样本总数
+ **     percentile: 百分位(1~999, 千分比)
+ **输出参数: NONE
+ **返    回: 时延(微秒, 0:尚无样本)
+ **实现描述: 累加直方图直到覆盖指定比例的样本, 返回所在桶的上界
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static uint64_t mesg_pend_hist_percentile(const uint32_t *hist, uint64_t total, int percentile)
+{
+    int bkt;
+    uint64_t sum = 0, target;
+
+    if (0 == total) {
+        return 0;
+    }
+
+    target = (total * percentile + 999) / 1000;
+    for (bkt=0; bkt<MESG_PEND_HIST_NUM - 1; ++bkt) {
+        sum += hist[bkt];
+        if (sum >= target) {
+            break;
+        }
+    }
+
+    return ((uint64_t)1 << (bkt + 1));
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_report
+ **功    能: 输出时延统计
+ **输入参数:
+ **     tab: 在途请求表
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 每隔MESG_PEND_STAT_INTERVAL秒, 由首个抢到统计锁的线程输出并清零
+ **注意事项: 取快照与清零之间的少量样本可能丢失, 不影响统计意义
+ **作    者:
+ ******************************************************************************/
+static void mesg_pend_report(mesg_pend_tab_t *tab)
+{
+    int bkt;
+    time_t now = time(NULL);
+    uint64_t first_num = 0, last_num = 0;
+    uint32_t first[MESG_PEND_HIST_NUM], last[MESG_PEND_HIST_NUM], orphan, expired;
+    mesg_pend_stat_t *stat = &tab->stat;
+
+    if (now - tab->stat_tm < MESG_PEND_STAT_INTERVAL) {
+        return;
+    } else if (pthread_mutex_trylock(&tab->stat_lock)) {
+        return; /* 其他线程正在输出 */
+    } else if (now - tab->stat_tm < MESG_PEND_STAT_INTERVAL) {
+        pthread_mutex_unlock(&tab->stat_lock);
+        return;
+    }
+
+    /* > 取快照并清零 */
+    for (bkt=0; bkt<MESG_PEND_HIST_NUM; ++bkt) {
+        first[bkt] = stat->first[bkt];
+        stat->first[bkt] = 0;
+        first_num += first[bkt];
+
+        last[bkt] = stat->last[bkt];
+        stat->last[bkt] = 0;
+        last_num += last[bkt];
+    }
+    orphan = stat->orphan;
+    stat->orphan = 0;
+    expired = stat->expired;
+    stat->expired = 0;
+
+    tab->stat_tm = now;
+
+    pthread_mutex_unlock(&tab->stat_lock);
+
+    /* > 输出统计(时延单位: 微秒) */
+    log_info(tab->log, "Latency stat! first:[num:%lu p50:%lu p90:%lu p99:%lu p999:%lu]"
+            " last:[num:%lu p50:%lu p90:%lu p99:%lu p999:%lu] orphan:%u expired:%u",
+            first_num,
+            mesg_pend_hist_percentile(first, first_num, 500),
+            mesg_pend_hist_percentile(first, first_num, 900),
+            mesg_pend_hist_percentile(first, first_num, 990),
+            mesg_pend_hist_percentile(first, first_num, 999),
+            last_num,
+            mesg_pend_hist_percentile(last, last_num, 500),
+            mesg_pend_hist_percentile(last, last_num, 900),
+            mesg_pend_hist_percentile(last, last_num, 990),
+            mesg_pend_hist_percentile(last, last_num, 999),
+            orphan, expired);
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_find
+ **功    能: 查找在途请求
+ **输入参数:
+ **     stripe: 在途表分段
+ **     pos: 起始槽位
+ **     serial: 请求流水号
+ **输出参数:
+ **     slot: 所在槽位
+ **返    回: 在途请求(NULL:不存在)
+ **实现描述: 从起始槽位线性探测, 直到找到或遇到空闲槽位
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static mesg_pend_t *mesg_pend_find(mesg_pend_stripe_t *stripe,
+        uint32_t pos, uint64_t serial, uint32_t *slot)
+{
+    int n;
+    mesg_pend_t *pend;
+
+    for (n=0; n<MESG_PEND_STRIPE_SIZE; ++n, pos=MESG_PEND_NEXT(pos)) {
+        pend = &stripe->slot[pos];
+        if (0 == pend->serial) {
+            return NULL;
+        } else if (pend->serial == serial) {
+            *slot = pos;
+            return pend;
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_erase
+ **功    能: 删除在途请求
+ **输入参数:
+ **     stripe: 在途表分段
+ **     pos: 待删除的槽位
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 后移删除(backward shift): 将后续探测链上可前移的键依次前移, 无需墓碑
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static void mesg_pend_erase(mesg_pend_stripe_t *stripe, uint32_t pos)
+{
+    uint32_t next, home;
+    mesg_pend_t *slot = stripe->slot;
+
+    next = pos;
+    while (1) {
+        slot[pos].serial = 0;
+
+        do {
+            next = MESG_PEND_NEXT(next);
+            if (0 == slot[next].serial) {
+                return;
+            }
+            home = MESG_PEND_HOME(mesg_pend_hash(slot[next].serial));
+        } while ((pos <= next)? (pos < home && home <= next) : (pos < home || home <= next));
+
+        slot[pos] = slot[next];
+        pos = next;
+    }
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_add
+ **功    能: 添加在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     serial: 请求流水号
+ **     sid: 会话ID
+ **     timeout: 有效期(毫秒)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败(表已满)
+ **实现描述: 从起始槽位线性探测, 遇到空闲槽位或已过期的槽位时写入
+ **注意事项: 过期槽位位于新键的探测路径上, 直接覆盖不会破坏其他键的探测链
+ **作    者:
+ ******************************************************************************/
+int mesg_pend_add(mesg_pend_tab_t *tab, uint64_t serial, uint64_t sid, int timeout)
+{
+    int n;
+    uint32_t pos;
+    mesg_pend_t *pend;
+    mesg_pend_stripe_t *stripe;
+    uint64_t h = mesg_pend_hash(serial), now = mesg_pend_now();
+
+    stripe = &tab->stripe[MESG_PEND_STRIPE(h)];
+    pos = MESG_PEND_HOME(h);
+
+    pthread_mutex_lock(&stripe->lock);
+
+    for (n=0; n<MESG_PEND_STRIPE_SIZE; ++n, pos=MESG_PEND_NEXT(pos)) {
+        pend = &stripe->slot[pos];
+        if (0 == pend->serial) {
+            break;
+        } else if (pend->etm <= now) {
+            atomic32_inc((uint32_t *)&tab->stat.expired);
+            break;
+        }
+    }
+
+    if (n >= MESG_PEND_STRIPE_SIZE) {
+        pthread_mutex_unlock(&stripe->lock);
+        return -1; /* 表已满 */
+    }
+
+    pend->serial = serial;
+    pend->sid = sid;
+    pend->is_answered = false;
+    pend->finals = 0;
+    pend->stm = now;
+    pend->etm = now + (uint64_t)(timeout + MESG_PEND_GRACE) * 1000;
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_del
+ **功    能: 删除在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     serial: 请求流水号
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 请求发送失败时调用, 不计入时延统计
+ **作    者:
+ ******************************************************************************/
+void mesg_pend_del(mesg_pend_tab_t *tab, uint64_t serial)
+{
+    uint32_t pos;
+    mesg_pend_stripe_t *stripe;
+    uint64_t h = mesg_pend_hash(serial);
+
+    stripe = &tab->stripe[MESG_PEND_STRIPE(h)];
+
+    pthread_mutex_lock(&stripe->lock);
+    if (NULL != mesg_pend_find(stripe, MESG_PEND_HOME(h), serial, &pos)) {
+        mesg_pend_erase(stripe, pos);
+    }
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+/******************************************************************************
+ **函数名称: mesg_pend_done
+ **功    能: 收到应答时核对并更新在途请求
+ **输入参数:
+ **     tab: 在途请求表
+ **     serial: 请求流水号
+ **     sid: 应答中的会话ID
+ **     flag: 应答标识(主机字节序, 含MESG_FLAG_MORE及扇出数)
+ **输出参数:
+ **     is_done: 是否已收齐所有后端的末帧应答(可为NULL)
+ **返    回: 0:有效应答 !0:孤儿应答(应丢弃)
+ **实现描述:
+ **     1. 无对应请求、会话ID不匹配或已过期的应答均为孤儿应答
+ **     2. 首帧应答: 记录首帧时延
+ **     3. 末帧应答: 累计末帧数, 达到扇出数时记录末帧时延, 并删除在途请求
+ **注意事项:
+ **     1. 扇出数由转发层写入每帧应答, 未携带时视为1
+ **     2. 收齐之后重复的末帧应答因在途请求已删除而被识别为孤儿应答
+ **作    者:
+ ******************************************************************************/
+int mesg_pend_done(mesg_pend_tab_t *tab, uint64_t serial, uint64_t sid, uint32_t flag, bool *is_done)
+{
+    uint32_t pos;
+    mesg_pend_t *pend;
+    mesg_pend_stripe_t *stripe;
+    uint64_t h = mesg_pend_hash(serial), now = mesg_pend_now();
+
+    stripe = &tab->stripe[MESG_PEND_STRIPE(h)];
+
+    if (NULL != is_done) {
+        *is_done = false;
+    }
+
+    pthread_mutex_lock(&stripe->lock);
+
+    pend = mesg_pend_find(stripe, MESG_PEND_HOME(h), serial, &pos);
+    if (NULL == pend || pend->sid != sid || pend->etm <= now) {
+        if (NULL != pend && pend->etm <= now) {
+            mesg_pend_erase(stripe, pos); /* 迟到的应答 */
+            atomic32_inc((uint32_t *)&tab->stat.expired);
+        }
+        pthread_mutex_unlock(&stripe->lock);
+        atomic32_inc((uint32_t *)&tab->stat.orphan);
+        return -1;
+    }
+
+    if (!pend->is_answered) {
+        pend->is_answered = true;
+        mesg_pend_hist_add(tab->stat.first, now - pend->stm);
+    }
+
+    if (!(flag & MESG_FLAG_MORE)
+        && ++pend->finals >= MESG_FANOUT_GET(flag))
+    {
+        mesg_pend_hist_add(tab->stat.last, now - pend->stm);
+        mesg_pend_erase(stripe, pos);
+        if (NULL != is_done) {
+            *is_done = true;
+        }
+    }
+
+    pthread_mutex_unlock(&stripe->lock);
+
+    mesg_pend_report(tab);
+
+    return 0;
+}
@@ -0,0 +1,325 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: mesg_suggest.c
+ ** 版本号: 1.0
+ ** 描  述: 搜索建议应答合并
+ **         建议请求被分发至多个倒排服务时, 各结点只返回本地文档频率最高的前N个
+ **         建议. 帧听层暂存各结点的应答, 同一关键字的文档频率累加, 收齐后按文档
+ **         频率降序取前N个返回给客户端.
+ ** 作  者:
+ ******************************************************************************/
+#include "mesg_suggest.h"
+
+#define MESG_SUGGEST_IDX(serial) /* 流水号哈希 */\
+    ((uint32_t)((serial) ^ ((serial) >> 32)) & MESG_SUGGEST_BKT_MASK)
+
+/******************************************************************************
+ **函数名称: mesg_suggest_tab_creat
+ **功    能: 创建搜索建议合并表
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 搜索建议合并表
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+mesg_suggest_tab_t *mesg_suggest_tab_creat(void)
+{
+    mesg_suggest_tab_t *tab;
+
+    tab = (mesg_suggest_tab_t *)calloc(1, sizeof(mesg_suggest_tab_t));
+    if (NULL == tab) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&tab->lock, NULL);
+
+    return tab;
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_free
+ **功    能: 释放合并项
+ **输入参数:
+ **     item: 合并项
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者:
+ ******************************************************************************/
+static void mesg_suggest_free(mesg_suggest_t *item)
+{
+    free(item->item);
+    free(item);
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_unlink
+ **功    能: 从哈希链中摘除合并项
+ **输入参数:
+ **     tab: 搜索建议合并表
+ **     serial: 请求流水号
+ **输出参数: NONE
+ **返    回: 被摘除的合并项(NULL:不存在)
+ **实现描述: 同时清理该哈希链上已过期的合并项(后端未应答时, 合并项不会被正常摘除)
+ **注意事项: 调用者已加锁
+ **作    者:
+ ******************************************************************************/
+static mesg_suggest_t *mesg_suggest_unlink(mesg_suggest_tab_t *tab, uint64_t serial)
+{
+    time_t now = time(NULL);
+    mesg_suggest_t **pp, *item, *found = NULL;
+
+    pp = &tab->bkt[MESG_SUGGEST_IDX(serial)];
+    while (NULL != *pp) {
+        item = *pp;
+        if (item->serial == serial && NULL == found) {
+            *pp = item->next;
+            --tab->num;
+            found = item;
+            continue;
+        }
+        else if (item->ctm + MESG_SUGGEST_TTL <= now) {
+            *pp = item->next;
+            --tab->num;
+            mesg_suggest_free(item);
+            continue;
+        }
+        pp = &item->next;
+    }
+
+    return found;
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_add
+ **功    能: 添加合并项
+ **输入参数:
+ **     tab: 搜索建议合并表
+ **     serial: 请求流水号
+ **     max: 请求的建议数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 转发建议请求前调用
+ **注意事项: 添加失败时应答不做合并, 各后端的应答原样转发
+ **作    者:
+ ******************************************************************************/
+int mesg_suggest_add(mesg_suggest_tab_t *tab, uint64_t serial, int max)
+{
+    mesg_suggest_t *item, *old;
+    uint32_t idx = MESG_SUGGEST_IDX(serial);
+
+    item = (mesg_suggest_t *)calloc(1, sizeof(mesg_suggest_t));
+    if (NULL == item) {
+        return -1;
+    }
+
+    item->serial = serial;
+    item->ctm = time(NULL);
+    item->max = (max <= 0 || max > MESG_SUGGEST_MAX_NUM)? MESG_SUGGEST_MAX_NUM : max;
+
+    pthread_mutex_lock(&tab->lock);
+
+    old = mesg_suggest_unlink(tab, serial); /* 清理过期项及重复的流水号 */
+
+    item->next = tab->bkt[idx];
+    tab->bkt[idx] = item;
+    ++tab->num;
+
+    pthread_mutex_unlock(&tab->lock);
+
+    if (NULL != old) {
+        mesg_suggest_free(old);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_del
+ **功    能: 删除合并项
+ **输入参数:
+ **     tab: 搜索建议合并表
+ **     serial: 请求流水号
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 请求发送失败时调用
+ **作    者:
+ ******************************************************************************/
+void mesg_suggest_del(mesg_suggest_tab_t *tab, uint64_t serial)
+{
+    mesg_suggest_t *item;
+
+    pthread_mutex_lock(&tab->lock);
+    item = mesg_suggest_unlink(tab, serial);
+    pthread_mutex_unlock(&tab->lock);
+
+    if (NULL != item) {
+        mesg_suggest_free(item);
+    }
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_absorb
+ **功    能: 将一个后端的建议列表并入合并项
+ **输入参数:
+ **     item: 合并项
+ **     rsp: 建议应答(网络字节序)
+ **     num: 建议数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 同一关键字出现在多个后端时累加文档频率(各分区的文档互不重叠)
+ **注意事项:
+ **     1. 调用者已加锁; 单个后端最多MESG_SUGGEST_MAX_NUM项, 线性查找即可
+ **     2. 内存不足时丢弃本帧尚未并入的建议, 其余后端的建议仍可返回
+ **作    者:
+ ******************************************************************************/
+static void mesg_suggest_absorb(mesg_suggest_t *item, const mesg_suggest_rsp_t *rsp, int num)
+{
+    int idx, k, size;
+    mesg_suggest_item_t *list;
+    const mesg_suggest_item_t *sg;
+
+    for (idx=0; idx<num; ++idx) {
+        sg = &rsp->item[idx];
+
+        for (k=0; k<item->num; ++k) {
+            if (!strncmp(item->item[k].word, sg->word, sizeof(sg->word))) {
+                break;
+            }
+        }
+
+        if (k < item->num) {
+            item->item[k].df += ntohl(sg->df);
+            continue;
+        }
+
+        /* > 扩展建议列表 */
+        if (item->num >= item->size) {
+            size = item->size + MESG_SUGGEST_MAX_NUM;
+            list = (mesg_suggest_item_t *)realloc(item->item, size * sizeof(mesg_suggest_item_t));
+            if (NULL == list) {
+                return;
+            }
+            item->item = list;
+            item->size = size;
+        }
+
+        memcpy(item->item[item->num].word, sg->word, sizeof(sg->word));
+        item->item[item->num].word[sizeof(sg->word) - 1] = '\0';
+        item->item[item->num].df = ntohl(sg->df);
+        ++item->num;
+    }
+}
+
+/* 按文档频率降序(相同时按关键字升序, 保证结果稳定) */
+static int mesg_suggest_cmp(const void *_a, const void *_b)
+{
+    const mesg_suggest_item_t *a = (const mesg_suggest_item_t *)_a;
+    const mesg_suggest_item_t *b = (const mesg_suggest_item_t *)_b;
+
+    if (a->df != b->df) {
+        return (a->df > b->df)? -1 : 1;
+    }
+
+    return strcmp(a->word, b->word);
+}
+
+/******************************************************************************
+ **函数名称: mesg_suggest_merge
+ **功    能: 合并搜索建议应答
+ **输入参数:
+ **     tab: 搜索建议合并表
+ **     head: 应答报头(主机字节序)
+ **     body: 应答报体(网络字节序, 格式: mesg_suggest_rsp_t)
+ **     is_done: 是否已收齐所有后端的末帧应答(见mesg_pend_done())
+ **输出参数:
+ **     rsp: 合并后的应答(报头为主机字节序, 报体为网络字节序)
+ **返    回: 合并结果(取值: mesg_suggest_merge_e)
+ **实现描述:
+ **     1. 无对应合并项时原样转发
+ **     2. 此前的应答均无建议且本帧已是最后一帧时无需合并, 原样转发
+ **     3. 未收齐时暂存建议列表, 丢弃本帧应答
+ **     4. 收齐后按文档频率降序排序, 取前max个组装应答
+ **注意事项: 返回MESG_SUGGEST_DONE时, rsp由调用者释放
+ **作    者:
+ ******************************************************************************/
+int mesg_suggest_merge(mesg_suggest_tab_t *tab, const mesg_header_t *head,
+        const void *body, bool is_done, mesg_header_t **rsp)
+{
+    int idx, num = 0;
+    mesg_suggest_t *item;
+    mesg_suggest_rsp_t *out;
+    const mesg_suggest_rsp_t *sg = (const mesg_suggest_rsp_t *)body;
+
+    /* > 校验建议列表 */
+    if (head->length >= sizeof(mesg_suggest_rsp_t)) {
+        num = ntohl(sg->num);
+        if (num < 0 || num > MESG_SUGGEST_MAX_NUM
+            || head->length < MESG_SUGGEST_RSP_LEN(num))
+        {
+            num = 0; /* 报体非法时视为空列表 */
+        }
+    }
+
+    pthread_mutex_lock(&tab->lock);
+
+    item = tab->bkt[MESG_SUGGEST_IDX(head->serial)];
+    for (; NULL != item; item = item->next) {
+        if (item->serial == head->serial) {
+            break;
+        }
+    }
+
+    if (NULL == item) {
+        pthread_mutex_unlock(&tab->lock);
+        return MESG_SUGGEST_PASS;
+    }
+
+    /* > 合并本帧应答 */
+    if (is_done && 0 == item->num) {
+        mesg_suggest_unlink(tab, head->serial);
+        pthread_mutex_unlock(&tab->lock);
+        mesg_suggest_free(item);
+        return MESG_SUGGEST_PASS;
+    }
+
+    mesg_suggest_absorb(item, sg, num);
+
+    if (!is_done) {
+        pthread_mutex_unlock(&tab->lock);
+        return MESG_SUGGEST_WAIT;
+    }
+
+    mesg_suggest_unlink(tab, head->serial);
+
+    pthread_mutex_unlock(&tab->lock);
+
+    /* > 排序并组装应答 */
+    qsort(item->item, item->num, sizeof(mesg_suggest_item_t), mesg_suggest_cmp);
+
+    num = MIN(item->num, item->max);
+
+    *rsp = (mesg_header_t *)calloc(1, sizeof(mesg_header_t) + MESG_SUGGEST_RSP_LEN(num));
+    if (NULL == *rsp) {
+        mesg_suggest_free(item);
+        return MESG_SUGGEST_PASS; /* 内存不足时退化为转发末帧应答 */
+    }
+
+    memcpy(*rsp, head, sizeof(mesg_header_t));
+    (*rsp)->length = MESG_SUGGEST_RSP_LEN(num);
+
+    out = (mesg_suggest_rsp_t *)((*rsp) + 1);
+    out->num = num;
+    for (idx=0; idx<num; ++idx) {
+        memcpy(&out->item[idx], &item->item[idx], sizeof(mesg_suggest_item_t));
+    }
+    mesg_suggest_rsp_hton(out);
+
+    mesg_suggest_free(item);
+
+    return MESG_SUGGEST_DONE;
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: mesg_zip.c
+ ** 版本号: 1.0
+ ** 描  述: 压缩报体的解压
+ **         倒排服务对较大的搜索应答报体进行zlib压缩(MESG_FLAG_ZIP), 帧听层在
+ **         发给客户端前解压, 客户端无需感知压缩.
+ ** 作  者:
+ ******************************************************************************/
+#include <zlib.h>
+
+#include "mesg_zip.h"
+
+/******************************************************************************
+ **函数名称: mesg_unzip
+ **功    能: 解压应答报体
+ **输入参数:
+ **     head: 报头(主机字节序)
+ **     body: 压缩报体(格式: mesg_zip_body_t)
+ **     log: 日志对象
+ **输出参数:
+ **     len: 解压后消息总长
+ **返    回: 解压后的消息(报头+原始报体, 报头为主机字节序)
+ **实现描述: 拷贝报头并清除MESG_FLAG_ZIP标识, 再将报体解压至报头之后
+ **注意事项:
+ **     1. 返回的内存由调用者释放
+ **     2. 压缩前长度来自网络, 超过MESG_ZIP_ORIG_MAX时直接拒绝, 防止按伪造的
+ **        长度分配超大内存
+ **作    者:
+ ******************************************************************************/
+mesg_header_t *mesg_unzip(const mesg_header_t *head, const void *body, size_t *len, log_cycle_t *log)
+{
+    uLongf orig_len;
+    mesg_header_t *rsp;
+    const mesg_zip_body_t *zip = (const mesg_zip_body_t *)body;
+
+    if (head->length < sizeof(mesg_zip_body_t)) {
+        log_error(log, "Zip body is too short! length:%u", head->length);
+        return NULL;
+    }
+
+    orig_len = ntohl(zip->orig_len);
+    if (0 == orig_len || orig_len > MESG_ZIP_ORIG_MAX) {
+        log_error(log, "Zip original length is invalid! serial:%lu orig_len:%lu",
+                head->serial, orig_len);
+        return NULL;
+    }
+
+    rsp = (mesg_header_t *)calloc(1, sizeof(mesg_header_t) + orig_len + 1);
+    if (NULL == rsp) {
+        log_error(log, "Alloc memory failed! errmsg:[%d] %s!", errno, strerror(errno));
+        return NULL;
+    }
+
+    if (Z_OK != uncompress((Bytef *)rsp->body, &orig_len, (const Bytef *)zip->data,
+                head->length - sizeof(mesg_zip_body_t)))
+    {
+        log_error(log, "Uncompress body failed! serial:%lu", head->serial);
+        free(rsp);
+        return NULL;
+    }
+
+    memcpy(rsp, head, sizeof(mesg_header_t));
+    rsp->flag &= ~MESG_FLAG_ZIP;
+    rsp->length = orig_len;
+
+    *len = MESG_TOTAL_LEN(rsp->length);
+
+    return rsp;
+}